@@ -187,11 +187,12 @@ static void load_CART(char * cartname)
   emu_FileOpen(cartname);
   if (flen < 16384) {
     emu_printf("8k");
-    for(int i=0; i<flen; i++) memory_rom[0x2000 + i] = emu_FileGetc();    
+    // the 8K window, a bigger file would overrun the memory behind it
+    emu_FileRead((char *)&memory_rom[0x2000], (flen < 0x2000) ? flen : 0x2000);
   }
   else {
     emu_printf("16k");    
-    for(int i=0; i<flen; i++) memory_rom[i] = emu_FileGetc();
+    emu_FileRead((char *)memory_rom, 0x4000);
   }
 
   emu_FileClose(); 
@@ -288,7 +288,7 @@ static void load_CART(char * cartname)
   switch (flen)
   {
     case 32768: // 32k cart
-      for (i = 0; i < 32768; i++) memory[0x4000 + i] = emu_FileGetc(f);
+      emu_FileRead(&memory[0x4000], 32768, f);
       // get crc32 from 32k data
       crc32 = calc_crc32(memory + 0x4000, 32768);
       sprintf(logmsg, "32 Trying to load '%s', crc32=0x%08X\n", cartname, (unsigned int)crc32);
@@ -296,7 +296,8 @@ static void load_CART(char * cartname)
       break;
     case 16384: // 16k cart
       // here we hack and load it twice (mapped like that?)
-      for (i = 0; i < 16384; i++) memory[0x4000 + i] = memory[0x8000 + i] = emu_FileGetc(f);
+      emu_FileRead(&memory[0x4000], 16384, f);
+      memcpy(&memory[0x8000], &memory[0x4000], 16384);
 
       // get crc32 from 16k data
       crc32 = calc_crc32(memory + 0x4000, 16384);
@@ -385,19 +386,15 @@ static void load_CART(char * cartname)
 #endif
       // default to 16k+8k mapping
       emu_FileSeek(f,0,0);
-      for(i=0; i<16384; i++) memory[0x6000 + i] = emu_FileGetc(f);
+      emu_FileRead(&memory[0x6000], 16384, f);
       for(i=0; i<8192; i++) memory[0xA000 + i] = memory[0x8000 + i];
       break;
     case 8192 : // 8k cart
       // Load mirrored 4 times
-      for(i = 0; i < 8192; i++)
-        {
-        uint8 c = emu_FileGetc(f);
-        memory[0x4000 + i] = c;
-        memory[0x6000 + i] = c;
-        memory[0x8000 + i] = c;
-        memory[0xA000 + i] = c;
-        }
+      emu_FileRead(&memory[0x4000], 8192, f);
+      memcpy(&memory[0x6000], &memory[0x4000], 8192);
+      memcpy(&memory[0x8000], &memory[0x4000], 8192);
+      memcpy(&memory[0xA000], &memory[0x4000], 8192);
       // get crc32 from 8k data
       crc32 = calc_crc32(memory + 0x4000, 8192);
       sprintf(logmsg, "8k cart load '%s', crc32=0x%08X\n", cartname, (unsigned int)crc32);
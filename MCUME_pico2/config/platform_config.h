@@ -13,6 +13,7 @@
 #define PSRAM_CHIP_SELECT (47u)
 //#define ILI9341        1
 //#define ST7789         1
+//#define TFT_DIRTY_REFRESH 1
 //#define SWAP_JOYSTICK  1
 //#define LOHRES         1
 //#define ROTATE_SCREEN  1
@@ -98,42 +98,156 @@ void SND_Process(void *sndbuffer, int sndn);
 #endif  
 #endif
 
+#ifdef SND_RING
+#include <string.h>
+#include "hardware/sync.h"
+
+#define SND_RING_MASK (SND_RING_SIZE-1)
+
+// head only written by the producer (emulation), tail only by the consumer (audio)
+// both are free running, the fill level is head-tail
+static short ring[SND_RING_SIZE];
+static volatile unsigned int ring_head = 0;
+static volatile unsigned int ring_tail = 0;
+static unsigned int ring_frac = 0;   // position between tail and tail+1 (1/65536 units)
+static short ring_last = 0;
+static bool ring_primed = false;
+static bool ring_started = false;
+static AudioRingStats ring_stats = {0,0,0,SND_RING_SIZE,0,0};
+#endif
+
 #include <stdio.h>
+static void snd_Render(short *  stream, int len )
+{
+#ifdef CUSTOM_SND
+  //printf("s\n");    
+  SND_Process((void*)stream, len);
+#else
+  int i;
+  long s;     
+  //len = len >> 1;   
+  short v0=chan[0].vol;
+  short v1=chan[1].vol;
+  short v2=chan[2].vol;
+  short v3=chan[3].vol;
+  short v4=chan[4].vol;
+  short v5=chan[5].vol;
+  for (i=0;i<len;i++)
+  {
+    s =((v0*square[(chan[0].spos>>8)&0x3f])>>11);
+    s+=((v1*square[(chan[1].spos>>8)&0x3f])>>11);
+    s+=((v2*square[(chan[2].spos>>8)&0x3f])>>11);
+    s+=((v3*noise[(chan[3].spos>>8)&(NOISEBSIZE-1)])>>11);
+    s+=((v4*noise[(chan[4].spos>>8)&(NOISEBSIZE-1)])>>11);
+    s+=((v5*noise[(chan[5].spos>>8)&(NOISEBSIZE-1)])>>11);         
+    *stream++ = (short)(s>>8 /*+ 32767*/);
+    //*stream++ = (short)(s);
+    chan[0].spos += chan[0].sinc;
+    chan[1].spos += chan[1].sinc;
+    chan[2].spos += chan[2].sinc;
+    chan[3].spos += chan[3].sinc;  
+    chan[4].spos += chan[4].sinc;  
+    chan[5].spos += chan[5].sinc;  
+  }
+#endif         
+}
+
+#ifdef SND_RING
+// Producer side, returns the number of samples queued
+int AudioPlaySystem::push(const short * stream, int len)
+{
+  unsigned int head = ring_head;
+  unsigned int room = SND_RING_SIZE - (head - ring_tail);
+  if ((unsigned int)len > room) {
+    ring_stats.overruns += len - room;
+    len = room;
+  }
+  for (int i=0; i<len; i++) {
+    ring[(head+i) & SND_RING_MASK] = stream[i];
+  }
+  // samples must be visible before the new head
+  __dmb();
+  ring_head = head + len;
+  return len;
+}
+
+int AudioPlaySystem::level(void)
+{
+  return ring_head - ring_tail;
+}
+
+const AudioRingStats & AudioPlaySystem::stats(void)
+{
+  return ring_stats;
+}
+
+void AudioPlaySystem::resetStats(void)
+{
+  memset(&ring_stats, 0, sizeof(ring_stats));
+  ring_stats.minlevel = SND_RING_SIZE;
+}
+
+// Consumer side, called from the audio output
+static void snd_Drain(short *  stream, int len )
+{
+  unsigned int tail = ring_tail;
+  unsigned int avail = ring_head - tail;
+  __dmb();
+
+  if (avail < ring_stats.minlevel) ring_stats.minlevel = avail;
+  if (avail > ring_stats.maxlevel) ring_stats.maxlevel = avail;
+  ring_stats.level = avail;
+
+  if ( (!ring_primed) && (avail >= SND_RING_LATENCY) ) {
+    ring_primed = true;
+    ring_started = true;
+  }
+
+  int rate = 0;
+#if SND_RING_RATECTRL
+  // consume faster above the target latency, slower below it
+  rate = ((int)avail - SND_RING_LATENCY) * SND_RING_RATECTRL / SND_RING_LATENCY;
+  if (rate > SND_RING_RATECTRL) rate = SND_RING_RATECTRL;
+  if (rate < -SND_RING_RATECTRL) rate = -SND_RING_RATECTRL;
+#endif
+  ring_stats.rate = rate;
+  unsigned int step = 0x10000 + rate;
+  unsigned int frac = ring_frac;
+
+  for (int i=0; i<len; i++) {
+    // linear interpolation needs 2 samples
+    if ( (!ring_primed) || (avail < 2) ) {
+      if (ring_started) ring_stats.underruns++;
+      ring_primed = false;
+      *stream++ = ring_last;
+      continue;
+    }
+    int s0 = ring[tail & SND_RING_MASK];
+    int s1 = ring[(tail+1) & SND_RING_MASK];
+    ring_last = (short)(s0 + (((s1-s0) * (int)frac) >> 16));
+    *stream++ = ring_last;
+    frac += step;
+    tail += frac >> 16;
+    avail -= frac >> 16;
+    frac &= 0xffff;
+  }
+
+  ring_frac = frac;
+  // samples must be read before they can be overwritten
+  __dmb();
+  ring_tail = tail;
+}
+#endif
+
 void AudioPlaySystem::snd_Mixer(short *  stream, int len )
 {
   if (playing) 
   {
-#ifdef CUSTOM_SND
-    //printf("s\n");    
-    SND_Process((void*)stream, len);
+#ifdef SND_RING
+    snd_Drain(stream, len);
 #else
-    int i;
-    long s;     
-    //len = len >> 1;   
-    short v0=chan[0].vol;
-    short v1=chan[1].vol;
-    short v2=chan[2].vol;
-    short v3=chan[3].vol;
-    short v4=chan[4].vol;
-    short v5=chan[5].vol;
-    for (i=0;i<len;i++)
-    {
-      s =((v0*square[(chan[0].spos>>8)&0x3f])>>11);
-      s+=((v1*square[(chan[1].spos>>8)&0x3f])>>11);
-      s+=((v2*square[(chan[2].spos>>8)&0x3f])>>11);
-      s+=((v3*noise[(chan[3].spos>>8)&(NOISEBSIZE-1)])>>11);
-      s+=((v4*noise[(chan[4].spos>>8)&(NOISEBSIZE-1)])>>11);
-      s+=((v5*noise[(chan[5].spos>>8)&(NOISEBSIZE-1)])>>11);         
-      *stream++ = (short)(s>>8 /*+ 32767*/);
-      //*stream++ = (short)(s);
-      chan[0].spos += chan[0].sinc;
-      chan[1].spos += chan[1].sinc;
-      chan[2].spos += chan[2].sinc;
-      chan[3].spos += chan[3].sinc;  
-      chan[4].spos += chan[4].sinc;  
-      chan[5].spos += chan[5].sinc;  
-    }
-#endif         
+    snd_Render(stream, len);
+#endif
   }
 }
   
@@ -176,6 +290,18 @@ void AudioPlaySystem::sound(int C, int F, int V) {
 #endif  
 }
 
+// To be called from the emulation loop (e.g. once per frame),
+// renders sound ahead of the output until the target latency is reached
 void AudioPlaySystem::step(void) {
+#if defined(SND_RING) && !defined(SND_RING_PUSH)
+  static short chunk[SND_RING_CHUNK];
+  if (!playing) return;
+  PROF_BEGIN(PROF_AUDIO);
+  while (level() < SND_RING_LATENCY) {
+    snd_Render(chunk, SND_RING_CHUNK);
+    push(chunk, SND_RING_CHUNK);
+  }
+  PROF_END(PROF_AUDIO);
+#endif
 }
 #endif
@@ -5,6 +5,35 @@
 
 #include "platform_config.h"
 
+#ifdef SND_RING
+// Ring between the emulation (producer) and the audio output (consumer)
+// size in samples, must be power of 2
+#ifndef SND_RING_SIZE
+#define SND_RING_SIZE       4096
+#endif
+// fill level the output tries to keep (latency), in samples
+#ifndef SND_RING_LATENCY
+#define SND_RING_LATENCY    (SOUNDRATE/20)
+#endif
+// samples rendered per SND_Process call by step()
+#ifndef SND_RING_CHUNK
+#define SND_RING_CHUNK      256
+#endif
+// max deviation of the output rate (1/65536 units), 0 disables rate control
+#ifndef SND_RING_RATECTRL
+#define SND_RING_RATECTRL   655
+#endif
+
+struct AudioRingStats {
+  unsigned int underruns;   // samples the output had to repeat
+  unsigned int overruns;    // samples dropped by push()
+  unsigned int level;       // current fill level
+  unsigned int minlevel;
+  unsigned int maxlevel;
+  int rate;                 // current output rate correction (1/65536 units)
+};
+#endif
+
 class AudioPlaySystem
 {
 public:
@@ -19,6 +48,12 @@ public:
   void buzz(int size, int val);
   void step(void);
   static void snd_Mixer(short *  stream, int len );  
+#ifdef SND_RING
+  static int push(const short * stream, int len);
+  static int level(void);
+  static const AudioRingStats & stats(void);
+  static void resetStats(void);
+#endif
 };
 
 #endif
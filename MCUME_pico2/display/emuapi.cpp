@@ -33,14 +33,19 @@ static bool emu_eraseGfxConfig(void);
 #include "pico_dsp.h"
 extern PICO_DSP tft;
 
+#ifdef HOST_BUILD
+#include "host.h"
+#endif
+
 #define MAX_FILENAME_PATH   64
 #define NB_FILE_HANDLER     4
 #define AUTORUN_FILENAME    "autorun.txt"
 #define GFX_CFG_FILENAME    "gfxmode.txt"
 #define KBD_CFG_FILENAME    "kbdmode.txt"
 
-#define MAX_FILES           64
 #define MAX_FILENAME_SIZE   32
+#define MAX_MENUDEPTH       8
+#define MAX_MENUSEARCH      16
 #define MAX_MENULINES       9
 #define TEXT_HEIGHT         16
 #define TEXT_WIDTH          8
@@ -64,9 +69,15 @@ static int nbFiles=0;
 static int curFile=0;
 static int topFile=0;
 static char selection[MAX_FILENAME_PATH]="";
-static char selected_filename[MAX_FILENAME_SIZE]="";
-static char files[MAX_FILES][MAX_FILENAME_SIZE];
+static char selected_filename[MAX_FILENAME_PATH]="";
+static bool selected_dir=false;
 static bool menuRedraw=true;
+static int drawnTop=-1;
+static int drawnFile=-1;
+static int menuDepth=0;
+static int menuParent[MAX_MENUDEPTH];
+static char menuSearch[MAX_MENUSEARCH]="";
+static bool menuSearchPending=false;
 
 #if (defined(PICOMPUTER) || defined(PICOZX) )
 static const unsigned short * keys;
@@ -114,51 +125,204 @@ void emu_printh(int val)
   printf("0x%.8\n",val);
 }
 
-static int malbufpt = 0;
-static char malbuf[EXTRA_HEAP];
-
-void * emu_Malloc(int size)
+/********************************
+ * Memory arenas
+ * FAST: static SRAM pool (EXTRA_HEAP), never fragmented
+ * HEAP: system malloc
+ * SLOW: top SLOW_HEAP bytes of the QMI PSRAM, when present
+ * Heap blocks carry a header to be released on reset. Bump arena blocks
+ * have none, so pools sized for their allocations still fit: emu_Free
+ * finds their arena from the address, reclaims the last block only and
+ * empties the arena with its last block (or emu_MemReset).
+********************************/ 
+#ifndef SLOW_HEAP
+#define SLOW_HEAP 0
+#endif
+#define PSRAM_BASE          (0x11000000)
+#define MEM_MAGIC           0x4d45
+#define MEM_ALIGN           8
+#define BUMP_ALIGN          4
+#define BUMP_NONE           0xffffffff
+
+enum {
+  ARENA_FAST = 0,
+  ARENA_HEAP = 1,
+  ARENA_SLOW = 2,
+  NB_ARENAS  = 3
+};
+
+// padded to MEM_ALIGN so the block after it keeps the alignment
+struct __attribute__((aligned(MEM_ALIGN))) MemHeader {
+  struct MemHeader * next;
+  uint32_t size;
+  uint16_t magic;
+  uint16_t arena;
+};
+static_assert((sizeof(MemHeader) % MEM_ALIGN) == 0, "MemHeader must keep MEM_ALIGN");
+
+struct MemArena {
+  const char * name;
+  unsigned char * base;
+  uint32_t capacity;         // 0 for the system heap
+  uint32_t pt;               // bump pointer
+  uint32_t last;             // offset of the last bump block, BUMP_NONE if freed
+  uint32_t used;
+  uint32_t highwater;
+  uint32_t blocks;
+  uint32_t failures;
+};
+
+static char malbuf[EXTRA_HEAP] __attribute__((aligned(MEM_ALIGN)));
+size_t _psram_heap_size = 0;
+static MemHeader * heapblocks = NULL;
+static MemArena arenas[NB_ARENAS] = {
+  { "fast", (unsigned char *)malbuf, sizeof(malbuf), 0, BUMP_NONE, 0, 0, 0, 0 },
+  { "heap", NULL, 0, 0, BUMP_NONE, 0, 0, 0, 0 },
+  { "slow", NULL, 0, 0, BUMP_NONE, 0, 0, 0, 0 },
+};
+
+static void * arenaAlloc(int arena, uint32_t size)
 {
-  void * retval =  malloc(size);
-  if (!retval) {
-    emu_printf("failled to allocate");
-    emu_printf(size);
-    emu_printf("fallback");
-    if ( (malbufpt+size) < sizeof(malbuf) ) {
-      retval = (void *)&malbuf[malbufpt];
-      malbufpt += size;      
-    }
-    else {
-      emu_printf("failure to allocate");
+  MemArena * a = &arenas[arena];
+  void * retval;
+  if (arena == ARENA_HEAP) {
+    uint32_t total = sizeof(MemHeader) + size;
+    MemHeader * h = (MemHeader *)malloc(total);
+    if (h == NULL) {
+      a->failures++;
+      return NULL;
     }
+    h->next = heapblocks;
+    heapblocks = h;
+    h->size = total;
+    h->magic = MEM_MAGIC;
+    h->arena = arena;
+    a->used += total;
+    retval = (void *)(h+1);
   }
   else {
-    emu_printf("could allocate dynamic ");
-    emu_printf(size);    
+    uint32_t start = (a->pt + BUMP_ALIGN-1) & ~(BUMP_ALIGN-1);
+    if ( (a->base == NULL) || (start + size > a->capacity) || (start + size < start) ) {
+      a->failures++;
+      return NULL;
+    }
+    a->last = start;
+    a->pt = start + size;
+    a->used = a->pt;
+    retval = (void *)&a->base[start];
   }
-  
+  a->blocks++;
+  if (a->used > a->highwater) a->highwater = a->used;
   return retval;
 }
 
+void * emu_MallocHint(int size, int hint)
+{
+  static const int order[][NB_ARENAS] = {
+    { ARENA_FAST, ARENA_HEAP, ARENA_SLOW },  // EMU_MEM_HOT
+    { ARENA_HEAP, ARENA_FAST, ARENA_SLOW },  // EMU_MEM_WARM
+    { ARENA_SLOW, ARENA_HEAP, ARENA_FAST },  // EMU_MEM_COLD
+  };
+  if ( (hint < EMU_MEM_HOT) || (hint > EMU_MEM_COLD) ) hint = EMU_MEM_WARM;
+  for (int i=0; i<NB_ARENAS; i++) {
+    void * retval = arenaAlloc(order[hint][i], size);
+    if (retval) return retval;
+  }
+  emu_printf("failure to allocate");
+  emu_printf(size);
+  return NULL;
+}
+
+void * emu_Malloc(int size)
+{
+  return emu_MallocHint(size, EMU_MEM_WARM);
+}
+
 void * emu_MallocI(int size)
 {
-  void * retval =  NULL; 
+  return emu_MallocHint(size, EMU_MEM_HOT);
+}
 
-  if ( (malbufpt+size) < sizeof(malbuf) ) {
-    retval = (void *)&malbuf[malbufpt];
-    malbufpt += size;
-    emu_printf("could allocate static ");
-    emu_printf(size);          
+void emu_Free(void * pt)
+{
+  if (pt == NULL) return;
+  unsigned char * p = (unsigned char *)pt;
+  for (int i=0; i<NB_ARENAS; i++) {
+    MemArena * a = &arenas[i];
+    if ( (a->capacity == 0) || (p < a->base) || (p >= a->base + a->capacity) ) continue;
+    if (a->blocks == 0) {
+      emu_printf("emu_Free: block already freed");
+      return;
+    }
+    a->blocks--;
+    if (a->blocks == 0) {
+      a->pt = 0;
+      a->last = BUMP_NONE;
+    }
+    else if ((uint32_t)(p - a->base) == a->last) {
+      // last block of a bump arena, the one before is not known
+      a->pt = a->last;
+      a->last = BUMP_NONE;
+    }
+    a->used = a->pt;
+    return;
   }
-  else {
-    emu_printf("failure to allocate");
+  MemHeader * h = ((MemHeader *)pt) - 1;
+  if ( (h->magic != MEM_MAGIC) || (h->arena != ARENA_HEAP) ) {
+    emu_printf("emu_Free: not an emu_Malloc block");
+    return;
   }
+  MemArena * a = &arenas[ARENA_HEAP];
+  h->magic = 0;
+  a->used -= h->size;
+  a->blocks--;
+  MemHeader ** link = &heapblocks;
+  while ( (*link != NULL) && (*link != h) ) link = &(*link)->next;
+  if (*link != NULL) *link = h->next;
+  free(h);
+}
 
-  return retval;
+void emu_MemReset(void)
+{
+  while (heapblocks != NULL) {
+    MemHeader * h = heapblocks;
+    heapblocks = h->next;
+    h->magic = 0;
+    free(h);
+  }
+  for (int i=0; i<NB_ARENAS; i++) {
+    arenas[i].pt = 0;
+    arenas[i].last = BUMP_NONE;
+    arenas[i].used = 0;
+    arenas[i].blocks = 0;
+  }
 }
-void emu_Free(void * pt)
+
+int emu_MemHighWater(int hint)
+{
+  static const int arena[] = { ARENA_FAST, ARENA_HEAP, ARENA_SLOW };
+  if ( (hint < EMU_MEM_HOT) || (hint > EMU_MEM_COLD) ) return 0;
+  return arenas[arena[hint]].highwater;
+}
+
+void emu_MemReport(void)
 {
-  free(pt);
+  for (int i=0; i<NB_ARENAS; i++) {
+    MemArena * a = &arenas[i];
+    printf("%s: used %lu high %lu cap %lu blocks %lu failed %lu\n", a->name,
+      (unsigned long)a->used, (unsigned long)a->highwater, (unsigned long)a->capacity,
+      (unsigned long)a->blocks, (unsigned long)a->failures);
+  }
+}
+
+static void setup_slowheap(void)
+{
+  extern size_t _psram_size;
+  if ( (SLOW_HEAP > 0) && (_psram_size > SLOW_HEAP) ) {
+    _psram_heap_size = SLOW_HEAP;
+    arenas[ARENA_SLOW].base = (unsigned char *)(PSRAM_BASE + _psram_size - SLOW_HEAP);
+    arenas[ARENA_SLOW].capacity = SLOW_HEAP;
+  }
 }
 
 void emu_drawText(unsigned short x, unsigned short y, const char * text, unsigned short fgcolor, unsigned short bgcolor, int doublesize)
@@ -731,6 +895,10 @@ unsigned short emu_DebounceLocalKeys(void)
 {
 #ifdef HAS_USBHOST
   tuh_task();
+#endif
+#ifdef HOST_BUILD
+  // end of frame for the cores that never call emu_DrawVsync
+  if (!menuOn) host_vsync(false);
 #endif
   uint16_t bCurState = emu_ReadKeys();
   uint16_t bClick = bCurState & ~bLastState;
@@ -982,42 +1150,47 @@ static FIL file;
 extern "C" int sd_init_driver(void);
 
 #ifdef FILEBROWSER
+// entries of the directory, after ".." below ROMSDIR
 static int readNbFiles(char * rootdir) {
-  int totalFiles = 0;
-
-  DIR dir;
-  FILINFO entry;
-  FRESULT fr = f_findfirst(&dir, &entry, rootdir, "*");
-  while ( (fr == FR_OK) && (entry.fname[0]) && (totalFiles<MAX_FILES) ) {  
-    if (!entry.fname[0]) {
-      // no more files
-      break;
-    }
+  int up = (menuDepth ? 1 : 0);
+  menuSearch[0] = 0;
+  drawnTop = -1;
+  return (emu_DirOpen(rootdir, AUTORUN_FILENAME) + up);
+}
 
-    char * filename = entry.fname;
-    if ( !(entry.fattrib & AM_DIR) ) {
-      if (strcmp(filename,AUTORUN_FILENAME)) {
-        strncpy(&files[totalFiles][0], filename, MAX_FILENAME_SIZE-1);
-        totalFiles++;
-      }  
+static int menuEntry(int index, char * name, int size) {
+  if (menuDepth) {
+    if (index == 0) {
+      strcpy(name, "..");
+      return 1;
     }
-    else {
-      if ( (strcmp(filename,".")) && (strcmp(filename,"..")) ) {
-        strncpy(&files[totalFiles][0], filename, MAX_FILENAME_SIZE-1);
-        totalFiles++;
-      }
-    }
-    fr = f_findnext(&dir, &entry);  
-  } 
-  f_closedir(&dir);
-
-  return totalFiles;  
-}  
-
+    index--;
+  }
+  return emu_DirEntry(index, name, size);
+}
 
+static void menuDrawEntry(int index) {
+  char filename[MAX_FILENAME_PATH];
+  int i = index-topFile;
+  if ( (i < 0) || (i >= MAX_MENULINES) ) return;
+  int dir = menuEntry(index, filename, MAX_FILENAME_PATH);
+  if (dir < 0) return;
+  if (index == curFile) {
+    strcpy(selected_filename,filename);
+    selected_dir = (dir == 1);
+  }
+  filename[MAX_FILENAME_SIZE-1] = 0;
+  if (index == curFile) {
+    tft.drawTextNoDma(MENU_FILE_XOFFSET,i*TEXT_HEIGHT+MENU_FILE_YOFFSET, filename, RGBVAL16(0xff,0xff,0x00), RGBVAL16(0xff,0x00,0x00), true);
+  }
+  else {
+    tft.drawTextNoDma(MENU_FILE_XOFFSET,i*TEXT_HEIGHT+MENU_FILE_YOFFSET, filename, RGBVAL16(0xff,0xff,0xff), MENU_FILE_BGCOLOR, true);
+  }
+}
 
 void backgroundMenu(void) {
     menuRedraw=true;  
+    drawnTop=-1;
     tft.fillScreenNoDma(RGBVAL16(0x00,0x00,0x00));
     tft.drawTextNoDma(0,0, TITLE, RGBVAL16(0x00,0xff,0xff), RGBVAL16(0x00,0x00,0xff), true);           
 }
@@ -1056,44 +1229,50 @@ int handleMenu(uint16_t bClick)
   }
 
   if ( (bClick & MASK_JOY2_BTN) || (bClick & MASK_KEY_USER1) || (bClick & MASK_KEY_USER4) ) {
-    char newpath[MAX_FILENAME_PATH];
-    strcpy(newpath, selection);
-    strcat(newpath, "/");
-    strcat(newpath, selected_filename);
-    strcpy(selection,newpath);
-    emu_printf("new filepath is");
-    emu_printf(selection);
-    FILINFO entry;
-    FRESULT fr;
-    fr = f_stat(selection, &entry);
-    if ( (fr == FR_OK) && (entry.fattrib & AM_DIR) ) {
+    if ( (menuDepth) && (curFile == 0) ) {
+      // back to the parent, at the entry it was left from
+      char * pt = strrchr(selection, '/');
+      if (pt) *pt = 0;
+      curFile = menuParent[--menuDepth];
+      nbFiles = readNbFiles(selection);
+      menuRedraw=true;
+    }
+    else if ( (nbFiles) && (strlen(selection)+1+strlen(selected_filename) < MAX_FILENAME_PATH) &&
+              ( (!selected_dir) || (menuDepth < MAX_MENUDEPTH) ) ) {
+      strcat(selection, "/");
+      strcat(selection, selected_filename);
+      emu_printf("new filepath is");
+      emu_printf(selection);
+      if (selected_dir) {
+        menuParent[menuDepth++] = curFile;
         curFile = 0;
         nbFiles = readNbFiles(selection);
         menuRedraw=true;
-    }
-    else
-    {
-#ifdef PICOMPUTER
-      if (key_alt) {
-        emu_writeConfig();
       }
+      else
+      {
+#ifdef PICOMPUTER
+        if (key_alt) {
+          emu_writeConfig();
+        }
 #endif
 #ifdef PICOZX
-      if (bClick & MASK_KEY_USER4) {
-        emu_writeConfig();
-      }
+        if (bClick & MASK_KEY_USER4) {
+          emu_writeConfig();
+        }
 #endif
-      menuLeft();
-      toggleMenu(false);
-      menuRedraw=false;
+        menuLeft();
+        toggleMenu(false);
+        menuRedraw=false;
 #ifdef PICOZX
-      if ( tft.getMode() != MODE_VGA_320x240) {   
-        if ( (bClick & MASK_KEY_USER1) ) {
-          tft.begin(MODE_VGA_320x240);
+        if ( tft.getMode() != MODE_VGA_320x240) {   
+          if ( (bClick & MASK_KEY_USER1) ) {
+            tft.begin(MODE_VGA_320x240);
+          }
         }
-      }
 #endif
-      return (ACTION_RUN);
+        return (ACTION_RUN);
+      }
     }
   }
   else if ( (bClick & MASK_JOY2_UP) || (bClick & MASK_JOY1_UP) ) {
@@ -1132,37 +1311,37 @@ int handleMenu(uint16_t bClick)
     menuRedraw=true;  
   } 
 
+  else if (menuSearchPending) {
+    // typed prefix, to the first entry starting with it
+    int found = emu_DirFind(menuSearch);
+    if (found >= 0) curFile = found + (menuDepth ? 1 : 0);
+    menuSearchPending=false;
+    menuRedraw=true;
+  }
+
   if (menuRedraw && nbFiles) {
-    int fileIndex = 0;
-    tft.drawRectNoDma(MENU_FILE_XOFFSET,MENU_FILE_YOFFSET, MENU_FILE_W, MENU_FILE_H, MENU_FILE_BGCOLOR);
 //    if (curFile <= (MAX_MENULINES/2-1)) topFile=0;
 //    else topFile=curFile-(MAX_MENULINES/2);
     if (curFile <= (MAX_MENULINES-1)) topFile=0;
     else topFile=curFile-(MAX_MENULINES/2);
 
-    int i=0;
-    while (i<MAX_MENULINES) {
-      if (fileIndex>=nbFiles) {
-          // no more files
-          break;
-      }
-      char * filename = &files[fileIndex][0];    
-      if (fileIndex >= topFile) {              
-        if ((i+topFile) < nbFiles ) {
-          if ((i+topFile)==curFile) {
-            tft.drawTextNoDma(MENU_FILE_XOFFSET,i*TEXT_HEIGHT+MENU_FILE_YOFFSET, filename, RGBVAL16(0xff,0xff,0x00), RGBVAL16(0xff,0x00,0x00), true);
-            strcpy(selected_filename,filename);            
-          }
-          else {
-            tft.drawTextNoDma(MENU_FILE_XOFFSET,i*TEXT_HEIGHT+MENU_FILE_YOFFSET, filename, RGBVAL16(0xff,0xff,0xff), MENU_FILE_BGCOLOR, true);      
-          }
-        }
-        i++; 
+    if (drawnTop == topFile) {
+      // same page, only the old and new highlighted lines
+      if (drawnFile != curFile) menuDrawEntry(drawnFile);
+      menuDrawEntry(curFile);
+    }
+    else {
+      tft.drawRectNoDma(MENU_FILE_XOFFSET,MENU_FILE_YOFFSET, MENU_FILE_W, MENU_FILE_H, MENU_FILE_BGCOLOR);
+      for (int i=topFile; (i<nbFiles) && (i<topFile+MAX_MENULINES); i++) {
+        menuDrawEntry(i);
       }
-      fileIndex++;    
+      drawnTop = topFile;
     }
+    drawnFile = curFile;
 
-     
+    char search[MAX_MENUSEARCH+8];
+    snprintf(search, sizeof(search), "%-*s", MAX_MENUSEARCH+1, menuSearch);
+    tft.drawTextNoDma(MENU_FILE_XOFFSET+8*TEXT_WIDTH,MENU_JOYS_YOFFSET+8, search, RGBVAL16(0xff,0xff,0x00), RGBVAL16(0x00,0x00,0x00), false);
     tft.drawTextNoDma(48,MENU_JOYS_YOFFSET+8, (emu_SwapJoysticks(1)?(char*)"SWAP=1":(char*)"SWAP=0"), RGBVAL16(0x00,0xff,0xff), RGBVAL16(0x00,0x00,0xff), false);
     menuRedraw=false;     
   }
@@ -1219,12 +1398,37 @@ static void signal_joy (int code, int pressed, int flags) {
   if ( (code == ' ') && (!pressed) ) usbnavpad &= ~MASK_KEY_USER4;
 }
 
+#ifdef FILEBROWSER
+// typed characters build a prefix, looked up by handleMenu
+static void menuSearchKey(int code, int pressed)
+{
+  if (!pressed) return;
+  int len = strlen(menuSearch);
+  if ( (code == KBD_KEY_BS) || (code == 8) ) {
+    if (len) menuSearch[len-1] = 0;
+  }
+  // keys of the menu itself
+  else if ( (code == '\t') || (code == '1') || (code == '2') || (code == ' ') ) {
+    return;
+  }
+  else if ( (code > ' ') && (code < 0x7f) && (len < MAX_MENUSEARCH-1) ) {
+    menuSearch[len] = code;
+    menuSearch[len+1] = 0;
+  }
+  else {
+    return;
+  }
+  menuSearchPending = true;
+}
+#endif
+
 void kbd_signal_raw_key (int keycode, int code, int codeshifted, int flags, int pressed) {
   //printf("k %d\r\n", keycode); 
 #ifdef FILEBROWSER
   if (menuActive())
   {
     signal_joy(code, pressed, flags);          
+    menuSearchKey(code, pressed);
   }
   else  
 #endif  
@@ -1260,14 +1464,122 @@ void kbd_signal_raw_key (int keycode, int code, int codeshifted, int flags, int
 /********************************
  * File IO
 ********************************/ 
+// Read-ahead buffer per handle, a power of 2 multiple of the sector size.
+// Refills are aligned on the buffer size so they never straddle a cluster.
+#ifndef FILE_BUFFER_SIZE
+#define FILE_BUFFER_SIZE    1024
+#endif
+// Files above this size get a FatFs fast seek cluster map
+#define FILE_FASTSEEK_MIN   (512*1024)
+#define FILE_CLMT_SIZE      64
+
+struct FileHandler {
+  FIL fil;
+  bool used;
+  FSIZE_t pos;              // logical position
+  bool zip;                 // compressed, read through emu_ZipRead
+  int zpos;                 // position in the uncompressed file
+  FSIZE_t bufpos;           // file offset of buf[0]
+  unsigned int buflen;      // valid bytes in buf
+#if FF_USE_FASTSEEK
+  DWORD clmt[FILE_CLMT_SIZE];
+#endif
+  unsigned char buf[FILE_BUFFER_SIZE];
+};
+
+static FileHandler file_handlers[NB_FILE_HANDLER];
+
+static FileHandler * getFileHandler(int handler) {
+  if ( (handler < 1) || (handler > NB_FILE_HANDLER) || (!file_handlers[handler-1].used) ) {
+    emu_printf("Invalid file handler");
+    return NULL;
+  }
+  return (&file_handlers[handler-1]);
+}
+
+static bool fileSync(FileHandler * h, FSIZE_t pos) {
+  if (f_tell(&h->fil) == pos) return true;
+  return (f_lseek(&h->fil, pos) == FR_OK);
+}
+
+static int fileRead(FileHandler * h, unsigned char * dst, int size) {
+  int total = 0;
+  while (size > 0) {
+    if ( (h->pos >= h->bufpos) && (h->pos < (h->bufpos + h->buflen)) ) {
+      unsigned int offs = h->pos - h->bufpos;
+      unsigned int n = h->buflen - offs;
+      if (n > (unsigned int)size) n = size;
+      memcpy(dst, &h->buf[offs], n);
+      dst += n; size -= n; total += n; h->pos += n;
+      continue;
+    }
+    unsigned int br = 0;
+    if ( (size >= FILE_BUFFER_SIZE) && !(h->pos & (FF_MIN_SS-1)) ) {
+      // whole sectors go straight to the destination
+      unsigned int n = size & ~(FF_MIN_SS-1);
+      if ( (!fileSync(h, h->pos)) || (f_read(&h->fil, dst, n, &br)) ) break;
+      dst += br; size -= br; total += br; h->pos += br;
+      if (br < n) break;
+      continue;
+    }
+    FSIZE_t start = h->pos & ~((FSIZE_t)FILE_BUFFER_SIZE-1);
+    h->buflen = 0;
+    if ( (!fileSync(h, start)) || (f_read(&h->fil, h->buf, FILE_BUFFER_SIZE, &br)) ) break;
+    h->bufpos = start;
+    h->buflen = br;
+    if (h->pos >= (start + br)) break;
+  }
+  return total;
+}
+
 int emu_FileOpen(const char * filepath, const char * mode)
 {
   int retval = 0;
+  char archive[MAX_FILENAME_PATH];
 
   emu_printf("FileOpen...");
   emu_printf(filepath);
-  if( !(f_open(&file, filepath, FA_READ)) ) {
-    retval = 1;  
+  const char * member = emu_ZipPath(filepath, archive, MAX_FILENAME_PATH);
+  int handler = -1;
+  for (int i=0; i<NB_FILE_HANDLER; i++) {
+    if (!file_handlers[i].used) {
+      handler = i;
+      break;
+    }
+  }
+  if (handler < 0) {
+    emu_printf("No free file handler");
+    return (retval);
+  }
+  FileHandler * h = &file_handlers[handler];
+  if( !(f_open(&h->fil, member ? archive : filepath, FA_READ)) ) {
+    h->used = true;
+    h->pos = 0;
+    h->zip = false;
+    h->zpos = 0;
+    h->bufpos = 0;
+    h->buflen = 0;
+#if FF_USE_FASTSEEK
+    if (f_size(&h->fil) >= FILE_FASTSEEK_MIN) {
+      h->clmt[0] = FILE_CLMT_SIZE;
+      h->fil.cltbl = h->clmt;
+      if (f_lseek(&h->fil, CREATE_LINKMAP) != FR_OK) {
+        // too fragmented, fall back to FAT chain walking
+        h->fil.cltbl = NULL;
+      }
+    }
+#endif
+    retval = handler+1;
+    if (member) {
+      int zip = emu_ZipOpen(retval, archive, member);
+      if (zip < 0) {
+        f_close(&h->fil);
+        h->used = false;
+        emu_printf("FileOpen failed");
+        return 0;
+      }
+      h->zip = (zip > 0);
+    }
   }
   else {
     emu_printf("FileOpen failed");
@@ -1275,58 +1587,231 @@ int emu_FileOpen(const char * filepath, const char * mode)
   return (retval);
 }
 
+// read/write, the file is created and allocated to size bytes if shorter
+int emu_FileOpenRW(const char * filepath, int size)
+{
+  emu_printf("FileOpenRW...");
+  emu_printf(filepath);
+  for (int i=0; i<NB_FILE_HANDLER; i++) {
+    if (!file_handlers[i].used) {
+      FileHandler * h = &file_handlers[i];
+      if (f_open(&h->fil, filepath, FA_READ | FA_WRITE | FA_OPEN_ALWAYS)) {
+        emu_printf("FileOpenRW failed");
+        return 0;
+      }
+      if (f_size(&h->fil) < (FSIZE_t)size) {
+        // clusters are allocated once, later writes do not touch the FAT
+        if ( (f_lseek(&h->fil, size)) || (f_sync(&h->fil)) ) {
+          emu_printf("FileOpenRW no space");
+          f_close(&h->fil);
+          return 0;
+        }
+      }
+      h->used = true;
+      h->pos = 0;
+      h->zip = false;
+      h->bufpos = 0;
+      h->buflen = 0;
+      return i+1;
+    }
+  }
+  emu_printf("No free file handler");
+  return 0;
+}
+
+int emu_FileWrite(void * buf, int size, int handler)
+{
+  FileHandler * h = getFileHandler(handler);
+  if (h == NULL) return 0;
+  PROF_BEGIN(PROF_IO);
+  unsigned int bw = 0;
+  if ( (fileSync(h, h->pos)) && !(f_write(&h->fil, buf, size, &bw)) ) {
+    // read-ahead data of the written range is stale
+    if ( (h->pos < (h->bufpos + h->buflen)) && ((h->pos + bw) > h->bufpos) ) h->buflen = 0;
+    h->pos += bw;
+  }
+  PROF_END(PROF_IO);
+  return bw;
+}
+
+int emu_FileSync(int handler)
+{
+  FileHandler * h = getFileHandler(handler);
+  if (h == NULL) return -1;
+  return (f_sync(&h->fil) == FR_OK) ? 0 : -1;
+}
+
+int emu_FileReadRaw(void * buf, int size, int handler)
+{
+  FileHandler * h = getFileHandler(handler);
+  if (h == NULL) return 0;
+  PROF_BEGIN(PROF_IO);
+  int n = fileRead(h, (unsigned char *)buf, size);
+  PROF_END(PROF_IO);
+  return n;
+}
+
 int emu_FileRead(void * buf, int size, int handler)
 {
-  unsigned int retval=0; 
-  f_read (&file, (void*)buf, size, &retval);
-  return retval; 
+  FileHandler * h = getFileHandler(handler);
+  if (h == NULL) return 0;
+  if (h->zip) {
+    int n = emu_ZipRead(handler, buf, size, h->zpos);
+    h->zpos += n;
+    return n;
+  }
+  return emu_FileReadRaw(buf, size, handler);
 }
 
 int emu_FileGetc(int handler)
 {
+  FileHandler * h = getFileHandler(handler);
+  if (h == NULL) return -1;
+  if (h->zip) {
+    unsigned char c;
+    return (emu_FileRead(&c, 1, handler) == 1) ? c : -1;
+  }
+  if ( (h->pos >= h->bufpos) && (h->pos < (h->bufpos + h->buflen)) ) {
+    return h->buf[h->pos++ - h->bufpos];
+  }
   unsigned char c;
-  unsigned int retval=0;
-  if( !(f_read (&file, &c, 1, &retval)) )
-  if (retval != 1) {
+  if (fileRead(h, &c, 1) != 1) {
     emu_printf("emu_FileGetc failed");
-  }  
-  return (int)c; 
+    return -1;
+  }
+  return (int)c;
 }
 
 void emu_FileClose(int handler)
 {
-  f_close(&file); 
+  FileHandler * h = getFileHandler(handler);
+  if (h == NULL) return;
+  if (h->zip) emu_ZipClose(handler);
+  f_close(&h->fil);
+  h->used = false;
+}
+
+int emu_FileSeekRaw(int handler, int seek, int origin)
+{
+  FileHandler * h = getFileHandler(handler);
+  if (h == NULL) return -1;
+  long pos;
+  switch (origin) {
+    case SEEK_CUR:
+      pos = (long)h->pos + seek;
+      break;
+    case SEEK_END:
+      pos = (long)f_size(&h->fil) + seek;
+      break;
+    default:
+      pos = seek;
+      break;
+  }
+  if (pos < 0) return -1;
+  // lazy, the FatFs pointer only moves on the next buffer miss
+  h->pos = pos;
+  return (pos);
 }
 
 int emu_FileSeek(int handler, int seek, int origin)
 {
-  f_lseek(&file, seek);
-  return (seek);
+  FileHandler * h = getFileHandler(handler);
+  if (h == NULL) return -1;
+  if (!h->zip) return emu_FileSeekRaw(handler, seek, origin);
+  long pos;
+  switch (origin) {
+    case SEEK_CUR:
+      pos = (long)h->zpos + seek;
+      break;
+    case SEEK_END:
+      pos = (long)emu_ZipSize(handler) + seek;
+      break;
+    default:
+      pos = seek;
+      break;
+  }
+  if (pos < 0) return -1;
+  // inflated on the next read
+  h->zpos = pos;
+  return (pos);
 }
 
 int emu_FileTell(int handler)
 {
-  return (f_tell(&file));
+  FileHandler * h = getFileHandler(handler);
+  if (h == NULL) return -1;
+  return h->zip ? h->zpos : h->pos;
+}
+
+// whole file or part of it through a handle, for compressed files
+static int zipLoad(const char * filepath, int offset, void * buf, int size, bool whole)
+{
+  int f = emu_FileOpen(filepath, "r+b");
+  if (!f) return -1;
+  int filesize = emu_FileSeek(f, 0, SEEK_END);
+  int n = 0;
+  if (whole) {
+    if (size >= filesize) n = emu_FileRead(buf, filesize, f);
+    // short when the data is corrupt
+    if ( (size >= filesize) && (n != filesize) ) filesize = -1;
+  }
+  else {
+    emu_FileSeek(f, offset, SEEK_SET);
+    n = emu_FileRead(buf, size, f);
+  }
+  emu_FileClose(f);
+  return whole ? filesize : n;
 }
 
 
 unsigned int emu_FileSize(const char * filepath)
 {
   int filesize=0;
+  char archive[MAX_FILENAME_PATH];
   emu_printf("FileSize...");
   emu_printf(filepath);
+  if (emu_ZipPath(filepath, archive, MAX_FILENAME_PATH)) {
+    int f = emu_FileOpen(filepath, "r+b");
+    if (f) {
+      filesize = emu_FileSeek(f, 0, SEEK_END);
+      emu_FileClose(f);
+    }
+    return(filesize);
+  }
   FILINFO entry;
   f_stat(filepath, &entry);
   filesize = entry.fsize; 
   return(filesize);    
 }
 
+unsigned int emu_FileDate(const char * filepath)
+{
+  FILINFO entry;
+  char archive[MAX_FILENAME_PATH];
+  if (emu_ZipPath(filepath, archive, MAX_FILENAME_PATH)) filepath = archive;
+  if (f_stat(filepath, &entry)) return 0;
+  return ((unsigned int)entry.fdate << 16) | entry.ftime;
+}
+
+int emu_FileRename(const char * from, const char * to)
+{
+  // FatFs does not rename over an existing file
+  f_unlink(to);
+  return (f_rename(from, to) == FR_OK) ? 0 : -1;
+}
+
 unsigned int emu_LoadFile(const char * filepath, void * buf, int size)
 {
   int filesize = 0;
+  char archive[MAX_FILENAME_PATH];
     
   emu_printf("LoadFile...");
   emu_printf(filepath);
+  if (emu_ZipPath(filepath, archive, MAX_FILENAME_PATH)) {
+    filesize = zipLoad(filepath, 0, buf, size, true);
+    return (filesize < 0) ? 0 : filesize;
+  }
+  PROF_BEGIN(PROF_IO);
   if( !(f_open(&file, filepath, FA_READ)) ) {
     filesize = f_size(&file);
     emu_printf(filesize);
@@ -1339,10 +1824,43 @@ unsigned int emu_LoadFile(const char * filepath, void * buf, int size)
     }
     f_close(&file);
   }
+  PROF_END(PROF_IO);
  
   return(filesize);
 }
 
+// size bytes from offset straight into buf, in one f_read: FatFs already
+// reads the whole sectors of each cluster with one multi-block transfer
+int emu_FileLoad(const char * filepath, int offset, void * buf, int size)
+{
+  int total = -1;
+  char archive[MAX_FILENAME_PATH];
+
+  emu_printf("FileLoad...");
+  emu_printf(filepath);
+  if (emu_ZipPath(filepath, archive, MAX_FILENAME_PATH)) {
+    return zipLoad(filepath, offset, buf, size, false);
+  }
+  PROF_BEGIN(PROF_IO);
+  if( !(f_open(&file, filepath, FA_READ)) ) {
+    total = 0;
+    if (f_lseek(&file, offset) == FR_OK) {
+      unsigned int br = 0;
+      if (f_read(&file, buf, size, &br)) {
+        emu_printf("File read failed");
+      }
+      total = br;
+    }
+    f_close(&file);
+  }
+  else {
+    emu_printf("FileLoad failed");
+  }
+  PROF_END(PROF_IO);
+
+  return(total);
+}
+
 static FIL outfile; 
 
 static bool emu_writeGfxConfig(void)
@@ -1583,6 +2101,7 @@ static void __no_inline_not_in_flash_func(setup_psram)(void) {
 void emu_init(void)
 {
   setup_psram();
+  setup_slowheap();
 
   //board_init();
   stdio_init_all();
@@ -1707,6 +2226,17 @@ int keypressed = emu_ReadKeys();
     }
   }  
 
+#ifdef HOST_BUILD
+  // the ROM of the command line, run as an autorun file would
+  if (strlen(host_options.rom) < MAX_FILENAME_PATH) {
+    strcpy(selection, host_options.rom);
+    autorun = true;
+  }
+  else {
+    emu_printf("rom path too long");
+  }
+#endif
+
 #ifdef FILEBROWSER
   toggleMenu(true);
 #endif  
@@ -1718,6 +2248,9 @@ void kbd_signal_raw_gamepad(uint16_t new_pad_state) {
 
 void emu_start(void)
 {
+  // nothing allocated by the menu outlives it, the core starts with empty arenas
+  emu_MemReset();
+
   usbnavpad = 0;
 
   keyMap = 0;
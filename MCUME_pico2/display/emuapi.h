@@ -23,6 +23,19 @@
 #define MASK_KEY_USER4  0x2000
 #define MASK_OSKB       0x8000
 
+// emu_MallocHint placement hints
+#define EMU_MEM_HOT     0   // fast SRAM first (static pool)
+#define EMU_MEM_WARM    1   // system heap first
+#define EMU_MEM_COLD    2   // PSRAM slow heap first (SLOW_HEAP in emucfg.h)
+
+// emu_Prof zones, time spent in nested zones is not counted in the outer one
+#define PROF_CPU        0
+#define PROF_VIDEO      1   // rendering of the emulated picture
+#define PROF_AUDIO      2
+#define PROF_IO         3   // file and flash access
+#define PROF_DISPLAY    4   // transfer to the display (PICO_DSP)
+#define PROF_ZONES      5
+
 #define RGBVAL16(r,g,b)  ( (((r>>3)&0x1f)<<11) | (((g>>2)&0x3f)<<5) | (((b>>3)&0x1f)<<0) )
 #define RGB888(r, g, b) ((r<<16) | (g << 8 ) | b )
 
@@ -38,6 +51,11 @@ extern void emu_printf(const char * text);
 extern void emu_printi(int val);
 extern void * emu_Malloc(int size);
 extern void emu_Free(void * pt);
+extern void * emu_MallocHint(int size, int hint);
+extern void * emu_MallocI(int size);
+extern void emu_MemReset(void);
+extern int emu_MemHighWater(int hint);
+extern void emu_MemReport(void);
 
 extern int emu_FileOpen(const char * filepath, const char * mode);
 extern int emu_FileRead(void * buf, int size, int handler);
@@ -45,9 +63,55 @@ extern int emu_FileGetc(int handler);
 extern int emu_FileSeek(int handler, int seek, int origin);
 extern int emu_FileTell(int handler);
 extern void emu_FileClose(int handler);
+extern int emu_FileOpenRW(const char * filepath, int size);
+extern int emu_FileWrite(void * buf, int size, int handler);
+extern int emu_FileSync(int handler);
 
 extern unsigned int emu_FileSize(const char * filepath);
+extern unsigned int emu_FileDate(const char * filepath);
+// from replaces to, if there is one
+extern int emu_FileRename(const char * from, const char * to);
 extern unsigned int emu_LoadFile(const char * filepath, void * buf, int size);
+// up to size bytes from offset, returns the bytes read or -1 if it can't be opened
+extern int emu_FileLoad(const char * filepath, int offset, void * buf, int size);
+
+// compressed files (emuzip.cpp), used by the file layer: .gz, .zip and
+// <archive>.zip/<member> are read and sized as the uncompressed file
+extern const char * emu_ZipPath(const char * filepath, char * archive, int size);
+extern int emu_ZipOpen(int handler, const char * archive, const char * member);
+extern int emu_ZipSize(int handler);
+extern int emu_ZipRead(int handler, void * buf, int size, int pos);
+extern void emu_ZipClose(int handler);
+// crc32 of the zip/gzip files, crc of the previous part or 0
+extern unsigned int emu_Crc32(unsigned int crc, const void * buf, int len);
+// the file as stored on the card
+extern int emu_FileReadRaw(void * buf, int size, int handler);
+extern int emu_FileSeekRaw(int handler, int seek, int origin);
+
+// sorted listing of a directory for the file browser (emudir.cpp), hide is
+// left out of it, entries return 1 for a directory, 0 for a file
+extern int emu_DirOpen(const char * path, const char * hide);
+extern int emu_DirEntry(int index, char * name, int size);
+extern int emu_DirFind(const char * prefix);
+
+// filepath with its extension replaced by ext (e.g. ".sav"), next to the
+// archive for a member of one, 0 if it does not fit in size
+extern int emu_FileNameExt(char * path, const char * filepath, const char * ext, int size);
+
+// battery backed RAM, loaded from and saved to <rom>.sav (emusave.cpp)
+extern int emu_SaveRegister(const char * filepath, void * mem, int size);
+extern void emu_SaveVsync(void);
+
+// save states in <rom>.st<slot> (emustate.cpp), the callbacks of the core
+// give (emu_StateChunk) or take back (emu_StateRestore) their buffers by name,
+// emu_StateSize is the size of a chunk of the state being loaded, -1 if absent
+extern int emu_StateRegister(const char * filepath, const char * core, int version, int (*save)(void), int (*load)(void));
+extern void emu_StateChunk(const char * key, void * buf, int size);
+extern int emu_StateRestore(const char * key, void * buf, int size);
+extern int emu_StateSize(const char * key);
+extern int emu_StateSave(int slot);
+extern int emu_StateLoad(int slot);
+extern void emu_StateHotkeys(void);
 
 extern void emu_SetPaletteEntry(unsigned char r, unsigned char g, unsigned char b, int index);
 extern void emu_DrawLinePal16(unsigned char * VBuf, int width, int height, int line);
@@ -76,6 +140,7 @@ extern void emu_sndPlaySound(int chan, int volume, int freq);
 extern void emu_sndPlayBuzz(int size, int val);
 extern void * emu_sndGetBuffer(void);
 extern void emu_sndInit();
+extern int emu_sndPush(short * stream, int len);
 extern void emu_resetus(void);
 extern int emu_us(void);
 
@@ -85,9 +150,35 @@ extern void emu_FileTempInit(void);
 extern void emu_FileTempRead(int addr, unsigned char * val, int n); 
 extern void emu_FileTempWrite(int addr, unsigned char val); 
 extern void emu_printh(int val);
+
+typedef struct {
+  unsigned int frames;
+  unsigned int frame_us;              // sum over all frames
+  unsigned int frame_max_us;
+  unsigned int zone_us[PROF_ZONES];   // exclusive time per zone
+  unsigned int zone_calls[PROF_ZONES];
+} EmuProfStats;
+
+extern void emu_ProfBegin(int zone);
+extern void emu_ProfEnd(int zone);
+extern void emu_ProfFrame(void);
+extern void emu_ProfReset(void);
+extern const EmuProfStats * emu_ProfStats(void);
+extern const char * emu_ProfZoneName(int zone);
+extern void emu_ProfReport(void);
 #ifdef __cplusplus
 }
 #endif
 
+// profiling compiles to nothing unless EMU_PROF is defined (emucfg.h or build)
+#ifdef EMU_PROF
+#define PROF_BEGIN(zone)  emu_ProfBegin(zone)
+#define PROF_END(zone)    emu_ProfEnd(zone)
+#define PROF_FRAME()      emu_ProfFrame()
+#else
+#define PROF_BEGIN(zone)
+#define PROF_END(zone)
+#define PROF_FRAME()
+#endif
 
 #endif
@@ -0,0 +1,395 @@
+/*
+  Directory listing of the file browser.
+  Entries are sorted once into an index file kept in the directory itself
+  (DIR_INDEX_NAME), the menu then reads it a page at a time, so a folder
+  can hold any number of titles for the RAM of DIR_PAGE entries.
+  FAT writers do not reliably update the date of a directory, so the index
+  is checked against a signature of the listing (names, sizes, dates):
+  a scan without sorting nor storing anything, done once per directory
+  and session. The index is rebuilt when the signature differs.
+  Building sorts runs of entries in RAM and merges them between the index
+  and a temporary file, its header is written last.
+  Cards which can't be written fall back to an unsorted listing.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+#include "ff.h"
+#include "emuapi.h"
+
+#define DIR_INDEX_NAME  ".dirindex"
+#define DIR_TEMP_NAME   ".dirindex.tmp"
+#define DIR_MAGIC       0x3158444d  // "MDX1"
+#define DIR_RECORD      64
+#define DIR_NAME_SIZE   (DIR_RECORD-1)
+#define DIR_PAGE        16          // entries held in RAM
+#define DIR_RUN         512         // entries sorted in RAM per run while building
+#define DIR_CHECKED     8           // directories checked during this session
+#define DIR_PATH        64
+
+typedef struct {
+  char name[DIR_NAME_SIZE];         // zero terminated
+  unsigned char dir;
+} DirRecord;
+
+typedef struct {
+  unsigned int magic;
+  unsigned int count;
+  unsigned int signature;
+  unsigned char pad[DIR_RECORD-12];
+} DirHeader;
+
+// buffered run of records, while merging
+typedef struct {
+  FIL * f;
+  DirRecord * buf;
+  int cap;
+  int n;
+  int i;
+  int next;
+  int end;
+} DirRun;
+
+static char dirpath[DIR_PATH];
+static char dirhide[DIR_NAME_SIZE];
+static int dircount = 0;
+static bool dirindexed = false;     // false: unsorted, listed from the directory
+static DirRecord page[DIR_PAGE];
+static int pagefirst = -1;
+static unsigned int checked[DIR_CHECKED];
+static int nchecked = 0;
+
+
+static unsigned int hashBytes(const void * buf, int len, unsigned int h)
+{
+  // FNV-1a
+  const unsigned char * pt = (const unsigned char *)buf;
+  while (len--) h = (h ^ *pt++) * 16777619;
+  return h;
+}
+
+static bool dirFileName(char * out, const char * name)
+{
+  return (snprintf(out, DIR_PATH, "%s/%s", dirpath, name) < DIR_PATH);
+}
+
+// battery saves (.sav) and states (.stt, .st0-.st9) written next to the roms
+static bool dirSaveFile(const char * name)
+{
+  const char * ext = strrchr(name, '.');
+  if ( (ext == NULL) || (strlen(ext) != 4) ) return false;
+  if ( (!strcasecmp(ext, ".sav")) || (!strcasecmp(ext, ".stt")) ) return true;
+  return ( (!strncasecmp(ext, ".st", 3)) && (ext[3] >= '0') && (ext[3] <= '9') );
+}
+
+// name listed for an entry, the short one if the long one doesn't fit a record
+static const char * dirName(const FILINFO * entry)
+{
+  if (strlen(entry->fname) < DIR_NAME_SIZE) return entry->fname;
+  return entry->altname;
+}
+
+static bool dirVisible(const FILINFO * entry)
+{
+  const char * name = entry->fname;
+  // no ".", "..", index files or other hidden ones
+  if ( (name[0] == 0) || (name[0] == '.') ) return false;
+  if (entry->fattrib & (AM_HID | AM_SYS)) return false;
+  if (!strcasecmp(name, dirhide)) return false;
+  if ( (!(entry->fattrib & AM_DIR)) && (dirSaveFile(name)) ) return false;
+  // too long and no short name (exFAT)
+  return (dirName(entry)[0] != 0);
+}
+
+static int dirCompare(const void * a, const void * b)
+{
+  return strcasecmp(((const DirRecord *)a)->name, ((const DirRecord *)b)->name);
+}
+
+static void dirRecord(DirRecord * r, const FILINFO * entry)
+{
+  memset(r, 0, sizeof(DirRecord));
+  strcpy(r->name, dirName(entry));
+  r->dir = (entry->fattrib & AM_DIR) ? 1 : 0;
+}
+
+// signature of the listing, its entries are written as sorted runs to out if given
+static bool dirScan(unsigned int * signature, int * count, FIL * out, DirRecord * run, int runsize)
+{
+  DIR dir;
+  FILINFO entry;
+  unsigned int sig = 2166136261u;
+  int n = 0;
+  int inrun = 0;
+  UINT bw;
+  if (f_opendir(&dir, dirpath) != FR_OK) return false;
+  while ( (f_readdir(&dir, &entry) == FR_OK) && (entry.fname[0]) ) {
+    if (!dirVisible(&entry)) {
+      if ( (out) && (entry.fname[0] != '.') && (!(entry.fattrib & (AM_HID | AM_SYS))) && (dirName(&entry)[0] == 0) ) {
+        emu_printf("name too long, not listed:");
+        emu_printf(entry.fname);
+      }
+      continue;
+    }
+    if ( (out) && (dirName(&entry) != entry.fname) ) {
+      emu_printf("name too long, listed as:");
+      emu_printf(entry.altname);
+    }
+    sig = hashBytes(entry.fname, strlen(entry.fname), sig);
+    sig = hashBytes(&entry.fsize, sizeof(entry.fsize), sig);
+    sig = hashBytes(&entry.fdate, sizeof(entry.fdate), sig);
+    sig = hashBytes(&entry.ftime, sizeof(entry.ftime), sig);
+    n++;
+    if (out) {
+      dirRecord(&run[inrun++], &entry);
+      if (inrun == runsize) {
+        qsort(run, inrun, sizeof(DirRecord), dirCompare);
+        if ( (f_write(out, run, inrun*DIR_RECORD, &bw)) || (bw != (UINT)(inrun*DIR_RECORD)) ) break;
+        inrun = 0;
+      }
+    }
+  }
+  f_closedir(&dir);
+  if ( (out) && (inrun) ) {
+    qsort(run, inrun, sizeof(DirRecord), dirCompare);
+    if ( (f_write(out, run, inrun*DIR_RECORD, &bw)) || (bw != (UINT)(inrun*DIR_RECORD)) ) return false;
+  }
+  *signature = sig;
+  *count = n;
+  return true;
+}
+
+static DirRecord * runPeek(DirRun * r)
+{
+  if (r->i == r->n) {
+    if (r->next >= r->end) return NULL;
+    int n = (r->end - r->next < r->cap) ? r->end - r->next : r->cap;
+    UINT br = 0;
+    if ( (f_lseek(r->f, (FSIZE_t)(1 + r->next) * DIR_RECORD)) ||
+         (f_read(r->f, r->buf, n*DIR_RECORD, &br)) || (br != (UINT)(n*DIR_RECORD)) ) return NULL;
+    r->next += n;
+    r->n = n;
+    r->i = 0;
+  }
+  return &r->buf[r->i];
+}
+
+// one merge pass, runs of len records of src into runs of 2*len in dst
+static bool dirMerge(FIL * srca, FIL * srcb, FIL * dst, int len, DirRecord * mem, int memsize)
+{
+  int part = memsize / 3;
+  DirRecord * out = &mem[2*part];
+  int nout = 0;
+  UINT bw;
+  if (f_lseek(dst, DIR_RECORD)) return false;
+  for (int start=0; start<dircount; start+=2*len) {
+    DirRun a = { srca, &mem[0], part, 0, 0, start, (start+len < dircount) ? start+len : dircount };
+    DirRun b = { srcb, &mem[part], part, 0, 0, a.end, (start+2*len < dircount) ? start+2*len : dircount };
+    for (int k=start; k<b.end; k++) {
+      DirRecord * ra = runPeek(&a);
+      DirRecord * rb = runPeek(&b);
+      if ( (ra == NULL) && (rb == NULL) ) return false;
+      if ( (rb == NULL) || ( (ra) && (dirCompare(ra, rb) <= 0) ) ) {
+        out[nout++] = *ra;
+        a.i++;
+      }
+      else {
+        out[nout++] = *rb;
+        b.i++;
+      }
+      if (nout == part) {
+        if ( (f_write(dst, out, nout*DIR_RECORD, &bw)) || (bw != (UINT)(nout*DIR_RECORD)) ) return false;
+        nout = 0;
+      }
+    }
+  }
+  if ( (nout) && ( (f_write(dst, out, nout*DIR_RECORD, &bw)) || (bw != (UINT)(nout*DIR_RECORD)) ) ) return false;
+  return true;
+}
+
+static bool dirBuild(void)
+{
+  char idxname[DIR_PATH];
+  char tmpname[DIR_PATH];
+  static FIL files[3];
+  DirHeader hdr;
+  UINT bw;
+  bool ok = false;
+  unsigned int sig;
+
+  if ( (!dirFileName(idxname, DIR_INDEX_NAME)) || (!dirFileName(tmpname, DIR_TEMP_NAME)) ) return false;
+  emu_printf("building directory index");
+  int runsize = DIR_RUN;
+  // menu only, the slow heap will do
+  DirRecord * mem = (DirRecord *)emu_MallocHint(runsize * sizeof(DirRecord), EMU_MEM_COLD);
+  if (mem == NULL) {
+    // slower, more merge passes
+    mem = page;
+    runsize = DIR_PAGE;
+  }
+  pagefirst = -1;
+  memset(&hdr, 0, sizeof(hdr));
+  FIL * src = &files[0];
+  FIL * dst = &files[1];
+  // the header of both stays invalid until the end
+  if ( (f_open(src, tmpname, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) == FR_OK) ) {
+    if ( (f_open(dst, idxname, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) == FR_OK) ) {
+      if ( (!f_write(src, &hdr, DIR_RECORD, &bw)) && (!f_write(dst, &hdr, DIR_RECORD, &bw)) &&
+           (dirScan(&sig, &dircount, src, mem, runsize)) ) {
+        ok = true;
+        for (int len=runsize; (ok) && (len<dircount); len*=2) {
+          // second reader of the runs, on the same file
+          ok = ( (f_sync(src) == FR_OK) && (f_open(&files[2], (src == &files[0]) ? tmpname : idxname, FA_READ) == FR_OK) );
+          if (ok) {
+            ok = dirMerge(src, &files[2], dst, len, mem, runsize);
+            f_close(&files[2]);
+          }
+          FIL * k = src;
+          src = dst;
+          dst = k;
+        }
+        if (ok) {
+          hdr.magic = DIR_MAGIC;
+          hdr.count = dircount;
+          hdr.signature = sig;
+          ok = ( (!f_lseek(src, 0)) && (!f_write(src, &hdr, DIR_RECORD, &bw)) && (bw == DIR_RECORD) );
+        }
+      }
+      f_close(&files[1]);
+    }
+    f_close(&files[0]);
+  }
+  // the sorted records end up in one file or the other
+  if ( (ok) && (src == &files[0]) ) {
+    ok = ( (f_unlink(idxname) == FR_OK) && (f_rename(tmpname, idxname) == FR_OK) );
+  }
+  else {
+    f_unlink(tmpname);
+  }
+  if (mem != page) emu_Free(mem);
+  pagefirst = -1;
+  return ok;
+}
+
+static bool dirIndexValid(unsigned int * signature)
+{
+  char idxname[DIR_PATH];
+  FIL f;
+  DirHeader hdr;
+  UINT br = 0;
+  if ( (!dirFileName(idxname, DIR_INDEX_NAME)) || (f_open(&f, idxname, FA_READ) != FR_OK) ) return false;
+  bool ok = ( (!f_read(&f, &hdr, DIR_RECORD, &br)) && (br == DIR_RECORD) && (hdr.magic == DIR_MAGIC) &&
+              (f_size(&f) == (FSIZE_t)(1 + hdr.count) * DIR_RECORD) );
+  f_close(&f);
+  if (ok) {
+    *signature = hdr.signature;
+    dircount = hdr.count;
+  }
+  return ok;
+}
+
+int emu_DirOpen(const char * path, const char * hide)
+{
+  unsigned int sig, cur;
+  int n;
+  strncpy(dirpath, path, DIR_PATH-1);
+  dirpath[DIR_PATH-1] = 0;
+  strncpy(dirhide, hide ? hide : "", DIR_NAME_SIZE-1);
+  dirhide[DIR_NAME_SIZE-1] = 0;
+  pagefirst = -1;
+  dircount = 0;
+  dirindexed = false;
+
+  unsigned int key = hashBytes(dirpath, strlen(dirpath), 2166136261u);
+  bool seen = false;
+  for (int i=0; i<nchecked; i++) {
+    if (checked[i] == key) seen = true;
+  }
+  if (dirIndexValid(&sig)) {
+    // the card does not change while the menu runs
+    if ( (seen) || ( (dirScan(&cur, &n, NULL, NULL, 0)) && (cur == sig) ) ) dirindexed = true;
+  }
+  if ( (!dirindexed) && (dirBuild()) ) dirindexed = true;
+  if (dirindexed) {
+    if ( (!seen) && (nchecked < DIR_CHECKED) ) checked[nchecked++] = key;
+  }
+  else {
+    emu_printf("directory index failed");
+    if (!dirScan(&cur, &dircount, NULL, NULL, 0)) dircount = 0;
+  }
+  return dircount;
+}
+
+static bool dirPage(int first)
+{
+  memset(page, 0, sizeof(page));
+  if (dirindexed) {
+    char idxname[DIR_PATH];
+    FIL f;
+    UINT br = 0;
+    if ( (!dirFileName(idxname, DIR_INDEX_NAME)) || (f_open(&f, idxname, FA_READ) != FR_OK) ) return false;
+    int n = (dircount - first < DIR_PAGE) ? dircount - first : DIR_PAGE;
+    bool ok = ( (!f_lseek(&f, (FSIZE_t)(1 + first) * DIR_RECORD)) && (!f_read(&f, page, n*DIR_RECORD, &br)) );
+    f_close(&f);
+    if (!ok) return false;
+  }
+  else {
+    // unsorted, in directory order
+    DIR dir;
+    FILINFO entry;
+    int i = 0;
+    if (f_opendir(&dir, dirpath) != FR_OK) return false;
+    while ( (i < first+DIR_PAGE) && (f_readdir(&dir, &entry) == FR_OK) && (entry.fname[0]) ) {
+      if (!dirVisible(&entry)) continue;
+      if (i >= first) dirRecord(&page[i-first], &entry);
+      i++;
+    }
+    f_closedir(&dir);
+  }
+  pagefirst = first;
+  return true;
+}
+
+int emu_DirEntry(int index, char * name, int size)
+{
+  if ( (index < 0) || (index >= dircount) ) return -1;
+  int first = index & ~(DIR_PAGE-1);
+  if ( (first != pagefirst) && (!dirPage(first)) ) return -1;
+  const DirRecord * r = &page[index-first];
+  strncpy(name, r->name, size-1);
+  name[size-1] = 0;
+  return r->dir;
+}
+
+int emu_DirFind(const char * prefix)
+{
+  char idxname[DIR_PATH];
+  FIL f;
+  DirRecord r;
+  UINT br;
+  int len = strlen(prefix);
+  if ( (!dirindexed) || (len == 0) || (!dirFileName(idxname, DIR_INDEX_NAME)) ) return -1;
+  if (f_open(&f, idxname, FA_READ) != FR_OK) return -1;
+  // first entry not below the prefix
+  int lo = 0;
+  int hi = dircount;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if ( (f_lseek(&f, (FSIZE_t)(1 + mid) * DIR_RECORD)) || (f_read(&f, &r, DIR_RECORD, &br)) || (br != DIR_RECORD) ) {
+      lo = dircount;
+      break;
+    }
+    if (strncasecmp(r.name, prefix, len) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  bool found = false;
+  if ( (lo < dircount) && (!f_lseek(&f, (FSIZE_t)(1 + lo) * DIR_RECORD)) &&
+       (!f_read(&f, &r, DIR_RECORD, &br)) && (br == DIR_RECORD) ) {
+    found = !strncasecmp(r.name, prefix, len);
+  }
+  f_close(&f);
+  return found ? lo : -1;
+}
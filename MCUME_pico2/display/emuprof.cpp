@@ -0,0 +1,168 @@
+/*
+  Frame time accounting per subsystem (PROF_CPU, PROF_VIDEO ...)
+  Zones nest, the time of an inner zone is taken from the outer one,
+  what is left of a frame (vsync wait, menu, core bookkeeping) is "other".
+  Zones must not be used from interrupt handlers, only core 0 is accounted
+  (work handed to core 1 runs in parallel and is not part of the frame).
+*/
+
+#include "pico.h"
+#include "pico/stdlib.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "emuapi.h"
+
+// device: print a report every EMU_PROF_REPORT frames (0 for never)
+#ifndef EMU_PROF_REPORT
+#ifdef HOST_BUILD
+#define EMU_PROF_REPORT 0
+#else
+#define EMU_PROF_REPORT 300
+#endif
+#endif
+
+#define PROF_DEPTH 8
+
+#if defined(EMU_PROF_DWT) && !defined(HOST_BUILD)
+// Cortex-M33 cycle counter, finer than the 1us timer for short zones
+#include "hardware/clocks.h"
+#define DEMCR      (*(volatile uint32_t *)0xE000EDFC)
+#define DWT_CTRL   (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+static uint32_t ticks_per_us = 0;
+
+static inline uint32_t prof_ticks(void)
+{
+  return DWT_CYCCNT;
+}
+
+static void prof_clock_init(void)
+{
+  DEMCR |= (1<<24);     // TRCENA
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= 1;        // CYCCNTENA
+  ticks_per_us = clock_get_hz(clk_sys) / 1000000;
+}
+#else
+static const uint32_t ticks_per_us = 1;
+
+static inline uint32_t prof_ticks(void)
+{
+  return time_us_32();
+}
+
+static void prof_clock_init(void)
+{
+}
+#endif
+
+static uint64_t zone_ticks[PROF_ZONES];
+static uint32_t zone_calls[PROF_ZONES];
+static uint64_t frame_ticks;
+static uint32_t frame_max_ticks;
+static uint32_t frames;
+static uint32_t frame_start;
+static bool started = false;
+
+static int stack[PROF_DEPTH];
+static int depth = 0;
+static int current = -1;
+static uint32_t last;
+
+static EmuProfStats stats;
+static const char * names[PROF_ZONES] = { "cpu", "video", "audio", "io", "display" };
+
+
+static inline void account(uint32_t now)
+{
+  if ( (current >= 0) && (started) ) zone_ticks[current] += (uint32_t)(now - last);
+  last = now;
+}
+
+void emu_ProfBegin(int zone)
+{
+  if (get_core_num()) return;
+  uint32_t now = prof_ticks();
+  account(now);
+  if (depth < PROF_DEPTH) stack[depth++] = current;
+  current = zone;
+  zone_calls[zone]++;
+}
+
+void emu_ProfEnd(int zone)
+{
+  if (get_core_num()) return;
+  uint32_t now = prof_ticks();
+  account(now);
+  current = (depth > 0) ? stack[--depth] : -1;
+}
+
+void emu_ProfReset(void)
+{
+  memset(zone_ticks, 0, sizeof(zone_ticks));
+  memset(zone_calls, 0, sizeof(zone_calls));
+  frame_ticks = 0;
+  frame_max_ticks = 0;
+  frames = 0;
+  started = false;
+}
+
+void emu_ProfFrame(void)
+{
+  if (!started) {
+    prof_clock_init();
+    started = true;
+    last = frame_start = prof_ticks();
+    return;
+  }
+  uint32_t now = prof_ticks();
+  account(now);
+  uint32_t d = now - frame_start;
+  frame_start = now;
+  frame_ticks += d;
+  if (d > frame_max_ticks) frame_max_ticks = d;
+  frames++;
+#if EMU_PROF_REPORT
+  if ((frames % EMU_PROF_REPORT) == 0) {
+    emu_ProfReport();
+  }
+#endif
+}
+
+const EmuProfStats * emu_ProfStats(void)
+{
+  stats.frames = frames;
+  stats.frame_us = frame_ticks / ticks_per_us;
+  stats.frame_max_us = frame_max_ticks / ticks_per_us;
+  for (int i=0; i<PROF_ZONES; i++) {
+    stats.zone_us[i] = zone_ticks[i] / ticks_per_us;
+    stats.zone_calls[i] = zone_calls[i];
+  }
+  return &stats;
+}
+
+const char * emu_ProfZoneName(int zone)
+{
+  return names[zone];
+}
+
+void emu_ProfReport(void)
+{
+  const EmuProfStats * s = emu_ProfStats();
+  if (s->frames == 0) return;
+  char line[160];
+  snprintf(line, sizeof(line), "prof: %u frames, avg %u us, max %u us",
+    s->frames, s->frame_us/s->frames, s->frame_max_us);
+  emu_printf(line);
+  unsigned int zones = 0;
+  int n = 0;
+  for (int i=0; i<PROF_ZONES; i++) {
+    zones += s->zone_us[i];
+    n += snprintf(&line[n], sizeof(line)-n, "%s %u ", names[i], s->zone_us[i]/s->frames);
+  }
+  snprintf(&line[n], sizeof(line)-n, "other %u (us/frame)", (s->frame_us > zones) ? (s->frame_us-zones)/s->frames : 0);
+  emu_printf(line);
+  emu_MemReport();
+}
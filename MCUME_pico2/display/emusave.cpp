@@ -0,0 +1,313 @@
+/*
+  Battery backed cartridge RAM, kept in a .sav file next to the ROM.
+  Dirty blocks are found by comparing a hash per SAVE_BLOCK bytes with
+  the one of the data on the card, so cores need no write hooks.
+  Once the RAM stopped changing, the dirty sectors are written a few per
+  vsync (called from emu_DrawVsync) into the older of the 2 copies of the
+  file, and its header is only rewritten when all its data is synced:
+  a write cut by a power off leaves the other, complete, copy valid.
+
+  File: [header 0][data 0][header 1][data 1], each part sector aligned.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "emuapi.h"
+
+#define SAVE_MAGIC          0x53564d31  // "SVM1"
+#define MAX_SAVE_PATH       64
+#define SAVE_SECTOR         512
+#define SAVE_BLOCK          256
+#define SAVE_BLOCKS_PER_SECTOR (SAVE_SECTOR/SAVE_BLOCK)
+// RAM is hashed once per SAVE_SCAN_FRAMES vsyncs
+#ifndef SAVE_SCAN_FRAMES
+#define SAVE_SCAN_FRAMES    60
+#endif
+// a RAM which keeps changing is still saved after SAVE_FLUSH_FRAMES
+#ifndef SAVE_FLUSH_FRAMES
+#define SAVE_FLUSH_FRAMES   600
+#endif
+// sectors written per vsync, bounds the time taken from a frame
+#ifndef SAVE_WRITE_SECTORS
+#define SAVE_WRITE_SECTORS  4
+#endif
+
+typedef struct {
+  unsigned int magic;
+  unsigned int seq;
+  unsigned int size;
+  unsigned int sum;       // hash of the block hashes of the data
+} SaveHeader;
+
+static int savefile = 0;
+static unsigned char * savemem;
+static int savesize;
+static int nblocks;
+static int nsectors;
+static unsigned int * live;           // hashes of the RAM at the last scan
+static unsigned int * slothash[2];    // hashes of the data of each copy
+static bool slotvalid[2];
+static unsigned int slotseq[2];
+static int newest = -1;               // copy loaded or last committed
+static bool writing = false;
+static bool rewrite;                  // target copy is unknown, all sectors are written
+static int target;
+static int cursor;
+static int frames = 0;
+static int pending = 0;               // frames since the RAM differs from the newest copy
+static unsigned char sector[SAVE_SECTOR];
+
+
+static unsigned int hash(const unsigned char * buf, int len, unsigned int h)
+{
+  // FNV-1a
+  while (len--) h = (h ^ *buf++) * 16777619;
+  return h;
+}
+
+static inline int blockLen(int b)
+{
+  int len = savesize - b*SAVE_BLOCK;
+  return (len > SAVE_BLOCK) ? SAVE_BLOCK : len;
+}
+
+static inline unsigned int blockHash(const unsigned char * buf, int b)
+{
+  return hash(buf, blockLen(b), 2166136261u);
+}
+
+static inline int slotOffset(int slot)
+{
+  return slot * (1 + nsectors) * SAVE_SECTOR;
+}
+
+static unsigned int slotSum(int slot)
+{
+  return hash((const unsigned char *)slothash[slot], nblocks*sizeof(unsigned int), 2166136261u);
+}
+
+static void saveClose(void)
+{
+  emu_FileClose(savefile);
+  savefile = 0;
+  writing = false;
+}
+
+// hashes the data of a copy, valid if it matches its header
+static void slotCheck(int slot)
+{
+  SaveHeader hdr;
+  slotvalid[slot] = false;
+  emu_FileSeek(savefile, slotOffset(slot), SEEK_SET);
+  if ( (emu_FileRead(&hdr, sizeof(hdr), savefile) != sizeof(hdr)) ||
+       (hdr.magic != SAVE_MAGIC) || (hdr.size != (unsigned int)savesize) ) {
+    return;
+  }
+  emu_FileSeek(savefile, slotOffset(slot) + SAVE_SECTOR, SEEK_SET);
+  for (int s=0; s<nsectors; s++) {
+    int len = savesize - s*SAVE_SECTOR;
+    if (len > SAVE_SECTOR) len = SAVE_SECTOR;
+    if (emu_FileRead(sector, len, savefile) != len) return;
+    for (int i=0; i<SAVE_BLOCKS_PER_SECTOR; i++) {
+      int b = s*SAVE_BLOCKS_PER_SECTOR + i;
+      if (b < nblocks) slothash[slot][b] = blockHash(&sector[i*SAVE_BLOCK], b);
+    }
+  }
+  if (slotSum(slot) == hdr.sum) {
+    slotvalid[slot] = true;
+    slotseq[slot] = hdr.seq;
+  }
+}
+
+// rehashes the blocks of a sector, true if it differs from the target copy
+static bool sectorDirty(int s)
+{
+  bool dirty = rewrite;
+  for (int b=s*SAVE_BLOCKS_PER_SECTOR; (b<(s+1)*SAVE_BLOCKS_PER_SECTOR) && (b<nblocks); b++) {
+    live[b] = blockHash(&savemem[b*SAVE_BLOCK], b);
+    if (live[b] != slothash[target][b]) dirty = true;
+  }
+  return dirty;
+}
+
+static bool saveCommit(void)
+{
+  SaveHeader hdr;
+  if (emu_FileSync(savefile)) return false;
+  // the header is written last, as a whole sector
+  memset(sector, 0, SAVE_SECTOR);
+  hdr.magic = SAVE_MAGIC;
+  hdr.seq = (newest >= 0) ? slotseq[newest]+1 : 1;
+  hdr.size = savesize;
+  hdr.sum = slotSum(target);
+  memcpy(sector, &hdr, sizeof(hdr));
+  emu_FileSeek(savefile, slotOffset(target), SEEK_SET);
+  if ( (emu_FileWrite(sector, SAVE_SECTOR, savefile) != SAVE_SECTOR) || (emu_FileSync(savefile)) ) {
+    return false;
+  }
+  slotvalid[target] = true;
+  slotseq[target] = hdr.seq;
+  newest = target;
+  return true;
+}
+
+// writes runs of dirty sectors, at most SAVE_WRITE_SECTORS per call
+static void saveWrite(void)
+{
+  int written = 0;
+  while ( (cursor < nsectors) && (written < SAVE_WRITE_SECTORS) ) {
+    int n = 0;
+    while ( (cursor+n < nsectors) && (written+n < SAVE_WRITE_SECTORS) && (sectorDirty(cursor+n)) ) n++;
+    if (n == 0) {
+      cursor++;
+      continue;
+    }
+    int len = savesize - cursor*SAVE_SECTOR;
+    if (len > n*SAVE_SECTOR) len = n*SAVE_SECTOR;
+    emu_FileSeek(savefile, slotOffset(target) + (1+cursor)*SAVE_SECTOR, SEEK_SET);
+    if (emu_FileWrite(&savemem[cursor*SAVE_SECTOR], len, savefile) != len) {
+      emu_printf("save write failed");
+      saveClose();
+      return;
+    }
+    // the header of this copy no longer matches
+    slotvalid[target] = false;
+    for (int b=cursor*SAVE_BLOCKS_PER_SECTOR; (b<(cursor+n)*SAVE_BLOCKS_PER_SECTOR) && (b<nblocks); b++) {
+      slothash[target][b] = live[b];
+    }
+    cursor += n;
+    written += n;
+  }
+  if (cursor >= nsectors) {
+    writing = false;
+    pending = 0;
+    if (!saveCommit()) {
+      emu_printf("save commit failed");
+      saveClose();
+    }
+  }
+}
+
+// rehashes the RAM, true if it changed since the last scan
+static bool saveScan(void)
+{
+  bool changed = false;
+  for (int b=0; b<nblocks; b++) {
+    unsigned int h = blockHash(&savemem[b*SAVE_BLOCK], b);
+    if (h != live[b]) {
+      live[b] = h;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+static bool saveDirty(void)
+{
+  if (newest < 0) return true;
+  for (int b=0; b<nblocks; b++) {
+    if (live[b] != slothash[newest][b]) return true;
+  }
+  return false;
+}
+
+int emu_FileNameExt(char * path, const char * filepath, const char * ext, int size)
+{
+  int len = strlen(filepath);
+  if (len >= size) return 0;
+  strcpy(path, filepath);
+  char * base = strrchr(path, '/');
+  base = (base) ? base + 1 : path;
+  // a member of an archive (dir/game.zip/member.gb) gets its file next to
+  // the archive (dir/game.zip.member.sav)
+  for (char * pt = path; (pt = strchr(pt, '.')); pt++) {
+    if (!strncasecmp(pt, ".zip/", 5)) {
+      base = pt + 5;
+      for (pt += 4; (pt = strchr(pt, '/')); ) *pt = '.';
+      break;
+    }
+  }
+  char * pt = strrchr(base, '.');
+  if (pt == NULL) pt = path + len;
+  if ( (pt - path) + (int)strlen(ext) >= size ) return 0;
+  strcpy(pt, ext);
+  return 1;
+}
+
+int emu_SaveRegister(const char * filepath, void * mem, int size)
+{
+  char path[MAX_SAVE_PATH];
+  if (savefile) saveClose();
+  if (live) {
+    emu_Free(live);
+    live = NULL;
+  }
+  if (size <= 0) return 0;
+
+  if (!emu_FileNameExt(path, filepath, ".sav", MAX_SAVE_PATH)) {
+    emu_printf("save path too long");
+    return 0;
+  }
+
+  savemem = (unsigned char *)mem;
+  savesize = size;
+  nblocks = (size + SAVE_BLOCK - 1) / SAVE_BLOCK;
+  nsectors = (size + SAVE_SECTOR - 1) / SAVE_SECTOR;
+  live = (unsigned int *)emu_Malloc(3*nblocks*sizeof(unsigned int));
+  if (live == NULL) return 0;
+  slothash[0] = live + nblocks;
+  slothash[1] = live + 2*nblocks;
+
+  if ( !(savefile = emu_FileOpenRW(path, slotOffset(2))) ) {
+    emu_printf("save file not available");
+    return 0;
+  }
+  slotCheck(0);
+  slotCheck(1);
+  newest = -1;
+  if ( (slotvalid[0]) && ( (!slotvalid[1]) || ((int)(slotseq[0]-slotseq[1]) > 0) ) ) newest = 0;
+  else if (slotvalid[1]) newest = 1;
+
+  int loaded = 0;
+  if (newest >= 0) {
+    emu_FileSeek(savefile, slotOffset(newest) + SAVE_SECTOR, SEEK_SET);
+    if (emu_FileRead(savemem, size, savefile) == size) {
+      loaded = 1;
+      emu_printf("save loaded");
+    }
+  }
+  for (int b=0; b<nblocks; b++) {
+    live[b] = blockHash(&savemem[b*SAVE_BLOCK], b);
+  }
+  frames = 0;
+  pending = 0;
+  writing = false;
+  return loaded;
+}
+
+void emu_SaveVsync(void)
+{
+  if (!savefile) return;
+  PROF_BEGIN(PROF_IO);
+  if (writing) {
+    saveWrite();
+  }
+  else {
+    if (pending) pending++;
+    if (++frames >= SAVE_SCAN_FRAMES) {
+      frames = 0;
+      bool changed = saveScan();
+      if ( (!pending) && (saveDirty()) ) pending = 1;
+      // wait for the game to be done with its save, coalescing the writes
+      if ( (pending) && ( (!changed) || (pending >= SAVE_FLUSH_FRAMES) ) ) {
+        target = (newest == 0) ? 1 : 0;
+        rewrite = !slotvalid[target];
+        cursor = 0;
+        writing = true;
+      }
+    }
+  }
+  PROF_END(PROF_IO);
+}
@@ -0,0 +1,524 @@
+/*
+  Save states, <rom>.st0 to <rom>.st9
+  A state is a list of chunks, each one a named buffer of the core (RAM,
+  registers ...) stored as packets of STATE_PACKET bytes, LZ compressed
+  if it helps. Matches of a packet may point anywhere back in its chunk,
+  so both ways work in place on the core memory: packets are written as
+  they are made and decoded straight into the destination buffer, there
+  is no staging buffer of the state size.
+  Slot 0 is the resume slot, loaded when the core starts (STATE_RESUME).
+  A state is written to <rom>.stt, its header last, which then replaces
+  the one of the slot: a cut save leaves the previous state. Each chunk
+  has a crc32, the header one of all of them, and a whole state is
+  checked before the core gets any of it.
+
+  File: header, chunks (header, packets), empty chunk as end marker.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "emuapi.h"
+
+#define STATE_MAGIC         0x5453434d  // "MCST"
+#define STATE_FORMAT        2
+#define STATE_PATH          64
+#define STATE_SLOTS         10
+#define STATE_KEY           32
+#define STATE_CORE          12
+#define STATE_PACKET        4096
+#define STATE_STORED        0x8000      // packet flag, not compressed
+#define STATE_HASH_BITS     10
+#define STATE_MAX_CHUNKS    96
+#define STATE_MIN_MATCH     4
+#define STATE_MAX_OFFSET    0xffff
+
+typedef struct {
+  unsigned int magic;
+  unsigned short format;
+  unsigned short version;             // of the core state, see emu_StateRegister
+  char core[STATE_CORE];
+  unsigned short slot;
+  unsigned short nchunks;
+  unsigned int crc;                   // of the header and the chunks crcs
+} StateHeader;
+
+typedef struct {
+  char key[STATE_KEY];
+  unsigned int size;                  // of the buffer
+  unsigned int csize;                 // of the packets that follow
+  unsigned int crc;                   // of the packets then the chunk header
+} StateChunk;
+
+typedef struct {
+  unsigned short raw;                 // bytes of the buffer, STATE_STORED if not compressed
+  unsigned short len;                 // bytes that follow
+} StatePacket;
+
+typedef struct {
+  unsigned int offset;
+  unsigned int key;                   // hash of the key
+} StateIndex;
+
+static char rompath[STATE_PATH];
+static char corename[STATE_CORE];
+static int coreversion;
+static int (*coresave)(void) = NULL;
+static int (*coreload)(void) = NULL;
+static int slot = 0;
+static unsigned short lastkeys = 0;
+
+// state being written or read
+static int statefile = 0;
+static bool stateerr;
+static unsigned int stateoffs;
+static unsigned int statecrc;         // of the bytes written since the chunk header
+static unsigned int chunkscrc;        // of the crcs of the chunks
+static int chunkcount;
+static unsigned char * packet;
+static unsigned int * hashtab;
+static StateIndex * chunks;
+static int nchunks;
+
+
+static unsigned int keyHash(const char * key)
+{
+  unsigned int h = 2166136261u;
+  while (*key) h = (h ^ (unsigned char)*key++) * 16777619;
+  return h;
+}
+
+static void stateWrite(const void * buf, int size)
+{
+  if (stateerr) return;
+  if (emu_FileWrite((void *)buf, size, statefile) != size) {
+    emu_printf("state write failed");
+    stateerr = true;
+  }
+  statecrc = emu_Crc32(statecrc, buf, size);
+  stateoffs += size;
+}
+
+static bool stateRead(unsigned int offset, void * buf, int size)
+{
+  emu_FileSeek(statefile, offset, SEEK_SET);
+  return (emu_FileRead(buf, size, statefile) == size);
+}
+
+static inline unsigned int read32(const unsigned char * pt)
+{
+  unsigned int v;
+  memcpy(&v, pt, 4);
+  return v;
+}
+
+static unsigned char * lzLength(unsigned char * op, int n)
+{
+  while (n >= 255) {
+    *op++ = 255;
+    n -= 255;
+  }
+  *op++ = n;
+  return op;
+}
+
+// LZ4 like sequence: token (literals << 4 | match-4), literals, offset.
+// The last sequence of a packet has no match.
+static unsigned char * lzSequence(unsigned char * op, const unsigned char * lit, int nlit, int offset, int mlen)
+{
+  int m = mlen - STATE_MIN_MATCH;
+  *op++ = ((nlit < 15) ? nlit : 15) << 4 | ((mlen) ? ((m < 15) ? m : 15) : 0);
+  if (nlit >= 15) op = lzLength(op, nlit-15);
+  memcpy(op, lit, nlit);
+  op += nlit;
+  if (mlen) {
+    *op++ = offset & 0xff;
+    *op++ = offset >> 8;
+    if (m >= 15) op = lzLength(op, m-15);
+  }
+  return op;
+}
+
+// compresses base[start..end[, matches may start anywhere before
+static int lzPack(const unsigned char * base, int start, int end, unsigned char * out)
+{
+  unsigned char * op = out;
+  int anchor = start;
+  int ip = start;
+  while (ip + STATE_MIN_MATCH <= end) {
+    unsigned int seq = read32(&base[ip]);
+    unsigned int h = (seq * 2654435761u) >> (32 - STATE_HASH_BITS);
+    int ref = (int)hashtab[h] - 1;
+    hashtab[h] = ip + 1;
+    if ( (ref >= 0) && ((ip - ref) <= STATE_MAX_OFFSET) && (read32(&base[ref]) == seq) ) {
+      int len = STATE_MIN_MATCH;
+      while ( (ip+len < end) && (base[ref+len] == base[ip+len]) ) len++;
+      op = lzSequence(op, &base[anchor], ip-anchor, ip-ref, len);
+      ip += len;
+      anchor = ip;
+    }
+    else {
+      ip++;
+    }
+  }
+  op = lzSequence(op, &base[anchor], end-anchor, 0, 0);
+  return op - out;
+}
+
+// decodes a packet into dst[pos..end[, bytes past size are dropped
+static bool lzUnpack(const unsigned char * ip, int len, unsigned char * dst, int size, int pos, int end)
+{
+  const unsigned char * iend = ip + len;
+  while (ip < iend) {
+    int token = *ip++;
+    int n = token >> 4;
+    if (n == 15) {
+      int c;
+      do {
+        if (ip >= iend) return false;
+        n += (c = *ip++);
+      } while (c == 255);
+    }
+    if ( (ip + n > iend) || (pos + n > end) ) return false;
+    if (pos < size) memcpy(&dst[pos], ip, (pos + n <= size) ? n : size - pos);
+    ip += n;
+    pos += n;
+    if (ip >= iend) break;
+
+    if (ip + 2 > iend) return false;
+    int offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    n = token & 15;
+    if (n == 15) {
+      int c;
+      do {
+        if (ip >= iend) return false;
+        n += (c = *ip++);
+      } while (c == 255);
+    }
+    n += STATE_MIN_MATCH;
+    if ( (offset == 0) || (offset > pos) || (pos + n > end) ) return false;
+    // byte per byte, the match may overlap the bytes it produces
+    for (int i=0; i<n; i++, pos++) {
+      if (pos < size) dst[pos] = dst[pos-offset];
+    }
+  }
+  return (pos == end);
+}
+
+static void stateClose(void)
+{
+  emu_FileClose(statefile);
+  statefile = 0;
+  if (packet) emu_Free(packet);
+  if (hashtab) emu_Free(hashtab);
+  if (chunks) emu_Free(chunks);
+  packet = NULL;
+  hashtab = NULL;
+  chunks = NULL;
+}
+
+// file of a slot, or the one states are written to when s < 0
+static bool statePath(char * path, int s)
+{
+  char ext[5] = ".stt";
+  if (s >= 0) ext[3] = '0' + s;
+  if ( (rompath[0] == 0) || (!emu_FileNameExt(path, rompath, ext, STATE_PATH)) ) {
+    emu_printf("state path too long");
+    return false;
+  }
+  return true;
+}
+
+static bool stateOpen(int s, bool write)
+{
+  char path[STATE_PATH];
+  if (!statePath(path, s)) return false;
+  statefile = write ? emu_FileOpenRW(path, 0) : emu_FileOpen(path, "r+b");
+  if (!statefile) return false;
+  stateerr = false;
+  stateoffs = 0;
+  // only used while saving or loading, the slow heap will do
+  packet = (unsigned char *)emu_MallocHint(STATE_PACKET + STATE_PACKET/255 + 16, EMU_MEM_COLD);
+  if (write) hashtab = (unsigned int *)emu_MallocHint((1 << STATE_HASH_BITS) * sizeof(unsigned int), EMU_MEM_COLD);
+  else chunks = (StateIndex *)emu_MallocHint(STATE_MAX_CHUNKS * sizeof(StateIndex), EMU_MEM_COLD);
+  if ( (packet == NULL) || ((hashtab == NULL) && (chunks == NULL)) ) {
+    emu_printf("state: no memory");
+    stateClose();
+    return false;
+  }
+  return true;
+}
+
+void emu_StateChunk(const char * key, void * buf, int size)
+{
+  StateChunk chunk;
+  if ( (!statefile) || (stateerr) || (hashtab == NULL) ) return;
+  memset(&chunk, 0, sizeof(chunk));
+  strncpy(chunk.key, key, STATE_KEY-1);
+  chunk.size = size;
+  unsigned int start = stateoffs;
+  stateWrite(&chunk, sizeof(chunk));
+  statecrc = 0;
+
+  const unsigned char * src = (const unsigned char *)buf;
+  memset(hashtab, 0, (1 << STATE_HASH_BITS) * sizeof(unsigned int));
+  for (int pos=0; pos<size; pos+=STATE_PACKET) {
+    StatePacket p;
+    int raw = (size - pos > STATE_PACKET) ? STATE_PACKET : size - pos;
+    int len = lzPack(src, pos, pos+raw, packet);
+    if (len < raw) {
+      p.raw = raw;
+      p.len = len;
+      stateWrite(&p, sizeof(p));
+      stateWrite(packet, len);
+    }
+    else {
+      p.raw = raw | STATE_STORED;
+      p.len = raw;
+      stateWrite(&p, sizeof(p));
+      stateWrite(&src[pos], raw);
+    }
+  }
+
+  // the size of the packets is known now
+  unsigned int end = stateoffs;
+  chunk.csize = end - start - sizeof(chunk);
+  chunk.crc = emu_Crc32(statecrc, &chunk, sizeof(chunk));
+  chunkscrc = emu_Crc32(chunkscrc, &chunk.crc, sizeof(chunk.crc));
+  chunkcount++;
+  emu_FileSeek(statefile, start, SEEK_SET);
+  stateoffs = start;
+  stateWrite(&chunk, sizeof(chunk));
+  emu_FileSeek(statefile, end, SEEK_SET);
+  stateoffs = end;
+}
+
+// header of the chunk named key, its packets are read next
+static bool stateFind(const char * key, StateChunk * chunk)
+{
+  if ( (!statefile) || (stateerr) || (chunks == NULL) ) return false;
+  unsigned int h = keyHash(key);
+  for (int i=0; i<nchunks; i++) {
+    if (chunks[i].key != h) continue;
+    if ( (stateRead(chunks[i].offset, chunk, sizeof(StateChunk))) && (!strncmp(chunk->key, key, STATE_KEY)) ) return true;
+  }
+  return false;
+}
+
+int emu_StateSize(const char * key)
+{
+  StateChunk chunk;
+  return stateFind(key, &chunk) ? chunk.size : -1;
+}
+
+int emu_StateRestore(const char * key, void * buf, int size)
+{
+  StateChunk chunk;
+  if (stateFind(key, &chunk)) {
+    unsigned char * dst = (unsigned char *)buf;
+    unsigned int pos = 0;
+    unsigned int left = chunk.csize;
+    while (pos < chunk.size) {
+      StatePacket p;
+      if ( (left < sizeof(p)) || (emu_FileRead(&p, sizeof(p), statefile) != sizeof(p)) ) break;
+      int raw = p.raw & ~STATE_STORED;
+      left -= sizeof(p);
+      if ( (raw == 0) || (p.len > left) || (p.len > STATE_PACKET) ) break;
+      if (p.raw & STATE_STORED) {
+        if (emu_FileRead(packet, p.len, statefile) != p.len) break;
+        if ((int)pos < size) memcpy(&dst[pos], packet, ((int)pos + raw <= size) ? raw : size - pos);
+      }
+      else {
+        if ( (emu_FileRead(packet, p.len, statefile) != p.len) ||
+             (!lzUnpack(packet, p.len, dst, size, pos, pos+raw)) ) break;
+      }
+      left -= p.len;
+      pos += raw;
+    }
+    if (pos < chunk.size) {
+      emu_printf("state chunk corrupted");
+      emu_printf(key);
+      stateerr = true;
+      return 0;
+    }
+    return ((int)chunk.size < size) ? chunk.size : size;
+  }
+  return 0;
+}
+
+int emu_StateSave(int s)
+{
+  StateHeader hdr;
+  StateChunk end;
+  char tmppath[STATE_PATH];
+  char path[STATE_PATH];
+  if ( (coresave == NULL) || (!stateOpen(-1, true)) ) {
+    emu_printf("state save failed");
+    return -1;
+  }
+  PROF_BEGIN(PROF_IO);
+  // not a state until the header is written
+  memset(&hdr, 0, sizeof(hdr));
+  stateWrite(&hdr, sizeof(hdr));
+  chunkscrc = 0;
+  chunkcount = 0;
+  if (coresave()) stateerr = true;
+  // the file may be longer from a previous state
+  memset(&end, 0, sizeof(end));
+  stateWrite(&end, sizeof(end));
+  if (emu_FileSync(statefile)) stateerr = true;
+  if (!stateerr) {
+    hdr.magic = STATE_MAGIC;
+    hdr.format = STATE_FORMAT;
+    hdr.version = coreversion;
+    strncpy(hdr.core, corename, STATE_CORE-1);
+    hdr.slot = s;
+    hdr.nchunks = chunkcount;
+    hdr.crc = emu_Crc32(chunkscrc, &hdr, sizeof(hdr));
+    emu_FileSeek(statefile, 0, SEEK_SET);
+    stateWrite(&hdr, sizeof(hdr));
+    if (emu_FileSync(statefile)) stateerr = true;
+  }
+  bool ok = !stateerr;
+  stateClose();
+  if (ok) {
+    ok = statePath(tmppath, -1) && statePath(path, s) &&
+         (emu_FileRename(tmppath, path) == 0);
+  }
+  PROF_END(PROF_IO);
+  emu_printf(ok ? "state saved" : "state save failed");
+  return ok ? 0 : -1;
+}
+
+// reads and decodes the packets of a chunk without storing them, true
+// if they are complete and match its crc
+static bool stateCheckChunk(unsigned int offset, StateChunk * chunk)
+{
+  StatePacket p;
+  unsigned int pos = 0;
+  unsigned int left = chunk->csize;
+  unsigned int crc = 0;
+  emu_FileSeek(statefile, offset + sizeof(StateChunk), SEEK_SET);
+  while (pos < chunk->size) {
+    if ( (left < sizeof(p)) || (emu_FileRead(&p, sizeof(p), statefile) != sizeof(p)) ) return false;
+    int raw = p.raw & ~STATE_STORED;
+    left -= sizeof(p);
+    if ( (raw == 0) || (p.len > left) || (p.len > STATE_PACKET) ) return false;
+    if (emu_FileRead(packet, p.len, statefile) != p.len) return false;
+    if ( (p.raw & STATE_STORED) ? (p.len != raw) : (!lzUnpack(packet, p.len, NULL, 0, pos, pos+raw)) ) return false;
+    crc = emu_Crc32(crc, &p, sizeof(p));
+    crc = emu_Crc32(crc, packet, p.len);
+    left -= p.len;
+    pos += raw;
+  }
+  if ( (pos != chunk->size) || (left != 0) ) return false;
+  unsigned int sum = chunk->crc;
+  chunk->crc = 0;
+  crc = emu_Crc32(crc, chunk, sizeof(StateChunk));
+  chunk->crc = sum;
+  return (crc == sum);
+}
+
+// indexes the chunks, the core asks for them by name, true if the
+// whole state is valid
+static bool stateCheck(int s)
+{
+  StateHeader hdr;
+  StateChunk chunk;
+  if ( (!stateRead(0, &hdr, sizeof(hdr))) || (hdr.magic != STATE_MAGIC) ) return false;
+  if ( (hdr.format != STATE_FORMAT) || (hdr.version != coreversion) || (strncmp(hdr.core, corename, STATE_CORE)) ) {
+    emu_printf("state of another core or version");
+    return false;
+  }
+  if (hdr.slot != s) return false;
+  unsigned int crc = 0;
+  nchunks = 0;
+  unsigned int offset = sizeof(hdr);
+  while ( (stateRead(offset, &chunk, sizeof(chunk))) && (chunk.key[0]) ) {
+    if ( (nchunks >= STATE_MAX_CHUNKS) || (!stateCheckChunk(offset, &chunk)) ) return false;
+    chunk.key[STATE_KEY-1] = 0;
+    chunks[nchunks].offset = offset;
+    chunks[nchunks].key = keyHash(chunk.key);
+    nchunks++;
+    crc = emu_Crc32(crc, &chunk.crc, sizeof(chunk.crc));
+    offset += sizeof(chunk) + chunk.csize;
+  }
+  unsigned int sum = hdr.crc;
+  hdr.crc = 0;
+  return ( (nchunks == hdr.nchunks) && (emu_Crc32(crc, &hdr, sizeof(hdr)) == sum) );
+}
+
+int emu_StateLoad(int s)
+{
+  if (coreload == NULL) return -1;
+  PROF_BEGIN(PROF_IO);
+  // the state being written replaces the slot, it is valid if the
+  // save was cut after it was complete
+  bool found = false;
+  bool valid = ( (stateOpen(s, false)) && (stateCheck(s)) );
+  if (!valid) {
+    if (statefile) {
+      found = true;
+      stateClose();
+    }
+    valid = ( (stateOpen(-1, false)) && (stateCheck(s)) );
+  }
+  if (!valid) {
+    if (statefile) stateClose();
+    PROF_END(PROF_IO);
+    if (found) emu_printf("state corrupted");
+    return -1;
+  }
+  if (coreload()) stateerr = true;
+  bool ok = !stateerr;
+  stateClose();
+  PROF_END(PROF_IO);
+  emu_printf(ok ? "state loaded" : "state load failed");
+  return ok ? 0 : -1;
+}
+
+int emu_StateRegister(const char * filepath, const char * core, int version, int (*save)(void), int (*load)(void))
+{
+  // a truncated path would name the state of another file
+  if (strlen(filepath) < STATE_PATH) strcpy(rompath, filepath);
+  else rompath[0] = 0;
+  strncpy(corename, core, STATE_CORE-1);
+  corename[STATE_CORE-1] = 0;
+  coreversion = version;
+  coresave = save;
+  coreload = load;
+  slot = 0;
+  lastkeys = emu_ReadKeys();
+#ifdef STATE_RESUME
+  // holding the hotkey combination at start skips the resume
+  const unsigned short combo = MASK_KEY_USER1 | MASK_KEY_USER2;
+  if ( (lastkeys & combo) != combo ) {
+    return (emu_StateLoad(0) == 0);
+  }
+#endif
+  return 0;
+}
+
+// between frames: hold USER1+USER2, UP saves, DOWN loads, LEFT/RIGHT select the slot
+void emu_StateHotkeys(void)
+{
+  const unsigned short combo = MASK_KEY_USER1 | MASK_KEY_USER2;
+  if (coresave == NULL) return;
+  unsigned short keys = emu_ReadKeys();
+  unsigned short pressed = keys & ~lastkeys;
+  lastkeys = keys;
+  if ( ((keys & combo) != combo) || (!(pressed & ~combo)) ) return;
+  if (pressed & (MASK_JOY1_UP | MASK_JOY2_UP)) {
+    emu_StateSave(slot);
+  }
+  else if (pressed & (MASK_JOY1_DOWN | MASK_JOY2_DOWN)) {
+    emu_StateLoad(slot);
+  }
+  else if (pressed & (MASK_JOY1_RIGHT | MASK_JOY2_RIGHT | MASK_JOY1_LEFT | MASK_JOY2_LEFT)) {
+    int step = (pressed & (MASK_JOY1_RIGHT | MASK_JOY2_RIGHT)) ? 1 : STATE_SLOTS-1;
+    slot = (slot + step) % STATE_SLOTS;
+    emu_printf("state slot");
+    emu_printi(slot);
+  }
+}
@@ -0,0 +1,672 @@
+/*
+  Compressed files, inflated on the fly by the file layer (emuapi.cpp).
+  A .gz file, a .zip archive (its largest member) or <archive>.zip/<member>
+  reads as the plain file: loaders see the uncompressed size and content,
+  while only the compressed bytes are read from the card.
+  Deflate needs the last 32KB of output for its back references, so a
+  compressed handle holds a window of that size, allocated while it is open.
+  Seeking back out of the window restarts the stream from the beginning.
+  The central directory of the last archive is kept, so that the size and
+  content requests of a loader do not parse it again.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "emuapi.h"
+
+#define ZIP_STREAMS   4         // one per file handler
+#define ZIP_WINDOW    32768     // largest deflate distance
+#define ZIP_WMASK     (ZIP_WINDOW-1)
+#define ZIP_INBUF     1024
+#define ZIP_STEP      16384     // output inflated per call, less than the window
+#define ZIP_FAST_BITS 9         // codes up to this length are decoded by a table lookup
+#define ZIP_INDEX     32        // members indexed from the central directory
+#define ZIP_PATH      64
+#define ZIP_TAIL      512       // end of archive searched for the end of central directory
+
+#define ZIP_LOCAL_SIG   0x04034b50
+#define ZIP_CENTRAL_SIG 0x02014b50
+#define ZIP_END_SIG     0x06054b50
+
+enum { ZS_BLOCK, ZS_STORED, ZS_HUFF, ZS_DONE, ZS_ERROR };
+
+typedef struct {
+  unsigned short fast[1<<ZIP_FAST_BITS];  // (length<<9)|symbol, 0 for longer codes
+  unsigned short count[16];               // codes per length
+  unsigned short symbol[288];             // symbols in canonical order
+} Huff;
+
+typedef struct {
+  int handler;
+  unsigned int upos;        // uncompressed bytes produced
+  unsigned int inleft;      // compressed bytes not read yet
+  int inpos;
+  int inlen;
+  int overrun;              // bytes past the end of the input
+  unsigned int bitbuf;
+  int bitcnt;
+  int state;
+  bool last;
+  int stored;               // bytes left in a stored block
+  int copy;                 // bytes left in a match
+  unsigned int dist;
+  unsigned int sum;         // crc32 of the output
+  Huff lit;
+  Huff dst;
+  unsigned char inbuf[ZIP_INBUF];
+  unsigned char window[ZIP_WINDOW];
+} Inflate;
+
+typedef struct {
+  bool used;
+  int method;               // 0 stored, 8 deflate
+  unsigned int start;       // offset of the data in the file
+  unsigned int csize;
+  unsigned int usize;
+  unsigned int crc;
+  Inflate * inf;
+} ZipStream;
+
+typedef struct {
+  unsigned int hash;        // of the lower case name
+  unsigned int offset;      // of the local header
+  unsigned int csize;
+  unsigned int usize;
+  unsigned int crc;
+  unsigned short method;
+} ZipEntry;
+
+static ZipStream streams[ZIP_STREAMS];
+
+static struct {
+  char path[ZIP_PATH];
+  int size;
+  int count;
+  int largest;
+  ZipEntry entry[ZIP_INDEX];
+} zindex;
+
+static const unsigned short lbase[29] = {
+  3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+static const unsigned char lext[29] = {
+  0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const unsigned short dbase[30] = {
+  1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,
+  4097,6145,8193,12289,16385,24577 };
+static const unsigned char dext[30] = {
+  0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+static const unsigned char clorder[19] = {
+  16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+// crc32 4 bits at a time, no 1KB table
+static const unsigned int crcnibble[16] = {
+  0x00000000,0x1db71064,0x3b6e20c8,0x26d930ac,0x76dc4190,0x6b6b51f4,0x4db26158,0x5005713c,
+  0xedb88320,0xf00f9344,0xd6d6a3e8,0xcb61b38c,0x9b64c2b0,0x86d3d2d4,0xa00ae278,0xbdbdf21c };
+
+
+unsigned int emu_Crc32(unsigned int crc, const void * buf, int len)
+{
+  const unsigned char * pt = (const unsigned char *)buf;
+  crc = ~crc;
+  while (len--) {
+    unsigned int c = crc ^ *pt++;
+    c = (c >> 4) ^ crcnibble[c & 15];
+    crc = (c >> 4) ^ crcnibble[c & 15];
+  }
+  return ~crc;
+}
+
+static inline unsigned int rd16(const unsigned char * p)
+{
+  return p[0] | (p[1]<<8);
+}
+
+static inline unsigned int rd32(const unsigned char * p)
+{
+  return p[0] | (p[1]<<8) | (p[2]<<16) | ((unsigned int)p[3]<<24);
+}
+
+static unsigned int nameHash(const char * name, int len)
+{
+  // FNV-1a, case insensitive as FAT names
+  unsigned int h = 2166136261u;
+  for (int i=0; i<len; i++) {
+    unsigned char c = name[i];
+    if ( (c >= 'A') && (c <= 'Z') ) c += 'a'-'A';
+    h = (h ^ c) * 16777619;
+  }
+  return h;
+}
+
+static ZipStream * getStream(int handler)
+{
+  if ( (handler < 1) || (handler > ZIP_STREAMS) || (!streams[handler-1].used) ) return NULL;
+  return &streams[handler-1];
+}
+
+
+/********************************
+ * Inflate
+********************************/
+static int nextByte(Inflate * z)
+{
+  if (z->inpos == z->inlen) {
+    int n = (z->inleft < ZIP_INBUF) ? z->inleft : ZIP_INBUF;
+    z->inlen = (n > 0) ? emu_FileReadRaw(z->inbuf, n, z->handler) : 0;
+    z->inpos = 0;
+    if (z->inlen <= 0) {
+      // zeros past the end, an error once they are consumed (see fill)
+      z->inlen = 0;
+      z->overrun++;
+      return 0;
+    }
+    z->inleft -= z->inlen;
+  }
+  return z->inbuf[z->inpos++];
+}
+
+static inline void fill(Inflate * z)
+{
+  while (z->bitcnt <= 24) {
+    z->bitbuf |= (unsigned int)nextByte(z) << z->bitcnt;
+    z->bitcnt += 8;
+  }
+}
+
+static inline unsigned int bits(Inflate * z, int n)
+{
+  if (z->bitcnt < n) fill(z);
+  unsigned int v = z->bitbuf & ((1u<<n)-1);
+  z->bitbuf >>= n;
+  z->bitcnt -= n;
+  return v;
+}
+
+static bool build(Huff * h, const unsigned char * lengths, int n)
+{
+  unsigned short offs[16];
+  memset(h->count, 0, sizeof(h->count));
+  for (int i=0; i<n; i++) h->count[lengths[i]]++;
+  h->count[0] = 0;
+  int left = 1;
+  for (int len=1; len<16; len++) {
+    left = (left << 1) - h->count[len];
+    if (left < 0) return false;   // over-subscribed
+  }
+  offs[1] = 0;
+  for (int len=1; len<15; len++) offs[len+1] = offs[len] + h->count[len];
+  for (int i=0; i<n; i++) {
+    if (lengths[i]) h->symbol[offs[lengths[i]]++] = i;
+  }
+  // codes are sent from their most significant bit, the table is indexed by
+  // the next bits of the stream, so with the code bits reversed
+  memset(h->fast, 0, sizeof(h->fast));
+  int code = 0;
+  int idx = 0;
+  for (int len=1; len<=ZIP_FAST_BITS; len++) {
+    for (int k=0; k<h->count[len]; k++) {
+      int rev = 0;
+      for (int b=0; b<len; b++) rev |= ((code >> b) & 1) << (len-1-b);
+      for (int r=rev; r<(1<<ZIP_FAST_BITS); r+=(1<<len)) {
+        h->fast[r] = (len << 9) | h->symbol[idx];
+      }
+      code++;
+      idx++;
+    }
+    code <<= 1;
+  }
+  return true;
+}
+
+static int decode(Inflate * z, const Huff * h)
+{
+  fill(z);
+  unsigned int e = h->fast[z->bitbuf & ((1<<ZIP_FAST_BITS)-1)];
+  if (e) {
+    z->bitbuf >>= (e >> 9);
+    z->bitcnt -= (e >> 9);
+    return e & 0x1ff;
+  }
+  // canonical decode, a bit at a time
+  int code = 0;
+  int first = 0;
+  int index = 0;
+  for (int len=1; len<16; len++) {
+    code |= z->bitbuf & 1;
+    z->bitbuf >>= 1;
+    z->bitcnt--;
+    int count = h->count[len];
+    if (code - count < first) return h->symbol[index + (code - first)];
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+static bool fixedTables(Inflate * z)
+{
+  unsigned char lengths[288];
+  memset(&lengths[0], 8, 144);
+  memset(&lengths[144], 9, 112);
+  memset(&lengths[256], 7, 24);
+  memset(&lengths[280], 8, 8);
+  if (!build(&z->lit, lengths, 288)) return false;
+  memset(lengths, 5, 30);
+  return build(&z->dst, lengths, 30);
+}
+
+static bool dynamicTables(Inflate * z)
+{
+  unsigned char lengths[320];
+  int hlit = bits(z, 5) + 257;
+  int hdist = bits(z, 5) + 1;
+  int hclen = bits(z, 4) + 4;
+  if ( (hlit > 286) || (hdist > 30) ) return false;
+  memset(lengths, 0, 19);
+  for (int i=0; i<hclen; i++) lengths[clorder[i]] = bits(z, 3);
+  // code length code, in the literal table until it is built
+  if (!build(&z->lit, lengths, 19)) return false;
+  int n = 0;
+  while (n < hlit+hdist) {
+    int sym = decode(z, &z->lit);
+    int rep;
+    unsigned char len = 0;
+    if (sym < 0) return false;
+    if (sym < 16) {
+      lengths[n++] = sym;
+      continue;
+    }
+    if (sym == 16) {
+      if (n == 0) return false;
+      len = lengths[n-1];
+      rep = 3 + bits(z, 2);
+    }
+    else if (sym == 17) rep = 3 + bits(z, 3);
+    else rep = 11 + bits(z, 7);
+    if (n + rep > hlit+hdist) return false;
+    while (rep--) lengths[n++] = len;
+  }
+  // end of block code is required
+  if (lengths[256] == 0) return false;
+  return ( (build(&z->lit, lengths, hlit)) && (build(&z->dst, &lengths[hlit], hdist)) );
+}
+
+static bool blockHeader(Inflate * z)
+{
+  z->last = bits(z, 1);
+  switch (bits(z, 2)) {
+    case 0:
+      {
+        // stored, from the next byte boundary
+        bits(z, z->bitcnt & 7);
+        unsigned int len = bits(z, 16);
+        unsigned int nlen = bits(z, 16);
+        if (len != (~nlen & 0xffff)) return false;
+        z->stored = len;
+        z->state = ZS_STORED;
+      }
+      return true;
+    case 1:
+      z->state = ZS_HUFF;
+      return fixedTables(z);
+    case 2:
+      z->state = ZS_HUFF;
+      return dynamicTables(z);
+    default:
+      return false;
+  }
+}
+
+static void inflateStart(Inflate * z, ZipStream * s)
+{
+  emu_FileSeekRaw(z->handler, s->start, SEEK_SET);
+  z->upos = 0;
+  z->inleft = s->csize;
+  z->inpos = 0;
+  z->inlen = 0;
+  z->overrun = 0;
+  z->bitbuf = 0;
+  z->bitcnt = 0;
+  z->state = ZS_BLOCK;
+  z->last = false;
+  z->stored = 0;
+  z->copy = 0;
+  z->sum = 0xffffffff;
+}
+
+// inflates up to n bytes (at most ZIP_STEP) into the window
+static int inflateSome(Inflate * z, int n)
+{
+  unsigned char * w = z->window;
+  unsigned int upos = z->upos;
+  int out = 0;
+  while (out < n) {
+    if (z->copy) {
+      int k = (z->copy < n-out) ? z->copy : n-out;
+      unsigned int from = upos - z->dist;
+      for (int i=0; i<k; i++) w[(upos+i) & ZIP_WMASK] = w[(from+i) & ZIP_WMASK];
+      upos += k;
+      out += k;
+      z->copy -= k;
+      continue;
+    }
+    if (z->state == ZS_HUFF) {
+      int sym = decode(z, &z->lit);
+      if ( (unsigned int)sym < 256 ) {
+        w[upos++ & ZIP_WMASK] = sym;
+        out++;
+        continue;
+      }
+      if (sym == 256) {
+        z->state = ZS_BLOCK;
+        continue;
+      }
+      sym -= 257;
+      if ( (sym < 0) || (sym >= 29) ) {
+        z->state = ZS_ERROR;
+        break;
+      }
+      z->copy = lbase[sym] + bits(z, lext[sym]);
+      int d = decode(z, &z->dst);
+      if ( (d < 0) || (d >= 30) ) {
+        z->state = ZS_ERROR;
+        break;
+      }
+      z->dist = dbase[d] + bits(z, dext[d]);
+      if (z->dist > upos) {
+        z->state = ZS_ERROR;
+        break;
+      }
+    }
+    else if (z->state == ZS_STORED) {
+      int k = (z->stored < n-out) ? z->stored : n-out;
+      for (int i=0; i<k; i++) {
+        // bytes already in the bit buffer come first
+        w[upos++ & ZIP_WMASK] = (z->bitcnt >= 8) ? bits(z, 8) : nextByte(z);
+      }
+      out += k;
+      z->stored -= k;
+      if (!z->stored) z->state = ZS_BLOCK;
+    }
+    else if (z->state == ZS_BLOCK) {
+      if (z->last) {
+        z->state = ZS_DONE;
+      }
+      else if (!blockHeader(z)) {
+        z->state = ZS_ERROR;
+      }
+    }
+    else {
+      break;
+    }
+    // at most 4 bytes of the bit buffer can be read ahead
+    if (z->overrun > 4) z->state = ZS_ERROR;
+  }
+  for (unsigned int i=z->upos; i!=upos; i++) {
+    unsigned int c = z->sum ^ w[i & ZIP_WMASK];
+    c = (c >> 4) ^ crcnibble[c & 15];
+    z->sum = (c >> 4) ^ crcnibble[c & 15];
+  }
+  z->upos = upos;
+  if (z->state == ZS_ERROR) emu_printf("inflate error");
+  return out;
+}
+
+
+/********************************
+ * Archives
+********************************/
+const char * emu_ZipPath(const char * filepath, char * archive, int size)
+{
+  const char * pt = filepath;
+  while ( (pt = strchr(pt, '.')) ) {
+    if (!strncasecmp(pt, ".zip/", 5)) {
+      int len = pt + 4 - filepath;
+      if (len >= size) return NULL;
+      memcpy(archive, filepath, len);
+      archive[len] = 0;
+      return pt + 5;
+    }
+    pt++;
+  }
+  int len = strlen(filepath);
+  if ( ( (len > 3) && (!strcasecmp(&filepath[len-3], ".gz")) ) ||
+       ( (len > 4) && (!strcasecmp(&filepath[len-4], ".zip")) ) ) {
+    if (len >= size) return NULL;
+    strcpy(archive, filepath);
+    return &filepath[len];
+  }
+  return NULL;
+}
+
+// members of the central directory, kept for the next open of the same archive
+static bool zipIndex(int handler, const char * archive, int filesize)
+{
+  unsigned char buf[ZIP_TAIL];
+  if ( (zindex.size == filesize) && (!strcmp(zindex.path, archive)) ) return true;
+  zindex.path[0] = 0;
+
+  // end of central directory, followed by a comment of up to 64KB
+  int eocd = -1;
+  int pos = filesize;
+  while (eocd < 0) {
+    if ( (pos == 0) || (filesize - pos > 0xffff + ZIP_TAIL) ) return false;
+    pos = (pos > ZIP_TAIL-21) ? pos - (ZIP_TAIL-21) : 0;
+    int len = (filesize - pos < ZIP_TAIL) ? filesize - pos : ZIP_TAIL;
+    emu_FileSeekRaw(handler, pos, SEEK_SET);
+    if (emu_FileReadRaw(buf, len, handler) != len) return false;
+    for (int i=len-22; i>=0; i--) {
+      if (rd32(&buf[i]) == ZIP_END_SIG) {
+        eocd = pos + i;
+        break;
+      }
+    }
+  }
+  emu_FileSeekRaw(handler, eocd, SEEK_SET);
+  if (emu_FileReadRaw(buf, 22, handler) != 22) return false;
+  int entries = rd16(&buf[10]);
+  emu_FileSeekRaw(handler, rd32(&buf[16]), SEEK_SET);
+
+  zindex.count = 0;
+  zindex.largest = -1;
+  for (int i=0; (i<entries) && (zindex.count<ZIP_INDEX); i++) {
+    if ( (emu_FileReadRaw(buf, 46, handler) != 46) || (rd32(buf) != ZIP_CENTRAL_SIG) ) return false;
+    ZipEntry * e = &zindex.entry[zindex.count];
+    int nlen = rd16(&buf[28]);
+    int skip = rd16(&buf[30]) + rd16(&buf[32]);
+    e->method = rd16(&buf[10]);
+    e->crc = rd32(&buf[16]);
+    e->csize = rd32(&buf[20]);
+    e->usize = rd32(&buf[24]);
+    e->offset = rd32(&buf[42]);
+    if (nlen > ZIP_TAIL) {
+      // hashed on its first ZIP_TAIL characters
+      skip += nlen - ZIP_TAIL;
+      nlen = ZIP_TAIL;
+    }
+    if (emu_FileReadRaw(buf, nlen, handler) != nlen) return false;
+    emu_FileSeekRaw(handler, skip, SEEK_CUR);
+    e->hash = nameHash((const char *)buf, nlen);
+    // no directories, no ZIP64
+    if ( ( (nlen) && (buf[nlen-1] == '/') ) || (e->csize == 0xffffffff) || (e->usize == 0xffffffff) ) continue;
+    if ( (zindex.largest < 0) || (e->usize > zindex.entry[zindex.largest].usize) ) zindex.largest = zindex.count;
+    zindex.count++;
+  }
+  strncpy(zindex.path, archive, ZIP_PATH-1);
+  zindex.path[ZIP_PATH-1] = 0;
+  zindex.size = filesize;
+  return true;
+}
+
+static bool zipMember(ZipStream * s, int handler, const char * archive, const char * member, int filesize)
+{
+  unsigned char hdr[30];
+  if (!zipIndex(handler, archive, filesize)) {
+    emu_printf("zip directory not found");
+    return false;
+  }
+  const ZipEntry * e = NULL;
+  if (*member) {
+    unsigned int hash = nameHash(member, strlen(member));
+    for (int i=0; i<zindex.count; i++) {
+      if (zindex.entry[i].hash == hash) {
+        e = &zindex.entry[i];
+        break;
+      }
+    }
+  }
+  else if (zindex.largest >= 0) {
+    e = &zindex.entry[zindex.largest];
+  }
+  if (e == NULL) {
+    emu_printf("zip member not found");
+    return false;
+  }
+  if ( (e->method != 0) && (e->method != 8) ) {
+    emu_printf("zip method not supported");
+    return false;
+  }
+  emu_FileSeekRaw(handler, e->offset, SEEK_SET);
+  if ( (emu_FileReadRaw(hdr, 30, handler) != 30) || (rd32(hdr) != ZIP_LOCAL_SIG) ) return false;
+  s->method = e->method;
+  s->start = e->offset + 30 + rd16(&hdr[26]) + rd16(&hdr[28]);
+  s->csize = e->csize;
+  s->usize = e->usize;
+  s->crc = e->crc;
+  return true;
+}
+
+static bool gzMember(ZipStream * s, int handler, const unsigned char * hdr, int filesize)
+{
+  unsigned char buf[8];
+  int flags = hdr[3];
+  // FEXTRA, FNAME, FCOMMENT, FHCRC
+  if (flags & 0x04) {
+    if (emu_FileReadRaw(buf, 2, handler) != 2) return false;
+    emu_FileSeekRaw(handler, rd16(buf), SEEK_CUR);
+  }
+  for (int f=0x08; f<=0x10; f<<=1) {
+    if (flags & f) {
+      do {
+        if (emu_FileReadRaw(buf, 1, handler) != 1) return false;
+      } while (buf[0]);
+    }
+  }
+  if (flags & 0x02) emu_FileSeekRaw(handler, 2, SEEK_CUR);
+  s->method = 8;
+  s->start = emu_FileSeekRaw(handler, 0, SEEK_CUR);
+  if ((int)s->start + 8 > filesize) return false;
+  s->csize = filesize - 8 - s->start;
+  // trailer: crc32 and size modulo 2^32
+  emu_FileSeekRaw(handler, filesize - 8, SEEK_SET);
+  if (emu_FileReadRaw(buf, 8, handler) != 8) return false;
+  s->crc = rd32(&buf[0]);
+  s->usize = rd32(&buf[4]);
+  return true;
+}
+
+int emu_ZipOpen(int handler, const char * archive, const char * member)
+{
+  unsigned char hdr[10];
+  if ( (handler < 1) || (handler > ZIP_STREAMS) ) return -1;
+  ZipStream * s = &streams[handler-1];
+  int filesize = emu_FileSeekRaw(handler, 0, SEEK_END);
+  emu_FileSeekRaw(handler, 0, SEEK_SET);
+  if (emu_FileReadRaw(hdr, sizeof(hdr), handler) != sizeof(hdr)) {
+    emu_FileSeekRaw(handler, 0, SEEK_SET);
+    return 0;
+  }
+  bool ok;
+  if ( (hdr[0] == 0x1f) && (hdr[1] == 0x8b) && (hdr[2] == 8) && (!*member) ) {
+    ok = gzMember(s, handler, hdr, filesize);
+  }
+  else if (rd32(hdr) == ZIP_LOCAL_SIG) {
+    ok = zipMember(s, handler, archive, member, filesize);
+  }
+  else {
+    // not compressed after all, read as is
+    emu_FileSeekRaw(handler, 0, SEEK_SET);
+    return 0;
+  }
+  if (!ok) return -1;
+
+  s->inf = NULL;
+  if (s->method == 8) {
+    if ( !(s->inf = (Inflate *)emu_Malloc(sizeof(Inflate))) ) {
+      emu_printf("inflate: no memory");
+      return -1;
+    }
+    s->inf->handler = handler;
+    inflateStart(s->inf, s);
+  }
+  s->used = true;
+  return 1;
+}
+
+int emu_ZipSize(int handler)
+{
+  ZipStream * s = getStream(handler);
+  return s ? s->usize : 0;
+}
+
+int emu_ZipRead(int handler, void * buf, int size, int pos)
+{
+  ZipStream * s = getStream(handler);
+  if ( (s == NULL) || (pos < 0) ) return 0;
+  if ((unsigned int)pos >= s->usize) return 0;
+  if ((unsigned int)size > s->usize - pos) size = s->usize - pos;
+  PROF_BEGIN(PROF_IO);
+  if (s->method == 0) {
+    emu_FileSeekRaw(handler, s->start + pos, SEEK_SET);
+    size = emu_FileReadRaw(buf, size, handler);
+    PROF_END(PROF_IO);
+    return size;
+  }
+  Inflate * z = s->inf;
+  unsigned char * dst = (unsigned char *)buf;
+  int total = 0;
+  // corrupt data is not handed out, not even what is left in the window
+  if (z->state == ZS_ERROR) {
+    PROF_END(PROF_IO);
+    return 0;
+  }
+  while (total < size) {
+    unsigned int p = pos + total;
+    unsigned int avail = (z->upos < ZIP_WINDOW) ? z->upos : ZIP_WINDOW;
+    if ( (p < z->upos) && (p >= z->upos - avail) ) {
+      // in the window, up to its wrap
+      int k = z->upos - p;
+      int w = ZIP_WINDOW - (p & ZIP_WMASK);
+      if (k > w) k = w;
+      if (k > size - total) k = size - total;
+      memcpy(&dst[total], &z->window[p & ZIP_WMASK], k);
+      total += k;
+      continue;
+    }
+    if (p < z->upos) inflateStart(z, s);
+    if ( (z->state == ZS_DONE) || (z->state == ZS_ERROR) ) break;
+    int n = inflateSome(z, ZIP_STEP);
+    // checked as soon as all the data is out, the end of the stream may not be read yet
+    bool end = (z->state == ZS_DONE) || (z->upos >= s->usize);
+    if ( (end) && ( (z->upos != s->usize) || (~z->sum != s->crc) ) ) {
+      // the end of the data is not returned, the read comes out short
+      emu_printf("inflate crc error");
+      z->state = ZS_ERROR;
+      break;
+    }
+    if (n == 0) break;
+  }
+  PROF_END(PROF_IO);
+  return total;
+}
+
+void emu_ZipClose(int handler)
+{
+  ZipStream * s = getStream(handler);
+  if (s == NULL) return;
+  if (s->inf) emu_Free(s->inf);
+  s->inf = NULL;
+  s->used = false;
+}
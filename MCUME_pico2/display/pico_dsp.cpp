@@ -15,9 +15,11 @@
 #include "hardware/spi.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
+#include "hardware/sync.h"
 #include <string.h>
 
 #include "pico_dsp.h"
+#include "emuapi.h"
 #include "font8x8.h"
 #include "include.h"
 
@@ -102,6 +104,23 @@ static volatile bool cancelled = false;
 static volatile uint8_t curTransfer = 0;
 static uint8_t nbTransfer = 0;
 
+// Dirty line tracking, in dirty refresh mode only the spans of modified
+// lines are pushed (one setArea + DMA per span, spans never cross a block)
+#ifdef TFT_DIRTY_REFRESH
+static bool dirtyRefresh = true;
+#else
+static bool dirtyRefresh = false;
+#endif
+// Lines are marked from both cores (core 1 renders for some emulators) and
+// taken by the DMA ISR: dirtylines and dmaIdle only change under dirtyLock,
+// whoever sets dmaIdle to false owns the SPI until the ISR gives it back.
+static volatile uint32_t dirtylines[(TFT_HEIGHT+31)/32];
+static volatile bool dmaIdle = true;
+static spin_lock_t * dirtyLock = NULL;
+static volatile bool dirtyActive = false;
+static uint16_t area_x0 = 0;
+static uint16_t area_y0 = 0;
+
 #undef B16
 /* VGA structures / constants */
 #define R16(rgb) ((rgb>>8)&0xf8) 
@@ -125,6 +144,60 @@ static int  fb_stride;
 
 static int doorbell_id;
 
+// Palette converted to VGA pixels, rebuilt only for entries invalidated
+// through invalidatePalette() or all of them when another palette is passed
+// in (a static one may never go through emu_SetPaletteEntry).
+// vga_palette2 holds the same color on 2 pixels for 2x horizontal doubling.
+#if (PALETTE_SIZE > 0) && (PALETTE_SIZE < 256)
+#define VGA_PALETTE_SIZE PALETTE_SIZE
+#else
+#define VGA_PALETTE_SIZE 256
+#endif
+static vga_pixel vga_palette[256];
+static uint16_t vga_palette2[256];
+static const dsp_pixel * vga_palette_src = NULL;
+static uint32_t vga_palette_dirty[256/32];
+static bool vga_palette_anydirty = false;
+
+static void invalidateVgaPalette(void)
+{
+  for (int i=0; i<VGA_PALETTE_SIZE; i++) vga_palette_dirty[i>>5] |= (1u<<(i&31));
+  vga_palette_anydirty = true;
+}
+
+static void updateVgaPalette(const dsp_pixel * palette)
+{
+  if (palette != vga_palette_src) {
+    vga_palette_src = palette;
+    invalidateVgaPalette();
+  }
+  if (!vga_palette_anydirty) return;
+  for (int w=0; w<(256/32); w++) {
+    uint32_t bits = vga_palette_dirty[w];
+    while (bits) {
+      int i = (w<<5) + __builtin_ctz(bits);
+      bits &= bits-1;
+      uint16_t pix = palette[i];
+      vga_pixel col = VGA_RGB(R16(pix),G16(pix),B16(pix));
+      vga_palette[i] = col;
+      vga_palette2[i] = col | (col<<8);
+    }
+    vga_palette_dirty[w] = 0;
+  }
+  vga_palette_anydirty = false;
+}
+
+void PICO_DSP::invalidatePalette(int index)
+{
+  if (index < 0) {
+    invalidateVgaPalette();
+  }
+  else if (index < VGA_PALETTE_SIZE) {
+    vga_palette_dirty[index>>5] |= (1u<<(index&31));
+    vga_palette_anydirty = true;
+  }
+}
+
 
 void PICO_DSP::setArea(uint16_t x1,uint16_t y1,uint16_t x2,uint16_t y2) {
   int dx=0;
@@ -144,6 +217,9 @@ void PICO_DSP::setArea(uint16_t x1,uint16_t y1,uint16_t x2,uint16_t y2) {
   }
 #endif  
 
+  area_x0 = (TFT_REALWIDTH-TFT_WIDTH)/2 + dx;
+  area_y0 = (TFT_REALHEIGHT-TFT_HEIGHT)/2 + dy;
+
   digitalWrite(_dc, 0);
   SPItransfer(TFT_CASET);
   digitalWrite(_dc, 1);
@@ -387,14 +463,105 @@ bool PICO_DSP::isflipped(void)
 {
   return(flipped);
 }
+
+void PICO_DSP::setDirtyRefresh(bool on)
+{
+  // taken into account at next startRefresh
+  dirtyRefresh = on;
+}
   
 
 /***********************************************************************************************
     DMA functions
  ***********************************************************************************************/
+static void spiCommand16(uint8_t cmd, uint16_t v1, uint16_t v2) {
+  // 16-bit SPI frames: leading 0x00 is a NOP for the controller
+  uint16_t val = cmd;
+  while (spi_is_busy(TFT_SPIREG)) {};
+  digitalWrite(TFT_DC, 0);
+  spi_write16_blocking(TFT_SPIREG, &val, 1);
+  digitalWrite(TFT_DC, 1);
+  if (cmd != TFT_RAMWR) {
+    spi_write16_blocking(TFT_SPIREG, &v1, 1);
+    spi_write16_blocking(TFT_SPIREG, &v2, 1);
+  }
+}
+
+// called with dirtyLock held, clears the span it returns
+static bool takeDirtySpan(int * py0, int * py1) {
+  int y0 = -1;
+  for (int w=0; w<(TFT_HEIGHT+31)/32; w++) {
+    if (dirtylines[w]) {
+      y0 = (w<<5) + __builtin_ctz(dirtylines[w]);
+      break;
+    }
+  }
+  if (y0 < 0) return false;
+  int yend = ((y0 >> 6) + 1) << 6;
+  if (yend > TFT_HEIGHT) yend = TFT_HEIGHT;
+  int y1 = y0;
+  dirtylines[y0>>5] &= ~(1u<<(y0&31));
+  while ( ((y1+1) < yend) && (dirtylines[(y1+1)>>5] & (1u<<((y1+1)&31))) ) {
+    y1++;
+    dirtylines[y1>>5] &= ~(1u<<(y1&31));
+  }
+  *py0 = y0;
+  *py1 = y1;
+  return true;
+}
+
+// called by the SPI owner, without the lock
+static void sendDirtySpan(int y0, int y1) {
+  spiCommand16(TFT_CASET, area_x0, area_x0+TFT_WIDTH-1);
+  spiCommand16(TFT_PASET, area_y0+y0, area_y0+y1);
+  spiCommand16(TFT_RAMWR, 0, 0);
+  dma_channel_transfer_from_buffer_now(dma_tx, &blocks[y0>>6][(y0&0x3F)*TFT_WIDTH], (y1-y0+1)*TFT_WIDTH);
+}
+
+// takes the next span or releases the SPI, in one step so that a line
+// marked meanwhile is either taken here or kicks a new refresh
+static bool nextDirtySpan(bool stop) {
+  int y0, y1;
+  uint32_t save = spin_lock_blocking(dirtyLock);
+  bool more = (!stop) && takeDirtySpan(&y0, &y1);
+  if (!more) dmaIdle = true;
+  spin_unlock(dirtyLock, save);
+  if (more) sendDirtySpan(y0, y1);
+  return more;
+}
+
+// store a TFT pixel and accumulate whether the line changed
+#define TFT_PUT(dst, val, diff) { uint16_t _v = (val); diff |= (*(dst) ^ _v); *(dst)++ = _v; }
+
+static inline void markDirty(int y0, int y1) {
+  if ( (gfxmode != MODE_TFT_320x240) || (!dirtyActive) ) return;
+  if (y0 < 0) y0 = 0;
+  if (y1 >= TFT_HEIGHT) y1 = TFT_HEIGHT-1;
+  int sy0, sy1;
+  bool kick = false;
+  uint32_t save = spin_lock_blocking(dirtyLock);
+  for (int y=y0; y<=y1; y++) {
+    dirtylines[y>>5] |= (1u<<(y&31));
+  }
+  // the SPI is free: take it and send the first span
+  if ( (dmaIdle) && (!cancelled) && (takeDirtySpan(&sy0, &sy1)) ) {
+    dmaIdle = false;
+    kick = true;
+  }
+  spin_unlock(dirtyLock, save);
+  if (kick) sendDirtySpan(sy0, sy1);
+}
+
 static void dma_isr() { 
   irq_clear(DMA_IRQ_0);
   dma_hw->ints0 = 1u << dma_tx;
+  if (dirtyActive) {
+    if (cancelled) {
+      rstop = 1;
+    }
+    nextDirtySpan(cancelled);
+    return;
+  }
   curTransfer++;
   if (curTransfer >= nbTransfer) {
     curTransfer = 0;
@@ -428,6 +595,10 @@ static void setDmaStruct() {
       false
   ); 
 
+  if (dirtyLock == NULL) {
+    dirtyLock = spin_lock_init(spin_lock_claim_unused(true));
+  }
+
   irq_set_exclusive_handler(DMA_IRQ_0, dma_isr);
   dma_channel_set_irq0_enabled(dma_tx, true);
   irq_set_enabled(DMA_IRQ_0, true);
@@ -477,7 +648,14 @@ void PICO_DSP::startRefresh(void) {
     setArea((TFT_REALWIDTH-TFT_WIDTH)/2, (TFT_REALHEIGHT-TFT_HEIGHT)/2, (TFT_REALWIDTH-TFT_WIDTH)/2 + TFT_WIDTH-1, (TFT_REALHEIGHT-TFT_HEIGHT)/2+TFT_HEIGHT-1);  
     // we switch to 16bit mode!!
     spi_set_format(TFT_SPIREG, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
-    dma_start_channel_mask(1u << dma_tx);    
+    if (dirtyRefresh) {
+      dmaIdle = true;
+      dirtyActive = true;
+      markDirty(0, TFT_HEIGHT-1);
+    }
+    else {
+      dma_start_channel_mask(1u << dma_tx);    
+    }
   }
   else { 
     fillScreen(RGBVAL16(0x00,0x00,0x00));   
@@ -489,6 +667,7 @@ void PICO_DSP::stopRefresh(void) {
     rstop = 1;
     unsigned long m = time_us_32()*1000;   
     cancelled = true; 
+    dirtyActive = false;
     while (!rstop)  {
       if ((time_us_32()*1000 - m) > 100) break;
       sleep_ms(100);
@@ -558,6 +737,7 @@ void PICO_DSP::fillScreen(dsp_pixel color) {
         *dst++ = color;
       }
     }
+    markDirty(0, TFT_HEIGHT-1);
   }
   else {
     vga_pixel color8 = VGA_RGB(R16(color),G16(color),B16(color));
@@ -585,6 +765,7 @@ void PICO_DSP::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, dsp_pixel co
       }
       l++;
     }
+    markDirty(y, y+h-1);
   }
   else {
     vga_pixel color8 = VGA_RGB(R16(color),G16(color),B16(color));
@@ -672,6 +853,7 @@ void PICO_DSP::drawText(int16_t x, int16_t y, const char * text, dsp_pixel fgcol
       }
       x +=8;
     }  
+    markDirty(y, y+(doublesize?16:8)-1);
   }
   else {
     vga_pixel fgcolor8 = VGA_RGB(R16(fgcolor),G16(fgcolor),B16(fgcolor));
@@ -799,6 +981,7 @@ void PICO_DSP::drawSprite(int16_t x, int16_t y, const dsp_pixel *bitmap, uint16_
       bitmap += w;
       l++;
     } 
+    markDirty(ary, ary+arh-1);
   }
   else {
     for (int row=0;row<arh; row++)
@@ -822,9 +1005,11 @@ void PICO_DSP::drawSprite(int16_t x, int16_t y, const dsp_pixel *bitmap) {
 }
 
 void PICO_DSP::writeLine(int width, int height, int y, dsp_pixel *buf) {
+  PROF_BEGIN(PROF_DISPLAY);
   if (gfxmode == MODE_TFT_320x240) {
     uint16_t * block=blocks[y>>6];
     uint16_t * dst=&block[(y&0x3F)*fb_stride];
+    uint16_t diff = 0;
     if (width > fb_width) {
 #ifdef TFT_LINEARINT   
       int delta = (width/(width-fb_width))-1;   
@@ -842,14 +1027,14 @@ void PICO_DSP::writeLine(int width, int height, int y, dsp_pixel *buf) {
  #endif        
           pos = delta;
         }
-        *dst++=val;
+        TFT_PUT(dst, val, diff);
       }
   #else
       int step = ((width << 8)/fb_width);
       int pos = 0;
       for (int i=0; i<fb_width; i++)
       {
-        *dst++=buf[pos >> 8];
+        TFT_PUT(dst, buf[pos >> 8], diff);
         pos +=step;
       }  
   #endif       
@@ -858,8 +1043,8 @@ void PICO_DSP::writeLine(int width, int height, int y, dsp_pixel *buf) {
     {
       for (int i=0; i<width; i++)
       {
-        *dst++=*buf;
-        *dst++=*buf++;
+        TFT_PUT(dst, *buf, diff);
+        TFT_PUT(dst, *buf++, diff);
       }       
     }
     else
@@ -869,9 +1054,10 @@ void PICO_DSP::writeLine(int width, int height, int y, dsp_pixel *buf) {
       }
       for (int i=0; i<width; i++)
       {
-        *dst++=*buf++;
+        TFT_PUT(dst, *buf++, diff);
       }       
     }    
+    if (diff) markDirty(y, y);
   }
   else {
     if ( (height<fb_height) && (height > 2) ) y += (fb_height-height)/2;
@@ -906,13 +1092,16 @@ void PICO_DSP::writeLine(int width, int height, int y, dsp_pixel *buf) {
       }      
     }
   }  
+  PROF_END(PROF_DISPLAY);
 }
 
 void PICO_DSP::writeLinePal(int width, int height, int y, uint8_t *buf, dsp_pixel *palette) {
+  PROF_BEGIN(PROF_DISPLAY);
   if (gfxmode == MODE_TFT_320x240) {
     if ( (height<fb_height) && (height > 2) ) y += (fb_height-height)/2;
     uint16_t * block=blocks[y>>6];
     uint16_t * dst=&block[(y&0x3F)*fb_stride];
+    uint16_t diff = 0;
     if (width > fb_width) {
 #ifdef TFT_LINEARINT    
       int delta = (width/(width-fb_width))-1;
@@ -930,14 +1119,14 @@ void PICO_DSP::writeLinePal(int width, int height, int y, uint8_t *buf, dsp_pixe
 #endif        
           pos = delta;
         }
-        *dst++=val;
+        TFT_PUT(dst, val, diff);
       }
 #else
       int step = ((width << 8)/fb_width);
       int pos = 0;
       for (int i=0; i<fb_width; i++)
       {
-        *dst++=palette[buf[pos >> 8]];
+        TFT_PUT(dst, palette[buf[pos >> 8]], diff);
         pos +=step;
       }  
 #endif
@@ -945,8 +1134,8 @@ void PICO_DSP::writeLinePal(int width, int height, int y, uint8_t *buf, dsp_pixe
     else if ((width*2) == fb_width) {
       for (int i=0; i<width; i++)
       {
-        *dst++=palette[*buf];
-        *dst++=palette[*buf++];
+        TFT_PUT(dst, palette[*buf], diff);
+        TFT_PUT(dst, palette[*buf++], diff);
       } 
     }
     else {
@@ -955,30 +1144,43 @@ void PICO_DSP::writeLinePal(int width, int height, int y, uint8_t *buf, dsp_pixe
       }
       for (int i=0; i<width; i++)
       {
-        *dst++=palette[*buf++];
+        TFT_PUT(dst, palette[*buf++], diff);
       } 
     }    
+    if (diff) markDirty(y, y);
   }  
   else {
     if ( (height<fb_height) && (height > 2) ) y += (fb_height-height)/2;
     vga_pixel * dst=&framebuffer[y*fb_stride];
+    updateVgaPalette(palette);
     if (width > fb_width) {
+      // fb_width is a multiple of 4, build 4 pixels per store
       int step = ((width << 8)/fb_width);
       int pos = 0;
-      for (int i=0; i<fb_width; i++)
+      uint32_t * dst32 = (uint32_t *)dst;
+      for (int i=0; i<(fb_width>>2); i++)
       {
-        uint16_t pix = palette[buf[pos >> 8]];
-        *dst++= VGA_RGB(R16(pix),G16(pix),B16(pix));
+        uint32_t val = vga_palette[buf[pos >> 8]];
+        pos +=step;
+        val |= vga_palette[buf[pos >> 8]]<<8;
+        pos +=step;
+        val |= vga_palette[buf[pos >> 8]]<<16;
         pos +=step;
+        val |= vga_palette[buf[pos >> 8]]<<24;
+        pos +=step;
+        *dst32++ = val;
       }  
     }
     else if ((width*2) == fb_width) {
-      for (int i=0; i<width; i++)
+      uint32_t * dst32 = (uint32_t *)dst;
+      for (int i=0; i<(width>>1); i++)
       {
-        uint16_t pix = palette[*buf++];
-        *dst++= VGA_RGB(R16(pix),G16(pix),B16(pix));
-        *dst++= VGA_RGB(R16(pix),G16(pix),B16(pix));
+        *dst32++ = vga_palette2[buf[0]] | (vga_palette2[buf[1]]<<16);
+        buf += 2;
       } 
+      if (width & 1) {
+        *(uint16_t *)dst32 = vga_palette2[*buf];
+      }
     }
     else {
       if (width <= fb_width) {
@@ -986,14 +1188,15 @@ void PICO_DSP::writeLinePal(int width, int height, int y, uint8_t *buf, dsp_pixe
       }
       for (int i=0; i<width; i++)
       {
-        uint16_t pix = palette[*buf++];
-        *dst++= VGA_RGB(R16(pix),G16(pix),B16(pix));
+        *dst++= vga_palette[*buf++];
       } 
     }
   }
+  PROF_END(PROF_DISPLAY);
 }
 
 void PICO_DSP::writeScreenPal(int width, int height, int stride, uint8_t *buf, dsp_pixel *palette16) {
+  PROF_BEGIN(PROF_DISPLAY);
   uint8_t *src; 
   int i,j,y=0;
   int sy = 0;  
@@ -1010,12 +1213,14 @@ void PICO_DSP::writeScreenPal(int width, int height, int stride, uint8_t *buf, d
         uint16_t * block=blocks[y>>6];
         uint16_t * dst=&block[(y&0x3F)*fb_stride];        
         src=&buf[(sy>>8)*stride];
+        uint16_t diff = 0;
         for (i=0; i<width; i++)
         {
           uint16_t val = palette16[*src++];
-          *dst++ = val;
-          *dst++ = val;
+          TFT_PUT(dst, val, diff);
+          TFT_PUT(dst, val, diff);
         }
+        if (diff) markDirty(y, y);
         y++;
         sy+=systep;  
       }
@@ -1026,27 +1231,32 @@ void PICO_DSP::writeScreenPal(int width, int height, int stride, uint8_t *buf, d
         uint16_t * block=blocks[y>>6];
         uint16_t * dst=&block[(y&0x3F)*fb_stride+(fb_width-width)/2];        
         src=&buf[(sy>>8)*stride];
+        uint16_t diff = 0;
         for (i=0; i<width; i++)
         {
           uint16_t val = palette16[*src++];
-          *dst++ = val;
+          TFT_PUT(dst, val, diff);
         }
+        if (diff) markDirty(y, y);
         y++;
         sy+=systep;  
       }
     }
   }       
   else { // VGA
+    updateVgaPalette(palette16);
     if (width*2 <= fb_width) {
       for (j=0; j<h; j++)
       {
-        vga_pixel * dst=&framebuffer[y*fb_stride];                
+        uint32_t * dst32=(uint32_t *)&framebuffer[y*fb_stride];                
         src=&buf[(sy>>8)*stride];
-        for (i=0; i<width; i++)
+        for (i=0; i<(width>>1); i++)
         {
-          uint16_t pix = palette16[*src++];
-          *dst++ = VGA_RGB(R16(pix),G16(pix),B16(pix));
-          *dst++ = VGA_RGB(R16(pix),G16(pix),B16(pix));
+          *dst32++ = vga_palette2[src[0]] | (vga_palette2[src[1]]<<16);
+          src += 2;
+        }
+        if (width & 1) {
+          *(uint16_t *)dst32 = vga_palette2[*src];
         }
         y++;
         sy+=systep;  
@@ -1059,14 +1269,14 @@ void PICO_DSP::writeScreenPal(int width, int height, int stride, uint8_t *buf, d
         src=&buf[(sy>>8)*stride];
         for (i=0; i<width; i++)
         {
-          uint16_t pix = palette16[*src++];
-          *dst++ = VGA_RGB(R16(pix),G16(pix),B16(pix));
+          *dst++ = vga_palette[*src++];
         }
         y++;
         sy+=systep;  
       }
     }
   }
+  PROF_END(PROF_DISPLAY);
 }
 
 
@@ -1269,6 +1479,10 @@ void PICO_DSP::drawTextNoDma(int16_t x, int16_t y, const char * text, dsp_pixel
 }
 
 
+// work the emulation hands to core 1, run between audio buffers
+static void (* volatile core1task)(void) = nullptr;
+static bool core1started = false;
+
 #ifdef HAS_SND
 
 #include "hardware/dma.h"
@@ -1559,7 +1773,9 @@ if(DEBUG_I2C) {
 }
 
 static void i2s_audio_handle_buffer(void) {
-    audio_buffer *buffer = take_audio_buffer(producer_pool, true);
+    // only wait for a free buffer if there is nothing else to do
+    audio_buffer *buffer = take_audio_buffer(producer_pool, core1task == nullptr);
+    if (buffer == NULL) return;
     fillsamples(reinterpret_cast<audio_sample*>(buffer->buffer->bytes), buffer->max_sample_count);
     buffer->sample_count = buffer->max_sample_count;
     give_audio_buffer(producer_pool, buffer);
@@ -1569,6 +1785,7 @@ static void core1_func_tft() {
   i2s_audio_init();
     while (true) {
         if (producer_pool && fillsamples) i2s_audio_handle_buffer();
+        if (core1task) core1task();
         __dmb();
     }
 }
@@ -1579,7 +1796,10 @@ void PICO_DSP::begin_audio(int samplesize, void (*callback)(short * stream, int
 
   producer_pool = audio_new_producer_pool(&producer_format, 3, samplesize);
   fillsamples = callback;
-  multicore_launch_core1(core1_func_tft);
+  if (!core1started) {
+    core1started = true;
+    multicore_launch_core1(core1_func_tft);
+  }
 }
 
 void PICO_DSP::end_audio()
@@ -1593,5 +1813,30 @@ void * PICO_DSP::get_buffer_audio(void)
 
 #endif
 
+
+/***********************************************************************************************
+    Core 1 task
+ ***********************************************************************************************/
+static void core1_func_task() {
+    while (true) {
+        if (core1task) core1task();
+        __dmb();
+    }
+}
+
+// task is called over and over on core 1, it must return quickly when idle
+// (to be called after begin_audio, which owns core 1 when there is sound)
+bool PICO_DSP::begin_core1(void (*task)(void))
+{
+  core1task = task;
+  if (!core1started) {
+    // no audio loop to share core 1 with
+    core1started = true;
+    multicore_launch_core1(core1_func_task);
+  }
+  return true;
+}
+
+
  
 
@@ -79,12 +79,16 @@ public:
   void end_audio();
   void * get_buffer_audio();
 #endif
+  // run a polled task on core 1, next to the audio
+  bool begin_core1(void (*task)(void));
 
   // framebuffer/screen operation
   int get_frame_buffer_size(int *width, int *height);
   void setArea(uint16_t x1,uint16_t y1,uint16_t x2,uint16_t y2);
   void flipscreen(bool flip);
   bool isflipped(void);
+  // TFT: only push lines that changed instead of refreshing the whole frame
+  void setDirtyRefresh(bool on);
 
   // wait next Vsync
   void waitSync();
@@ -98,6 +102,8 @@ public:
   void writeLine(int width, int height, int y, dsp_pixel *buf);
   void writeLinePal(int width, int height, int y, uint8_t *buffer, dsp_pixel *palette16);
   void writeScreenPal(int width, int height, int stride, uint8_t *buf, dsp_pixel *palette16);
+  // palette entry changed (index<0 for all), VGA conversion is redone on next use
+  void invalidatePalette(int index);
   
   void fillScreen(dsp_pixel color);
   void drawText(int16_t x, int16_t y, const char * text, dsp_pixel fgcolor, dsp_pixel bgcolor, bool doublesize);
@@ -11,6 +11,7 @@
 #include "emuapi.h"
 
 extern size_t _psram_size;
+extern size_t _psram_heap_size;
 
 static bool using_psram;
 
@@ -20,18 +21,98 @@ static bool using_psram;
 unsigned char * flash_start = (unsigned char *)(XIP_BASE + HW_FLASH_STORAGE_BASE);
 unsigned char * flash_end = (unsigned char *)(XIP_BASE + HW_FLASH_STORAGE_TOP);
 
-static uint8_t cache[FLASH_SECTOR_SIZE];
+// Last sector of the storage area describes what is loaded,
+// so that reloading the same ROM does not touch the flash at all
+#define MANIFEST_MAGIC   0x4d464c31 // "MFL1"
+#define MANIFEST_NAME    64
+
+typedef struct {
+  uint32_t magic;
+  uint32_t size;
+  uint32_t date;
+  uint32_t crc;
+  uint32_t bswap;
+  char name[MANIFEST_NAME];
+} flash_manifest_t;
+
+static uint8_t cache[FLASH_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint32_t crctable[256];
 
 static void flash_setup() {
     if (_psram_size) {
         using_psram = true;
         flash_start = (unsigned char*)PSRAM_BASE;
-        flash_end = flash_start + _psram_size;
+        // top of PSRAM may be used by the slow heap (emu_MallocHint)
+        flash_end = flash_start + _psram_size - _psram_heap_size;
     } else {
         using_psram = false;
     }
 }
 
+static uint32_t crc32(uint32_t crc, const uint8_t * buf, int len)
+{
+  if (crctable[1] == 0) {
+    for (uint32_t i=0; i<256; i++) {
+      uint32_t c = i;
+      for (int k=0; k<8; k++) c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+      crctable[i] = c;
+    }
+  }
+  crc = ~crc;
+  while (len--) crc = crctable[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void bswap16(uint8_t * buf, int n)
+{
+  uint32_t * pt = (uint32_t *)buf;
+  for (int i=0; i<(n>>2); i++) {
+    uint32_t v = pt[i];
+    pt[i] = ((v & 0x00ff00ff) << 8) | ((v >> 8) & 0x00ff00ff);
+  }
+  if (n & 2) {
+    uint8_t k = buf[n-2];
+    buf[n-2] = buf[n-1];
+    buf[n-1] = k;
+  }
+}
+
+static void flash_write_sector(uint8_t * dest, const uint8_t * src)
+{
+  uint32_t ints = save_and_disable_interrupts();
+  uint32_t offset = dest - (uint8_t*)XIP_BASE;
+  flash_range_erase(offset, FLASH_SECTOR_SIZE);
+  flash_range_program(offset, src, FLASH_SECTOR_SIZE);
+  restore_interrupts(ints);
+}
+
+static flash_manifest_t * manifest(void)
+{
+  return (flash_manifest_t *)(flash_end - FLASH_SECTOR_SIZE);
+}
+
+static void manifest_write(const flash_manifest_t * m)
+{
+  if (using_psram) {
+    memcpy(manifest(), m, sizeof(flash_manifest_t));
+  } else {
+    memset(cache, 0xff, FLASH_SECTOR_SIZE);
+    memcpy(cache, m, sizeof(flash_manifest_t));
+    flash_write_sector((uint8_t *)manifest(), cache);
+  }
+}
+
+static bool manifest_match(const flash_manifest_t * m)
+{
+  const flash_manifest_t * cur = manifest();
+  if ( (cur->magic != MANIFEST_MAGIC) || (cur->size != m->size) || (cur->date != m->date) ||
+       (cur->bswap != m->bswap) || (strncmp(cur->name, m->name, MANIFEST_NAME)) ) {
+    return false;
+  }
+  // content could have been overwritten by another core
+  return (crc32(0, flash_start, m->size) == cur->crc);
+}
+
 int flash_load_common(const char * filename, bool do_bswap)
 {
   flash_setup();
@@ -40,37 +121,56 @@ int flash_load_common(const char * filename, bool do_bswap)
   int n;
   int size = 0;
   emu_printf("flash_load...");
+
+  flash_manifest_t m;
+  memset(&m, 0, sizeof(m));
+  m.magic = MANIFEST_MAGIC;
+  m.size = emu_FileSize(filename);
+  m.date = emu_FileDate(filename);
+  m.bswap = do_bswap;
+  strncpy(m.name, filename, MANIFEST_NAME-1);
+  if ( (m.size) && (m.size <= (flash_end - flash_start - FLASH_SECTOR_SIZE)) && (manifest_match(&m)) ) {
+    emu_printf("flash_load unchanged.");
+    return m.size;
+  }
+  if (manifest()->magic == MANIFEST_MAGIC) {
+    // content is about to change
+    flash_manifest_t none;
+    memset(&none, 0xff, sizeof(none));
+    manifest_write(&none);
+  }
+
+  uint32_t crc = 0;
   int f = emu_FileOpen(filename,"r+b");
   if (f) {
-    while ( (dest < (flash_end-FLASH_SECTOR_SIZE)) && (n = emu_FileRead(cache,FLASH_SECTOR_SIZE,f) ) ) {
-      if (do_bswap) {
-          for (int i=0;i<n; i+=2) {
-              uint8_t k = cache[i];
-              cache[i]=cache[i+1];
-              cache[i+1] = k;
-          }
-      }
+    PROF_BEGIN(PROF_IO);
+    while (dest < (flash_end-FLASH_SECTOR_SIZE)) {
       if (using_psram) {
-          memcpy(dest, cache, n);
-      } else if (memcmp(cache, dest, n)) {
-          uint32_t ints = save_and_disable_interrupts();
-          uint32_t offset = dest - (uint8_t*)XIP_BASE;
-          flash_range_erase(offset, FLASH_SECTOR_SIZE);
-          flash_range_program(offset, (const uint8_t *)&cache[0], FLASH_SECTOR_SIZE);
-          restore_interrupts(ints);
-          emu_printi(n);
-          emu_printi(offset);
-          //uint8_t * pt = (uint8_t*)(XIP_BASE + offset);
-          //emu_printi(pt[0]);
-          //emu_printi(pt[1]);
-          //emu_printi(pt[2]);
-          //emu_printi(pt[3]);
+        // PSRAM is memory mapped, read straight into it
+        if ( !(n = emu_FileRead(dest,FLASH_SECTOR_SIZE,f)) ) break;
+        if (do_bswap) bswap16(dest, n);
+        crc = crc32(crc, dest, n);
+      } else {
+        if ( !(n = emu_FileRead(cache,FLASH_SECTOR_SIZE,f)) ) break;
+        if (do_bswap) bswap16(cache, n);
+        crc = crc32(crc, cache, n);
+        if (memcmp(cache, dest, n)) {
+          flash_write_sector(dest, cache);
+        }
       }
       dest += FLASH_SECTOR_SIZE;
-      size += n;          
+      size += n;
     }
     emu_FileClose(f);
-    emu_printf("flash_load OK.");    
+    PROF_END(PROF_IO);
+    if (size != m.size) {
+      // read error or corrupt archive, nothing valid is loaded
+      emu_printf("flash_load failed.");
+      return 0;
+    }
+    m.crc = crc;
+    manifest_write(&m);
+    emu_printf("flash_load OK.");
   }
 
   return size;
@@ -91,18 +191,17 @@ int flash_verify(unsigned char * buf, int size)
   flash_setup();
   unsigned char * datapt = flash_start;
   emu_printf("flash_verify...");
-  int count = size;
-  while (count++ < size) {
+  for (int count=0; count < size; count++) {
     if (*datapt != *buf) {
       emu_printf("mismatch at ");
       emu_printi(count);
       emu_printi(*datapt);
       emu_printi(*buf);
       return 1;
-    }  
+    }
     datapt++;
-    buf++; 
-  }  
+    buf++;
+  }
   emu_printf("flash_verify OK.");
   return 0;
 }
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Runs the reference workloads of bench.txt with the host build of each core
+# and prints one CSV line (or JSON object) per workload.
+#
+# ROMDIR=~/roms ./bench.sh [csv|json] > results.csv
+#
+# Zone columns are in us per emulated frame, other is the part of a frame
+# outside any zone. Cores only report zones once they call PROF_FRAME().
+
+FORMAT=${1:-csv}
+HERE=$(cd $(dirname $0) && pwd)
+ROMDIR=${ROMDIR:-.}
+BUILDDIR=${BUILDDIR:-$HERE/../build_host}
+
+if [ "$FORMAT" = "csv" ]; then
+  echo "core,rom,frames,time,fps,frame_max_us,cpu_us,video_us,audio_us,io_us,display_us,other_us"
+fi
+
+grep -v '^#' $HERE/bench.txt | while read core rom frames; do
+  [ -z "$core" ] && continue
+  if [ ! -f "$ROMDIR/$rom" ]; then
+    echo "skipping $core $rom: not found" >&2
+    continue
+  fi
+  if [ ! -x "$BUILDDIR/$core/$core" ]; then
+    cmake -S $HERE -B $BUILDDIR/$core -DTARGET=$core > /dev/null 2>&1 &&
+    cmake --build $BUILDDIR/$core -j > /dev/null 2>&1 || { echo "skipping $core: build failed" >&2; continue; }
+  fi
+  # cores may print on stdout, only keep the record
+  (cd $ROMDIR && $BUILDDIR/$core/$core -q -n $frames -p $FORMAT $rom) | grep -a -E "^($core,|\{)"
+done
@@ -0,0 +1,30 @@
+/*
+  Host (headless) build of the emulators
+*/
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdint.h>
+
+struct HostOptions {
+  const char * rom;       // passed to the core as the menu selection
+  int frames;             // stop after this number of frames
+  int fps;                // emulated refresh rate, for audio pacing and realtime ratio
+  const char * dumpdir;   // frames as PPM files
+  int dumpevery;          // dump 1 frame out of dumpevery
+  const char * audio;     // audio as WAV file
+  bool quiet;             // no emu_printf output
+  const char * profile;   // "csv" or "json" report of emu_ProfStats()
+  int keyframe;           // press USER1 (start, autoload) once at this frame
+  int stateframe;         // save the state in slot 0 at the end of this frame
+};
+
+extern HostOptions host_options;
+
+// entry points for the stand-ins
+extern void host_audio(void (*callback)(short * stream, int len));
+// end of frame, from emu_DrawVsync() (vsync) or once per main loop iteration
+extern void host_vsync(bool vsync);
+
+#endif
@@ -0,0 +1,327 @@
+/*
+  Host stand-in for display/pico_dsp.cpp
+  VGA modes only, rendered into a memory framebuffer with the same
+  8-bit pixel format and scaling rules as the device.
+*/
+
+#include "pico.h"
+#include <string.h>
+#include <thread>
+
+#include "pico_dsp.h"
+#include "emuapi.h"
+#include "font8x8.h"
+#include "host.h"
+
+#define R16(rgb) ((rgb>>8)&0xf8)
+#define G16(rgb) ((rgb>>3)&0xfc)
+#define B16(rgb) ((rgb<<3)&0xf8)
+#ifdef VGA222
+#define VGA_RGB(r,g,b)   ( (((r>>6)&0x03)<<4) | (((g>>6)&0x03)<<2) | (((b>>6)&0x3)<<0) )
+#else
+#define VGA_RGB(r,g,b)   ( (((r>>5)&0x07)<<5) | (((g>>5)&0x07)<<2) | (((b>>6)&0x3)<<0) )
+#endif
+
+__thread unsigned int host_core_num = 0;
+
+static gfx_mode_t gfxmode = MODE_UNDEFINED;
+static vga_pixel framebuffer[640*240];
+static int  fb_width;
+static int  fb_height;
+static int  fb_stride;
+
+static inline vga_pixel vgaColor(dsp_pixel pix)
+{
+  return VGA_RGB(R16(pix),G16(pix),B16(pix));
+}
+
+
+PICO_DSP::PICO_DSP()
+{
+}
+
+gfx_error_t PICO_DSP::begin(gfx_mode_t mode)
+{
+  switch(mode) {
+    case MODE_VGA_256x240:
+      fb_width = 256;
+      fb_stride = 320;
+      break;
+    case MODE_VGA_640x240:
+      fb_width = 640;
+      fb_stride = 640;
+      break;
+    default:
+      // no TFT on the host, same resolution through the VGA path
+      mode = MODE_VGA_320x240;
+      fb_width = 320;
+      fb_stride = 320;
+      break;
+  }
+  gfxmode = mode;
+  fb_height = 240;
+  memset(framebuffer, 0, sizeof(framebuffer));
+  return(GFX_OK);
+}
+
+gfx_mode_t PICO_DSP::getMode(void)
+{
+  return gfxmode;
+}
+
+void PICO_DSP::end()
+{
+}
+
+void PICO_DSP::startRefresh(void)
+{
+}
+
+void PICO_DSP::stopRefresh(void)
+{
+}
+
+void PICO_DSP::flipscreen(bool flip)
+{
+  flipped = flip;
+}
+
+bool PICO_DSP::isflipped(void)
+{
+  return(flipped);
+}
+
+void PICO_DSP::setDirtyRefresh(bool on)
+{
+}
+
+void PICO_DSP::setArea(uint16_t x1,uint16_t y1,uint16_t x2,uint16_t y2)
+{
+}
+
+int PICO_DSP::get_frame_buffer_size(int *width, int *height)
+{
+  if (width != nullptr) *width = fb_width;
+  if (height != nullptr) *height = fb_height;
+  return fb_stride;
+}
+
+// frames are paced by the host loop
+void PICO_DSP::waitSync()
+{
+}
+
+void PICO_DSP::waitLine(int line)
+{
+}
+
+void PICO_DSP::invalidatePalette(int index)
+{
+}
+
+#ifdef HAS_SND
+void PICO_DSP::begin_audio(int samplesize, void (*callback)(short * stream, int len))
+{
+  host_audio(callback);
+}
+
+void PICO_DSP::end_audio()
+{
+  host_audio(NULL);
+}
+
+void * PICO_DSP::get_buffer_audio(void)
+{
+  return NULL;
+}
+#endif
+
+// a thread stands in for core 1, it is not stopped (the runner exits)
+bool PICO_DSP::begin_core1(void (*task)(void))
+{
+  std::thread core1([task]() {
+    host_core_num = 1;
+    while (true) {
+      task();
+      std::this_thread::yield();
+    }
+  });
+  core1.detach();
+  return true;
+}
+
+
+/***********************************************************************************************
+    GFX functions
+ ***********************************************************************************************/
+
+dsp_pixel * PICO_DSP::getLineBuffer(int j) {
+  return ((dsp_pixel *)&framebuffer[j*fb_stride]);
+}
+
+void PICO_DSP::fillScreen(dsp_pixel color) {
+  vga_pixel color8 = vgaColor(color);
+  for (int j=0; j<fb_height; j++) {
+    memset(&framebuffer[j*fb_stride], color8, fb_width);
+  }
+}
+
+void PICO_DSP::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, dsp_pixel color) {
+  vga_pixel color8 = vgaColor(color);
+  for (int j=0; j<h; j++) {
+    memset(&framebuffer[(y+j)*fb_stride+x], color8, w);
+  }
+}
+
+void PICO_DSP::drawText(int16_t x, int16_t y, const char * text, dsp_pixel fgcolor, dsp_pixel bgcolor, bool doublesize) {
+  vga_pixel fgcolor8 = vgaColor(fgcolor);
+  vga_pixel bgcolor8 = vgaColor(bgcolor);
+  unsigned char c;
+  while ((c = *text++)) {
+    const unsigned char * charpt=&font8x8[c][0];
+    int l=y;
+    for (int i=0;i<8;i++) {
+      unsigned char bits = *charpt++;
+      for (int r=0; r<(doublesize?2:1); r++) {
+        vga_pixel * dst=&framebuffer[l*fb_stride+x];
+        for (int b=0; b<8; b++) {
+          *dst++ = ((bits>>b)&0x01) ? fgcolor8 : bgcolor8;
+        }
+        l++;
+      }
+    }
+    x +=8;
+  }
+}
+
+void PICO_DSP::drawSprite(int16_t x, int16_t y, const dsp_pixel *bitmap, uint16_t arx, uint16_t ary, uint16_t arw, uint16_t arh)
+{
+  int w = *bitmap++;
+  int h = *bitmap++;
+  if ( (arw == 0) || (arh == 0) ) {
+    arx = x; ary = y; arw = w; arh = h;
+  }
+  for (int row=0; row<arh; row++) {
+    int sy = ary+row-y;
+    if ( (sy < 0) || (sy >= h) || ((ary+row) >= fb_height) ) continue;
+    vga_pixel * dst=&framebuffer[(ary+row)*fb_stride+arx];
+    for (int col=0; col<arw; col++) {
+      int sx = arx+col-x;
+      if ( (sx >= 0) && (sx < w) ) dst[col] = vgaColor(bitmap[sy*w+sx]);
+    }
+  }
+}
+
+void PICO_DSP::drawSprite(int16_t x, int16_t y, const dsp_pixel *bitmap) {
+  drawSprite(x,y,bitmap, 0,0,0,0);
+}
+
+void PICO_DSP::writeLine(int width, int height, int y, dsp_pixel *buf) {
+  PROF_BEGIN(PROF_DISPLAY);
+  if ( (height<fb_height) && (height > 2) ) y += (fb_height-height)/2;
+  vga_pixel * dst=&framebuffer[y*fb_stride];
+  if (width > fb_width) {
+    int step = ((width << 8)/fb_width);
+    int pos = 0;
+    for (int i=0; i<fb_width; i++) {
+      *dst++ = vgaColor(buf[pos >> 8]);
+      pos +=step;
+    }
+  }
+  else if ((width*2) == fb_width) {
+    for (int i=0; i<width; i++) {
+      vga_pixel col = vgaColor(*buf++);
+      *dst++= col;
+      *dst++= col;
+    }
+  }
+  else {
+    dst += (fb_width-width)/2;
+    for (int i=0; i<width; i++) {
+      *dst++= vgaColor(*buf++);
+    }
+  }
+  PROF_END(PROF_DISPLAY);
+}
+
+void PICO_DSP::writeLinePal(int width, int height, int y, uint8_t *buf, dsp_pixel *palette) {
+  PROF_BEGIN(PROF_DISPLAY);
+  if ( (height<fb_height) && (height > 2) ) y += (fb_height-height)/2;
+  vga_pixel * dst=&framebuffer[y*fb_stride];
+  if (width > fb_width) {
+    int step = ((width << 8)/fb_width);
+    int pos = 0;
+    for (int i=0; i<fb_width; i++) {
+      *dst++ = vgaColor(palette[buf[pos >> 8]]);
+      pos +=step;
+    }
+  }
+  else if ((width*2) == fb_width) {
+    for (int i=0; i<width; i++) {
+      vga_pixel col = vgaColor(palette[*buf++]);
+      *dst++= col;
+      *dst++= col;
+    }
+  }
+  else {
+    dst += (fb_width-width)/2;
+    for (int i=0; i<width; i++) {
+      *dst++= vgaColor(palette[*buf++]);
+    }
+  }
+  PROF_END(PROF_DISPLAY);
+}
+
+void PICO_DSP::writeScreenPal(int width, int height, int stride, uint8_t *buf, dsp_pixel *palette16) {
+  PROF_BEGIN(PROF_DISPLAY);
+  int sy = 0;
+  int systep=(1<<8);
+  int h = height;
+  if (height <= ( (2*fb_height)/3)) {
+    systep=(systep*height)/fb_height;
+    h = fb_height;
+  }
+  for (int y=0; y<h; y++) {
+    uint8_t * src=&buf[(sy>>8)*stride];
+    if (width*2 <= fb_width) {
+      vga_pixel * dst=&framebuffer[y*fb_stride];
+      for (int i=0; i<width; i++) {
+        vga_pixel col = vgaColor(palette16[*src++]);
+        *dst++ = col;
+        *dst++ = col;
+      }
+    }
+    else if (width <= fb_width) {
+      vga_pixel * dst=&framebuffer[y*fb_stride+(fb_width-width)/2];
+      for (int i=0; i<width; i++) {
+        *dst++ = vgaColor(palette16[*src++]);
+      }
+    }
+    sy+=systep;
+  }
+  PROF_END(PROF_DISPLAY);
+}
+
+
+/***********************************************************************************************
+    No DMA functions, same as above on the host
+ ***********************************************************************************************/
+void PICO_DSP::fillScreenNoDma(dsp_pixel color) {
+  fillScreen(color);
+}
+
+void PICO_DSP::drawRectNoDma(int16_t x, int16_t y, int16_t w, int16_t h, dsp_pixel color) {
+  drawRect(x, y, w, h, color);
+}
+
+void PICO_DSP::drawTextNoDma(int16_t x, int16_t y, const char * text, dsp_pixel fgcolor, dsp_pixel bgcolor, bool doublesize) {
+  drawText(x, y, text, fgcolor, bgcolor, doublesize);
+}
+
+void PICO_DSP::drawSpriteNoDma(int16_t x, int16_t y, const dsp_pixel *bitmap) {
+  drawSprite(x, y, bitmap);
+}
+
+void PICO_DSP::drawSpriteNoDma(int16_t x, int16_t y, const dsp_pixel *bitmap, uint16_t croparx, uint16_t cropary, uint16_t croparw, uint16_t croparh) {
+  drawSprite(x, y, bitmap, croparx, cropary, croparw, croparh);
+}
@@ -0,0 +1,251 @@
+/*
+  Host stand-in for FatFs (fatfs/source/ff.c)
+  The calls of the display layer on host files. Paths are host paths, the
+  current directory stands for the root of the card.
+  There are no clusters: fast seek maps are left empty, and seeking past
+  the end of a writable file extends it.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// the POSIX directory stream has the name of the FatFs object
+#define DIR HOST_DIR
+#include <dirent.h>
+#undef DIR
+
+#include "ff.h"
+
+#define HOST_FILES      16
+#define HOST_DIRS       4
+// sectors per cluster of the mounted volume (32KB, as on most cards)
+#define HOST_CSIZE      64
+
+static FATFS * volume = NULL;
+static FILE * files[HOST_FILES];
+static HOST_DIR * dirs[HOST_DIRS];
+
+
+static FILE * hostFile(FIL * fp)
+{
+  if ( (fp == NULL) || (fp->obj.fs == NULL) || (fp->obj.id < 1) || (fp->obj.id > HOST_FILES) ) return NULL;
+  return files[fp->obj.id-1];
+}
+
+static HOST_DIR * hostDir(DIR * dp)
+{
+  if ( (dp == NULL) || (dp->obj.fs == NULL) || (dp->obj.id < 1) || (dp->obj.id > HOST_DIRS) ) return NULL;
+  return dirs[dp->obj.id-1];
+}
+
+static const char * hostPath(const TCHAR * path)
+{
+  return (path[0] ? path : ".");
+}
+
+// FAT packed date and time of the FILINFO
+static void hostInfo(const char * name, const struct stat * st, FILINFO * fno)
+{
+  struct tm * t = localtime(&st->st_mtime);
+  fno->fsize = S_ISDIR(st->st_mode) ? 0 : st->st_size;
+  fno->fdate = ((t->tm_year-80)<<9) | ((t->tm_mon+1)<<5) | t->tm_mday;
+  fno->ftime = (t->tm_hour<<11) | (t->tm_min<<5) | (t->tm_sec>>1);
+  fno->fattrib = S_ISDIR(st->st_mode) ? AM_DIR : 0;
+  snprintf(fno->fname, sizeof(fno->fname), "%s", name);
+  // the short name, none for names which are not 8.3
+  const char * ext = strrchr(name, '.');
+  size_t len = strlen(name);
+  if ( (len <= 12) && ( (ext ? (size_t)(ext-name) : len) <= 8 ) && ( (ext == NULL) || (strlen(ext) <= 4) ) ) {
+    snprintf(fno->altname, sizeof(fno->altname), "%s", name);
+  }
+  else {
+    fno->altname[0] = 0;
+  }
+}
+
+
+FRESULT f_mount(FATFS * fs, const TCHAR * path, BYTE opt)
+{
+  if (fs) {
+    memset(fs, 0, sizeof(FATFS));
+    fs->fs_type = FS_EXFAT;
+    fs->csize = HOST_CSIZE;
+  }
+  volume = fs;
+  return FR_OK;
+}
+
+FRESULT f_open(FIL * fp, const TCHAR * path, BYTE mode)
+{
+  struct stat st;
+  const char * how = "rb";
+  if (fp == NULL) return FR_INVALID_OBJECT;
+  memset(fp, 0, sizeof(FIL));
+  if (volume == NULL) return FR_NOT_ENABLED;
+  int exists = !stat(path, &st);
+  if ( (exists) && (S_ISDIR(st.st_mode)) ) return FR_DENIED;
+  if (mode & FA_WRITE) {
+    if ( (exists) && (mode & FA_CREATE_NEW) ) return FR_EXIST;
+    if (mode & FA_CREATE_ALWAYS) how = "w+b";
+    else if (exists) how = "r+b";
+    else if (mode & (FA_CREATE_NEW | FA_OPEN_ALWAYS)) how = "w+b";
+    else return FR_NO_FILE;
+  }
+  else if (!exists) {
+    return FR_NO_FILE;
+  }
+  int slot = 0;
+  while ( (slot < HOST_FILES) && (files[slot] != NULL) ) slot++;
+  if (slot == HOST_FILES) return FR_TOO_MANY_OPEN_FILES;
+  FILE * f = fopen(path, how);
+  if (f == NULL) return FR_DENIED;
+  files[slot] = f;
+  fseeko(f, 0, SEEK_END);
+  fp->obj.fs = volume;
+  fp->obj.id = slot+1;
+  fp->obj.objsize = ftello(f);
+  fp->flag = mode;
+  if ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND) fp->fptr = fp->obj.objsize;
+  return FR_OK;
+}
+
+FRESULT f_close(FIL * fp)
+{
+  FILE * f = hostFile(fp);
+  if (f == NULL) return FR_INVALID_OBJECT;
+  int err = fclose(f);
+  files[fp->obj.id-1] = NULL;
+  fp->obj.fs = NULL;
+  return err ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_read(FIL * fp, void * buff, UINT btr, UINT * br)
+{
+  FILE * f = hostFile(fp);
+  *br = 0;
+  if (f == NULL) return FR_INVALID_OBJECT;
+  if (!(fp->flag & FA_READ)) return FR_DENIED;
+  if (fseeko(f, fp->fptr, SEEK_SET)) return FR_DISK_ERR;
+  *br = fread(buff, 1, btr, f);
+  fp->fptr += *br;
+  return ferror(f) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_write(FIL * fp, const void * buff, UINT btw, UINT * bw)
+{
+  FILE * f = hostFile(fp);
+  *bw = 0;
+  if (f == NULL) return FR_INVALID_OBJECT;
+  if (!(fp->flag & FA_WRITE)) return FR_DENIED;
+  if (fseeko(f, fp->fptr, SEEK_SET)) return FR_DISK_ERR;
+  *bw = fwrite(buff, 1, btw, f);
+  fp->fptr += *bw;
+  if (fp->fptr > fp->obj.objsize) fp->obj.objsize = fp->fptr;
+  return ferror(f) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_lseek(FIL * fp, FSIZE_t ofs)
+{
+  FILE * f = hostFile(fp);
+  if (f == NULL) return FR_INVALID_OBJECT;
+  if ( (fp->cltbl) && (ofs == CREATE_LINKMAP) ) return FR_OK;
+  if (ofs > fp->obj.objsize) {
+    if (!(fp->flag & FA_WRITE)) {
+      ofs = fp->obj.objsize;
+    }
+    else {
+      if ( (fflush(f)) || (ftruncate(fileno(f), ofs)) ) return FR_DENIED;
+      fp->obj.objsize = ofs;
+    }
+  }
+  fp->fptr = ofs;
+  return FR_OK;
+}
+
+FRESULT f_sync(FIL * fp)
+{
+  FILE * f = hostFile(fp);
+  if (f == NULL) return FR_INVALID_OBJECT;
+  return fflush(f) ? FR_DISK_ERR : FR_OK;
+}
+
+FRESULT f_stat(const TCHAR * path, FILINFO * fno)
+{
+  struct stat st;
+  if (volume == NULL) return FR_NOT_ENABLED;
+  if (stat(path, &st)) return FR_NO_FILE;
+  if (fno) {
+    const char * name = strrchr(path, '/');
+    hostInfo(name ? name+1 : path, &st, fno);
+  }
+  return FR_OK;
+}
+
+FRESULT f_unlink(const TCHAR * path)
+{
+  struct stat st;
+  if (volume == NULL) return FR_NOT_ENABLED;
+  if (stat(path, &st)) return FR_NO_FILE;
+  if (S_ISDIR(st.st_mode) ? rmdir(path) : unlink(path)) return FR_DENIED;
+  return FR_OK;
+}
+
+// as FatFs, an existing target is not replaced
+FRESULT f_rename(const TCHAR * path_old, const TCHAR * path_new)
+{
+  struct stat st;
+  if (volume == NULL) return FR_NOT_ENABLED;
+  if (stat(path_old, &st)) return FR_NO_FILE;
+  if (!stat(path_new, &st)) return FR_EXIST;
+  return rename(path_old, path_new) ? FR_DENIED : FR_OK;
+}
+
+FRESULT f_opendir(DIR * dp, const TCHAR * path)
+{
+  if (dp == NULL) return FR_INVALID_OBJECT;
+  memset(dp, 0, sizeof(DIR));
+  if (volume == NULL) return FR_NOT_ENABLED;
+  int slot = 0;
+  while ( (slot < HOST_DIRS) && (dirs[slot] != NULL) ) slot++;
+  if (slot == HOST_DIRS) return FR_TOO_MANY_OPEN_FILES;
+  if ( (dirs[slot] = opendir(hostPath(path))) == NULL ) return FR_NO_PATH;
+  dp->obj.fs = volume;
+  dp->obj.id = slot+1;
+  return FR_OK;
+}
+
+FRESULT f_closedir(DIR * dp)
+{
+  HOST_DIR * d = hostDir(dp);
+  if (d == NULL) return FR_INVALID_OBJECT;
+  closedir(d);
+  dirs[dp->obj.id-1] = NULL;
+  dp->obj.fs = NULL;
+  return FR_OK;
+}
+
+// entries in host order, an empty name at the end
+FRESULT f_readdir(DIR * dp, FILINFO * fno)
+{
+  HOST_DIR * d = hostDir(dp);
+  if (d == NULL) return FR_INVALID_OBJECT;
+  if (fno == NULL) {
+    rewinddir(d);
+    return FR_OK;
+  }
+  struct dirent * e;
+  struct stat st;
+  while ( (e = readdir(d)) != NULL ) {
+    if ( (!strcmp(e->d_name, ".")) || (!strcmp(e->d_name, "..")) ) continue;
+    if (fstatat(dirfd(d), e->d_name, &st, 0)) continue;
+    hostInfo(e->d_name, &st, fno);
+    return FR_OK;
+  }
+  fno->fname[0] = 0;
+  fno->altname[0] = 0;
+  return FR_OK;
+}
@@ -0,0 +1,69 @@
+/*
+  Host stand-in for flash/flash_t.c
+  The ROM is loaded into a memory buffer as large as the device PSRAM.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "flash_t.h"
+#include "emuapi.h"
+
+#ifndef HOST_FLASH_SIZE
+#define HOST_FLASH_SIZE (8*1024*1024)
+#endif
+
+unsigned char * flash_start = NULL;
+unsigned char * flash_end = NULL;
+
+static void flash_setup() {
+    if (flash_start == NULL) {
+        flash_start = (unsigned char *)calloc(HOST_FLASH_SIZE, 1);
+        flash_end = flash_start + HOST_FLASH_SIZE;
+    }
+}
+
+static int flash_load_common(const char * filename, bool do_bswap)
+{
+  flash_setup();
+  int size = 0;
+  emu_printf("flash_load...");
+  int f = emu_FileOpen(filename,"r+b");
+  if (f) {
+    int filesize = emu_FileSeek(f, 0, SEEK_END);
+    emu_FileSeek(f, 0, SEEK_SET);
+    size = emu_FileRead(flash_start, flash_end - flash_start, f);
+    emu_FileClose(f);
+    if (size != filesize) {
+      // read error or corrupt archive, nothing valid is loaded
+      emu_printf("flash_load failed.");
+      return 0;
+    }
+    if (do_bswap) {
+      for (int i=0; i<(size & ~1); i+=2) {
+        unsigned char k = flash_start[i];
+        flash_start[i] = flash_start[i+1];
+        flash_start[i+1] = k;
+      }
+    }
+    emu_printf("flash_load OK.");
+  }
+  return size;
+}
+
+int flash_load(const char * filename)
+{
+    return flash_load_common(filename, false);
+}
+
+int flash_load_bswap(const char * filename)
+{
+    return flash_load_common(filename, true);
+}
+
+int flash_verify(unsigned char * buf, int size)
+{
+  flash_setup();
+  return memcmp(flash_start, buf, size) ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+/*
+  Host (headless) runner
+  Runs the core of this build for a number of frames from a ROM path,
+  optionally dumps frames and audio, and reports emulated frames per second.
+  The main() of the core is renamed core_main() and runs unchanged, a frame
+  ends at emu_DrawVsync(), or at each main loop iteration (emu_DebounceLocalKeys())
+  for the cores that never call it.
+*/
+
+#include "pico.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/mman.h>
+
+extern "C" {
+  #include "emuapi.h"
+  #include "iopins.h"
+}
+#include "pico_dsp.h"
+#include "host.h"
+
+#define HOST_CLOCKS_BASE 0x40010000
+#define HOST_MAX_TIMERS 4
+
+extern PICO_DSP tft;
+extern int core_main(void);
+extern "C" void core_DrawVsync(void);
+
+HostOptions host_options = { NULL, 600, 60, NULL, 1, NULL, false, NULL, 0 };
+
+static struct repeating_timer * timers[HOST_MAX_TIMERS];
+static int64_t timers_due[HOST_MAX_TIMERS];
+static int nb_timers = 0;
+static int64_t emulated_us = 0;
+
+static void (*audio_callback)(short * stream, int len) = NULL;
+static FILE * audio_file = NULL;
+static uint32_t audio_samples = 0;
+static int audio_frac = 0;
+
+static int frame = 0;
+static uint64_t start_us = 0;
+// reports, stdout unless -q sends the emulator output to /dev/null
+static FILE * out = NULL;
+
+
+/********************************
+ * Pico SDK stand-ins
+********************************/
+uint64_t time_us_64(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+// inputs are pulled up, USER1 is held low during the frame of -k
+bool gpio_get(uint gpio)
+{
+  return !( (gpio == PIN_KEY_USER1) && (host_options.keyframe) && (frame == host_options.keyframe) );
+}
+
+// timers run on emulated time, from host_frame()
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void * user_data, struct repeating_timer * out)
+{
+  if (nb_timers == HOST_MAX_TIMERS) return false;
+  out->delay_us = delay_ms*1000;
+  out->callback = callback;
+  out->user_data = user_data;
+  timers_due[nb_timers] = emulated_us + out->delay_us;
+  timers[nb_timers++] = out;
+  return true;
+}
+
+
+/********************************
+ * Audio, pulled once per frame
+********************************/
+static void write32(FILE * f, uint32_t v)
+{
+  uint8_t b[4] = { (uint8_t)v, (uint8_t)(v>>8), (uint8_t)(v>>16), (uint8_t)(v>>24) };
+  fwrite(b, 1, 4, f);
+}
+
+static void write16(FILE * f, uint16_t v)
+{
+  uint8_t b[2] = { (uint8_t)v, (uint8_t)(v>>8) };
+  fwrite(b, 1, 2, f);
+}
+
+static void wav_header(FILE * f, uint32_t samples)
+{
+  fwrite("RIFF", 1, 4, f);
+  write32(f, 36 + samples*2);
+  fwrite("WAVEfmt ", 1, 8, f);
+  write32(f, 16);
+  write16(f, 1);            // PCM
+  write16(f, 1);            // mono
+  write32(f, SOUNDRATE);
+  write32(f, SOUNDRATE*2);
+  write16(f, 2);
+  write16(f, 16);
+  fwrite("data", 1, 4, f);
+  write32(f, samples*2);
+}
+
+void host_audio(void (*callback)(short * stream, int len))
+{
+  audio_callback = callback;
+}
+
+static void audio_step(void)
+{
+  static short buf[SOUNDRATE/10];
+  if (audio_callback == NULL) return;
+  audio_frac += SOUNDRATE;
+  int len = audio_frac / host_options.fps;
+  audio_frac -= len * host_options.fps;
+  memset(buf, 0, len*sizeof(short));
+  // mixing runs in the audio interrupt on the device
+  PROF_BEGIN(PROF_AUDIO);
+  audio_callback(buf, len);
+  PROF_END(PROF_AUDIO);
+  if (audio_file) {
+    for (int i=0; i<len; i++) write16(audio_file, buf[i]);
+    audio_samples += len;
+  }
+}
+
+
+/********************************
+ * Frames
+********************************/
+static void dump_frame(const uint8_t * fb, int width, int height, int stride)
+{
+  char name[256];
+  snprintf(name, sizeof(name), "%s/frame%05d.ppm", host_options.dumpdir, frame);
+  FILE * f = fopen(name, "wb");
+  if (f == NULL) return;
+  fprintf(f, "P6\n%d %d\n255\n", width, height);
+  for (int y=0; y<height; y++) {
+    const uint8_t * src = &fb[y*stride];
+    for (int x=0; x<width; x++) {
+      uint8_t pix = *src++;
+      // RGB332 as written by the VGA path
+      uint8_t rgb[3] = { (uint8_t)(pix & 0xe0), (uint8_t)((pix << 3) & 0xe0), (uint8_t)((pix << 6) & 0xc0) };
+      fwrite(rgb, 1, 3, f);
+    }
+  }
+  fclose(f);
+}
+
+// one record per run, zones in us per frame (only cores calling PROF_FRAME)
+static void report_profile(double secs, double fps)
+{
+  const EmuProfStats * s = emu_ProfStats();
+  unsigned int n = s->frames ? s->frames : 1;
+  unsigned int zones = 0;
+  bool json = !strcmp(host_options.profile, "json");
+  if (json) {
+    fprintf(out, "{\"core\": \"%s\", \"rom\": \"%s\", \"frames\": %d, \"time\": %.3f, \"fps\": %.2f, \"frame_max_us\": %u",
+      HOST_TARGET, host_options.rom, frame, secs, fps, s->frame_max_us);
+  }
+  else {
+    fprintf(out, "%s,%s,%d,%.3f,%.2f,%u", HOST_TARGET, host_options.rom, frame, secs, fps, s->frame_max_us);
+  }
+  for (int i=0; i<PROF_ZONES; i++) {
+    zones += s->zone_us[i];
+    if (json) fprintf(out, ", \"%s_us\": %u", emu_ProfZoneName(i), s->zone_us[i]/n);
+    else fprintf(out, ",%u", s->zone_us[i]/n);
+  }
+  unsigned int other = (s->frame_us > zones) ? (s->frame_us-zones)/n : 0;
+  if (json) fprintf(out, ", \"other_us\": %u}\n", other);
+  else fprintf(out, ",%u\n", other);
+}
+
+static void report(void)
+{
+  uint64_t elapsed = time_us_64() - start_us;
+  double secs = elapsed / 1000000.0;
+  double fps = secs > 0 ? (frame-1) / secs : 0;
+  if (host_options.profile) {
+    report_profile(secs, fps);
+  }
+  else {
+    fprintf(out, "frames: %d\ntime: %.3f s\nfps: %.2f\nrealtime: %.2fx\n",
+      frame, secs, fps, fps / host_options.fps);
+  }
+  if (audio_file) {
+    fseek(audio_file, 0, SEEK_SET);
+    wav_header(audio_file, audio_samples);
+    fclose(audio_file);
+    audio_file = NULL;
+  }
+}
+
+static void host_frame(void)
+{
+  int width, height;
+  int stride = tft.get_frame_buffer_size(&width, &height);
+  const uint8_t * fb = (const uint8_t *)tft.getLineBuffer(0);
+  // timing starts at the end of the first frame, once the core is loaded
+  if (frame++ == 0) start_us = time_us_64();
+  emulated_us += 1000000 / host_options.fps;
+  for (int i=0; i<nb_timers; i++) {
+    while (timers_due[i] <= emulated_us) {
+      timers[i]->callback(timers[i]);
+      timers_due[i] += timers[i]->delay_us;
+    }
+  }
+  audio_step();
+  if ( (host_options.dumpdir) && ((frame % host_options.dumpevery) == 0) ) {
+    dump_frame(fb, width, height, stride);
+  }
+  if (frame == host_options.stateframe) {
+    emu_StateSave(0);
+  }
+  if (frame >= host_options.frames) {
+    report();
+    exit(0);
+  }
+}
+
+void host_vsync(bool vsync)
+{
+  static bool vsync_seen = false;
+  static bool busy = false;
+  if (vsync) vsync_seen = true;
+  else if (vsync_seen) return;
+  // timer callbacks may poll the keys
+  if (busy) return;
+  busy = true;
+  host_frame();
+  busy = false;
+}
+
+void emu_DrawVsync(void)
+{
+  host_vsync(true);
+  core_DrawVsync();
+}
+
+
+static void usage(const char * name)
+{
+  printf("usage: %s [-n frames] [-r fps] [-d dumpdir] [-e every] [-a audio.wav] [-p csv|json] [-k frame] [-s frame] [-q] rom\n", name);
+  printf("  -n frames   number of frames to run (default 600)\n");
+  printf("  -r fps      emulated refresh rate (default 60)\n");
+  printf("  -d dumpdir  write frames as PPM into dumpdir\n");
+  printf("  -e every    only dump 1 frame out of every (default 1)\n");
+  printf("  -a file     write audio as a WAV file\n");
+  printf("  -p format   print time per subsystem as a csv line or json object\n");
+  printf("  -k frame    press USER1 once at frame (e.g. autoload)\n");
+  printf("  -s frame    save the state in slot 0 at frame (resumed by the next run)\n");
+  printf("  -q          no emulator output\n");
+}
+
+int main(int argc, char * argv[])
+{
+  for (int i=1; i<argc; i++) {
+    if ( (!strcmp(argv[i], "-n")) && (i+1 < argc) ) host_options.frames = atoi(argv[++i]);
+    else if ( (!strcmp(argv[i], "-r")) && (i+1 < argc) ) host_options.fps = atoi(argv[++i]);
+    else if ( (!strcmp(argv[i], "-d")) && (i+1 < argc) ) host_options.dumpdir = argv[++i];
+    else if ( (!strcmp(argv[i], "-e")) && (i+1 < argc) ) host_options.dumpevery = atoi(argv[++i]);
+    else if ( (!strcmp(argv[i], "-a")) && (i+1 < argc) ) host_options.audio = argv[++i];
+    else if ( (!strcmp(argv[i], "-p")) && (i+1 < argc) ) host_options.profile = argv[++i];
+    else if ( (!strcmp(argv[i], "-k")) && (i+1 < argc) ) host_options.keyframe = atoi(argv[++i]);
+    else if ( (!strcmp(argv[i], "-s")) && (i+1 < argc) ) host_options.stateframe = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-q")) host_options.quiet = true;
+    else if (argv[i][0] == '-') { usage(argv[0]); return 1; }
+    else host_options.rom = argv[i];
+  }
+  if ( (host_options.rom == NULL) || (host_options.frames <= 0) || (host_options.fps <= 0) || (host_options.dumpevery <= 0) ||
+       ( (host_options.profile) && (strcmp(host_options.profile, "csv")) && (strcmp(host_options.profile, "json")) ) ) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (host_options.audio) {
+    if ( (audio_file = fopen(host_options.audio, "wb")) == NULL ) {
+      printf("cannot create %s\n", host_options.audio);
+      return 1;
+    }
+    wav_header(audio_file, 0);
+  }
+
+  out = stdout;
+  if (host_options.quiet) {
+    fflush(stdout);
+    out = fdopen(dup(fileno(stdout)), "w");
+    if ( (out == NULL) || (freopen("/dev/null", "w", stdout) == NULL) ) {
+      printf("cannot redirect the output\n");
+      return 1;
+    }
+  }
+
+  // some C cores call emu_Malloc without prototype (int result): no mmap
+  // blocks, the heap of this non PIE executable stays below 4GB
+  mallopt(M_MMAP_MAX, 0);
+
+  // some cores set the HSTX clock divider through its register directly
+  mmap((void *)HOST_CLOCKS_BASE, 4096, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED_NOREPLACE, -1, 0);
+
+  return core_main();
+}
@@ -0,0 +1,113 @@
+/*
+  Host stand-in for the Pico SDK, only what the cores and the display layer
+  use outside of the hardware drivers (which are not part of the host build)
+*/
+
+#ifndef _HOST_PICO_H_
+#define _HOST_PICO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+
+#define __not_in_flash(...)
+#define __not_in_flash_func(func) func
+#define __no_inline_not_in_flash_func(func) func
+#define __time_critical_func(func) func
+#define __in_flash(...)
+#ifndef __aligned
+#define __aligned(x) __attribute__((__aligned__(x)))
+#endif
+#define __scratch_x(group)
+#define __scratch_y(group)
+#define __uninitialized_ram(var) var
+#ifndef __always_inline
+#define __always_inline inline __attribute__((__always_inline__))
+#endif
+#ifndef __force_inline
+#define __force_inline __always_inline
+#endif
+
+#define XIP_BASE 0x10000000
+
+static inline void __dmb(void) { __sync_synchronize(); }
+static inline void __dsb(void) { __sync_synchronize(); }
+static inline void __isb(void) { }
+static inline void __wfe(void) { }
+static inline void __sev(void) { }
+// spin loops waiting for the other "core" let its thread run
+static inline void tight_loop_contents(void) { sched_yield(); }
+// "core 1" is a thread of the host runner, see PICO_DSP::begin_core1
+extern __thread unsigned int host_core_num;
+static inline uint get_core_num(void) { return host_core_num; }
+static inline int32_t __mul_instruction(int32_t a, int32_t b) { return a*b; }
+#define __fast_mul(a,b) ((a)*(b))
+
+#define panic(...) { fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); exit(1); }
+
+typedef uint64_t absolute_time_t;
+extern uint64_t time_us_64(void);
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t/1000); }
+// emulated time does not depend on wall clock on the host
+static inline void sleep_ms(uint32_t ms) { }
+static inline void sleep_us(uint64_t us) { }
+static inline void busy_wait_us(uint64_t us) { }
+static inline void busy_wait_at_least_cycles(uint32_t n) { }
+
+static inline bool stdio_init_all(void) { return true; }
+static inline bool set_sys_clock_khz(uint32_t khz, bool required) { return true; }
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { }
+
+#define GPIO_OUT 1
+#define GPIO_IN  0
+static inline void gpio_init(uint gpio) { }
+static inline void gpio_set_dir(uint gpio, bool out) { }
+static inline void gpio_put(uint gpio, bool value) { }
+// inputs are pulled up, see host_main.cpp for the scripted key
+extern bool gpio_get(uint gpio);
+static inline void gpio_pull_up(uint gpio) { }
+static inline void gpio_set_pulls(uint gpio, bool up, bool down) { }
+static inline void gpio_disable_pulls(uint gpio) { }
+
+// no analog joystick, centered
+static inline void adc_init(void) { }
+static inline void adc_gpio_init(uint gpio) { }
+static inline void adc_select_input(uint input) { }
+static inline uint16_t adc_read(void) { return 2048; }
+static inline void pwm_set_gpio_level(uint gpio, uint16_t level) { }
+
+#define VREG_VOLTAGE_1_05 0
+#define VREG_VOLTAGE_1_10 0
+#define VREG_VOLTAGE_1_15 0
+#define VREG_VOLTAGE_1_20 0
+#define VREG_VOLTAGE_1_25 0
+#define VREG_VOLTAGE_1_30 0
+static inline void vreg_set_voltage(int voltage) { }
+
+// Called once per emulated frame by the host display, see host_main.cpp
+struct repeating_timer;
+typedef bool (*repeating_timer_callback_t)(struct repeating_timer *rt);
+struct repeating_timer {
+  int32_t delay_us;
+  repeating_timer_callback_t callback;
+  void * user_data;
+};
+extern bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void * user_data, struct repeating_timer * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
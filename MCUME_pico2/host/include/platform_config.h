@@ -0,0 +1,25 @@
+#ifndef _PLATFORM_CONFIG_H_
+#define _PLATFORM_CONFIG_H_
+
+// Host build: memory framebuffer (VGA path) and pulled audio, no SD/TFT.
+// HAS_USBPIO as on the device, the cores then do not wait for vsync.
+#define HOST_BUILD     1
+#define PICOHYPERPET   1
+#define INVX           1
+#define HAS_SND        1
+#define USE_VGA        1
+#define HAS_USBPIO     1
+
+#ifdef HAS_SND
+
+#define SOUNDRATE 22050                           // sound rate [Hz]
+
+#define AUDIO_1DMA      1
+
+typedef short  audio_sample;
+
+#endif
+
+#include "program_config.h"
+
+#endif
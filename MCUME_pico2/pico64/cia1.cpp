@@ -51,6 +51,7 @@ void cia1_setAlarmTime() {
 
 void cia1_write(uint32_t address, uint8_t value) {
 
+	cia_sync();
 	address &= 0x0F;
 
 	switch (address) {
@@ -168,6 +169,9 @@ void cia1_write(uint32_t address, uint8_t value) {
 		default   : {cpu.cia1.R[address] = value;/*if (address ==0) {Serial.print(value);Serial.print(" ");}*/ } break;
 	}
 
+	// timers may have been started, stopped or reloaded
+	cia_schedule();
+
 #if DEBUGCIA1
 	if (cpu.pc < 0xa000) Serial.printf("%x CIA1: W %x %x\n", cpu.pc, address, value);
 #endif
@@ -176,6 +180,7 @@ void cia1_write(uint32_t address, uint8_t value) {
 uint8_t cia1_read(uint32_t address) {
 uint8_t ret;
 
+	cia_sync();
 	address &= 0x0F;
 
 	switch (address) {
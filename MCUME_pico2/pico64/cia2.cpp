@@ -50,6 +50,7 @@ void cia2_setAlarmTime() {
 
 void cia2_write(uint32_t address, uint8_t value) {
 
+  cia_sync();
   address &= 0x0F;
 
   switch (address) {
@@ -215,6 +216,9 @@ void cia2_write(uint32_t address, uint8_t value) {
 	  break;
   }
 
+  // timers may have been started, stopped or reloaded
+  cia_schedule();
+
 #if DEBUGCIA2
   Serial.printf("%x CIA2: W %x %x\n", cpu.pc, address, value);
 #endif
@@ -223,6 +227,7 @@ void cia2_write(uint32_t address, uint8_t value) {
 uint8_t cia2_read(uint32_t address) {
   uint8_t ret;
 
+  cia_sync();
   address &= 0x0F;
 
   switch (address) {
@@ -2635,13 +2635,48 @@ static inline void cpu_irq() {
 inline void cia_clock(void)  __attribute__((always_inline));
 
 void cia_clock(void) {
-	cia1_clock(1);
-	cia2_clock(1);
+	cia_clockt(1);
+}
+
+// CIA timers are clocked lazily: cycles accumulate in ciaPending and are only
+// handed to cia1_clock/cia2_clock when the next timer underflow is reached,
+// or before a CIA register access (cia_sync)
+int32_t ciaPending = 0;
+int32_t ciaDeadline = 0;
+uint32_t ciaTime = 0;
+
+static int32_t cia_nextUnderflow(struct tcia * cia) {
+	int32_t next = INT32_MAX;
+	uint8_t cra = cia->R[0x0E];
+	uint8_t crb = cia->R[0x0F];
+	// an underflow happens when more cycles than the counter value elapse
+	if ((cra & 0x21) == 0x01) next = cia->R16[0x04/2] + 1;
+	// timer B counting timer A underflows follows the timer A deadline
+	if ((crb & 0x01) && ((crb & 0x60) != 0x40)) {
+		int32_t b = cia->R16[0x06/2] + 1;
+		if (b < next) next = b;
+	}
+	return next;
 }
 
-void cia_clockt(int ticks) {
-	cia1_clock(ticks);
-	cia2_clock(ticks);
+// longest run of cycles kept pending, bounds ciaPending when no timer runs
+#define CIA_SYNC_MAX 0x10000
+
+void cia_schedule(void) {
+	int32_t next1 = cia_nextUnderflow(&cpu.cia1);
+	int32_t next2 = cia_nextUnderflow(&cpu.cia2);
+	ciaDeadline = (next1 < next2) ? next1 : next2;
+	if (ciaDeadline > CIA_SYNC_MAX) ciaDeadline = CIA_SYNC_MAX;
+}
+
+void cia_sync(void) {
+	if (ciaPending) {
+		cia1_clock(ciaPending);
+		cia2_clock(ciaPending);
+		ciaTime += ciaPending;
+		ciaPending = 0;
+	}
+	cia_schedule();
 }
 
 void cpu_clock(int cycles) {
@@ -119,7 +119,21 @@ void cpu_clock(int cycles);
 void cpu_setExactTiming();
 void cpu_disableExactTiming();
 
-void cia_clockt(int ticks);
+extern int32_t ciaPending;
+extern int32_t ciaDeadline;
+extern uint32_t ciaTime;
+void cia_sync(void);
+void cia_schedule(void);
+
+static inline void cia_clockt(int ticks) {
+	ciaPending += ticks;
+	if (ciaPending >= ciaDeadline) cia_sync();
+}
+
+// every emulated cycle goes through cia_clockt, CPU or stolen by the VIC
+static inline uint32_t cpu_time(void) {
+	return ciaTime + ciaPending;
+}
 
 #define CORE_PIN0_PORT	io.gpiob
 #define CORE_PIN1_PORT	io.gpiob
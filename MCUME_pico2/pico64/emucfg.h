@@ -6,6 +6,8 @@
 #define TFT_VBUFFER_YCROP    0
 #define SINGLELINE_RENDERING 1
 #define CUSTOM_SND           1
+// SID writes are timestamped and replayed by the audio side (reSID.h)
+#define SID_QUEUE            1
 //#define TIMER_REND           1
 #define EXTRA_HEAP           0x10
 #define FILEBROWSER
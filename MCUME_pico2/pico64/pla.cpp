@@ -77,7 +77,9 @@ void w_ramz( uint32_t address, uint8_t value )	{
 	} 
 void w_vic( uint32_t address, uint8_t value )	{ vic_write(address, value); }
 void w_col( uint32_t address, uint8_t value )	{ cpu.vic.COLORRAM[address & 0x3FF] = value & 0x0F;}
-#ifdef HAS_SND      
+#if defined(HAS_SND) && defined(SID_QUEUE)
+void w_sid( uint32_t address, uint8_t value )	{ playSID.setreg(address & 0x1F, value, cpu_time()); }
+#elif defined(HAS_SND)
 void w_sid( uint32_t address, uint8_t value )	{ playSID.setreg(address & 0x1F, value); }
 #else
 void w_sid( uint32_t address, uint8_t value )	{ }
@@ -26,6 +26,9 @@
  */
 #include "reSID.h"
 #include <math.h>
+#ifdef SID_QUEUE
+#include "hardware/sync.h"
+#endif
 
 #define CLOCKFREQ 985248
 
@@ -33,8 +36,11 @@ void AudioPlaySID::begin(float samplerate, int blocksize)
 {
 	sidptr = &sid;
 	this->reset();
-	sid.set_sampling_parameters(CLOCKFREQ, SAMPLE_FAST, samplerate); 
+	sid.set_sampling_parameters(CLOCKFREQ, SID_SAMPLING, samplerate); 
 	csdelta = round((float)CLOCKFREQ / ((float)samplerate / blocksize));
+#ifdef SID_QUEUE
+	cyclesPerSample = (float)CLOCKFREQ / samplerate;
+#endif
 	playing = true;
 }
 
@@ -42,8 +48,32 @@ void AudioPlaySID::begin(float samplerate, int blocksize)
 void AudioPlaySID::reset(void)
 {
 	sid.reset();
+#ifdef SID_QUEUE
+	head = tail = 0;
+	drops = 0;
+	sidclk = 0;
+	aligned = false;
+#endif
 }
 
+#ifdef SID_QUEUE
+void AudioPlaySID::setreg(int ofs, int val, uint32_t time)
+{
+	uint32_t h = head;
+	if ((h - tail) >= SID_QUEUE_SIZE) {
+		// audio side stalled
+		drops++;
+		return;
+	}
+	SIDWrite & w = queue[h & (SID_QUEUE_SIZE-1)];
+	w.time = time;
+	w.reg = ofs;
+	w.val = val;
+	__dmb();
+	head = h + 1;
+}
+#endif
+
 void AudioPlaySID::stop(void)
 {
 	playing = false;	
@@ -53,6 +83,37 @@ void AudioPlaySID::update(float samplerate, void * stream, int len) {
 	// only update if we're playing
 	if (!playing) return;
 
+#ifdef SID_QUEUE
+	short int * buf = (short int *)stream;
+	while (len > 0) {
+		// enough cycles for the rest of the buffer
+		cycle_count delta_t = (cycle_count)(len * cyclesPerSample) + 1;
+		if (tail != head) {
+			__dmb();
+			SIDWrite & w = queue[tail & (SID_QUEUE_SIZE-1)];
+			int32_t due = (int32_t)(w.time + offset - sidclk);
+			if ( (!aligned) || (due < -SID_QUEUE_SLACK) || (due > SID_QUEUE_SLACK) ) {
+				// play the writes one buffer late, with their original spacing
+				offset = sidclk + (int32_t)(len * cyclesPerSample) - w.time;
+				due = (int32_t)(w.time + offset - sidclk);
+				aligned = true;
+			}
+			if (due <= 0) {
+				sid.write(w.reg, w.val);
+				__dmb();
+				tail++;
+				continue;
+			}
+			if (due < delta_t) delta_t = due;
+		}
+		cycle_count cycles = delta_t;
+		int n = sidptr->clock(delta_t, buf, len);
+		sidclk += cycles - delta_t;
+		buf += n;
+		len -= n;
+	}
+#else
 	cycle_count delta_t = csdelta;
 	sidptr->clock(delta_t, (short int*)stream, len);
+#endif
 }
@@ -26,17 +26,45 @@
  */
 #include "reSID/sid.h"
 #include <stdint.h>
+#include "emucfg.h"
 
 #ifndef play_sid_h_
 #define play_sid_h_
 
+#ifdef SID_QUEUE
+// Register writes of the emulation core are queued with their cycle time and
+// applied by update() (audio side, core 1 on the device) at the same distance
+// in SID cycles, so both cores never touch the SID state at the same time.
+#define SID_QUEUE_SIZE 1024 // power of 2
+// emulation and audio more than this apart (cycles) realigns the timestamps
+#define SID_QUEUE_SLACK 20000
+#ifndef SID_SAMPLING
+#define SID_SAMPLING SAMPLE_INTERPOLATE
+#endif
+
+struct SIDWrite {
+	uint32_t time;
+	uint8_t reg;
+	uint8_t val;
+};
+#else
+#ifndef SID_SAMPLING
+#define SID_SAMPLING SAMPLE_FAST
+#endif
+#endif
+
 
 class AudioPlaySID
 {
 public:
 	AudioPlaySID(void) {  }
 	void begin(float samplerate, int blocksize);
+#ifdef SID_QUEUE
+	void setreg(int ofs, int val, uint32_t time);
+	inline uint32_t dropped(void) { return drops; }
+#else
 	inline void setreg(int ofs, int val) { sid.write(ofs, val); }
+#endif
 	inline uint8_t getreg(int ofs) { return sid.read(ofs); }
 	void reset(void);
 	void stop(void);
@@ -47,6 +75,16 @@ private:
 	volatile bool playing;
 	SID sid;
 	SID* sidptr;
+#ifdef SID_QUEUE
+	SIDWrite queue[SID_QUEUE_SIZE];
+	volatile uint32_t head;   // written by the emulation
+	volatile uint32_t tail;   // written by update()
+	uint32_t drops;
+	uint32_t sidclk;          // SID cycles rendered by update()
+	int32_t offset;           // sidclk = write time + offset
+	bool aligned;
+	float cyclesPerSample;
+#endif
 };
 
 
@@ -804,6 +804,10 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n,
 {
   int s = 0;
   int i;
+#ifdef AUDIO_8BIT
+  // same output format as clock_fast
+  unsigned char * buf8 = (unsigned char *)buf;
+#endif
 
   for (;;) {
     cycle_count next_sample_offset = sample_offset + cycles_per_sample;
@@ -826,8 +830,13 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n,
     sample_offset = next_sample_offset & FIXP_MASK;
 
     short sample_now = output();
+#ifdef AUDIO_8BIT
+    buf8[s++] =
+      sample_prev + (sample_offset*(sample_now - sample_prev) >> FIXP_SHIFT) + 128;
+#else
     buf[s++*interleave] =
-      sample_prev + (sample_offset*(sample_now - sample_prev) >> FIXP_SHIFT);
+      sample_prev + (sample_offset*(sample_now - sample_prev) >> FIXP_SHIFT) + 128;
+#endif
     sample_prev = sample_now;
   }
 
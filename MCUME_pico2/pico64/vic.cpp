@@ -98,8 +98,7 @@ void fastFillLineNoSprites(tpixel * p, const tpixel * pe, const uint16_t col);
 #define BADLINE(x) {if (cpu.vic.badline) { \
       cpu.vic.lineMemChr[x] = cpu.RAM[cpu.vic.videomatrix + vc + x]; \
 	  cpu.vic.lineMemCol[x] = cpu.vic.COLORRAM[vc + x]; \
-	  cia1_clock(1); \
-	  cia2_clock(1); \
+	  cia_clockt(1); \
     } else { \
       cpu_clock(1); \
     } \
@@ -179,17 +179,14 @@ void INPUT_Scanline(void)
 static void load_CART(char * cartname) 
 {
   int flen = emu_FileSize(cartname);
-  int f=emu_FileOpen(cartname, "r+b");
   if (flen < 16384) {
     emu_printf("8k");
-    for(int i=0; i<flen; i++) memory[0xA000 + i] = emu_FileGetc(f);    
+    emu_FileLoad(cartname, 0, &memory[0xA000], 0x2000);
   }
   else {
     emu_printf("16k");    
-    for(int i=0; i<flen; i++) memory[0x8000 + i] = emu_FileGetc(f);
+    emu_FileLoad(cartname, 0, &memory[0x8000], 0x4000);
   }
-
-  emu_FileClose(f); 
 }
 
   
@@ -81,6 +81,7 @@ void emu_SetPaletteEntry(unsigned char r, unsigned char g, unsigned char b, int
 {
     if (index<PALETTE_SIZE) {
         palette16[index]  = RGBVAL16(r,g,b);        
+        tft.invalidatePalette(index);
     }
 }
 
@@ -100,6 +101,7 @@ void emu_DrawLine16(unsigned short * VBuf, int width, int height, int line)
 
 void emu_DrawVsync(void)
 {
+    PROF_FRAME();
     skip += 1;
     skip &= VID_FRAME_SKIP;
 #ifdef HAS_USBPIO
@@ -63,69 +63,169 @@ extern "C" void  write_ram(int address, unsigned char val);
 
 extern uint8_t * LORAM;
 
-void write86(uint32_t addr32, uint8_t value) {
-  if (addr32 < NATIVE_RAM) {
-    LORAM[addr32] = value;
-    return;
-  } 
-  else if (addr32 < RAM_SIZE) {
-    write_ram(addr32, value);
-    return;
-  } 
-  else if ((addr32 >= 0xB8000) && (addr32 < 0xC0000)) {
-    VRAM_write(addr32 - 0xB8000UL, value);
-  }
+extern "C" unsigned short read_ram_w(int address);
+extern "C" void  write_ram_w(int address, unsigned short val);
+
+extern uint8_t VRAM[16384];
+
+// 4KB page table over the 1MB address space (addresses above wrap like a real 8086).
+// Pages with a direct pointer are accessed inline, the others go through handlers.
+#define MEMPAGE_SHIFT 12
+#define MEMPAGE_SIZE  (1UL<<MEMPAGE_SHIFT)
+#define MEMPAGE_MASK  (MEMPAGE_SIZE-1)
+#define MEMPAGE_COUNT (0x100000UL>>MEMPAGE_SHIFT)
+#define MEMPAGE(addr32) (((addr32)>>MEMPAGE_SHIFT)&(MEMPAGE_COUNT-1))
+
+typedef uint8_t (*memread_t)(uint32_t addr32);
+typedef void (*memwrite_t)(uint32_t addr32, uint8_t value);
+typedef uint16_t (*memreadw_t)(uint32_t addr32);
+typedef void (*memwritew_t)(uint32_t addr32, uint16_t value);
+
+struct mempage_s {
+  const uint8_t * rdptr; // page base for direct reads or NULL
+  uint8_t * wrptr;       // page base for direct writes or NULL
+  memread_t rd;
+  memwrite_t wr;
+  memreadw_t rdw;        // optional word handlers, used when access stays in the page
+  memwritew_t wrw;
+};
+
+static struct mempage_s memmap[MEMPAGE_COUNT];
+
+static uint8_t mem_read_none(uint32_t addr32) {
+  return 0;
 }
 
-#define writew86(addr32,value) {write86((addr32),(uint8_t)(value));write86((addr32)+1,(uint8_t)((uint16_t)(value)>>8));}
+static void mem_write_none(uint32_t addr32, uint8_t value) {
+}
 
-uint8_t read86(uint32_t addr32) {
-  if (addr32 < NATIVE_RAM) {
-    switch (addr32) { //some hardcoded values for the BIOS data area
-      case 0x410: //0040:0010 is the equipment word
+static uint8_t mem_read_bda(uint32_t addr32) {
+  switch (addr32 & 0xFFFFF) { //some hardcoded values for the BIOS data area
+    case 0x410: //0040:0010 is the equipment word
 #ifdef VGA
-        return (0x41); //video type (0x41 is VGA/EGA, 0x61 is CGA, 0x31 = MDA)
+      return (0x41); //video type (0x41 is VGA/EGA, 0x61 is CGA, 0x31 = MDA)
 #else
-        return (0x61); //video type (0x41 is VGA/EGA, 0x61 is CGA, 0x31 = MDA)
+      return (0x61); //video type (0x41 is VGA/EGA, 0x61 is CGA, 0x31 = MDA)
 #endif
-      case 0x475: //hard drive count
-        return (hdcount);
-      default:
-        return LORAM[addr32];
-    }    
-  } 
-  else if (addr32 < RAM_SIZE) {
-    return read_ram(addr32);
-  } 
-  else if ((addr32 >= 0xB8000) && (addr32 < 0xC0000)) {
-    addr32 -= 0xB8000UL;
-    return VRAM_read(addr32);
+    case 0x475: //hard drive count
+      return (hdcount);
+    default:
+      return LORAM[addr32 & MEMPAGE_MASK];
   }
-  else if (addr32 >= 0xFE000UL) {
-    addr32 -= 0xFE000UL;
-    return ROM_READ(BIOS, addr32); //BIOS[addr32];
+}
+
+static uint8_t mem_read_psram(uint32_t addr32) {
+  return read_ram(addr32 & 0xFFFFF);
+}
+
+static void mem_write_psram(uint32_t addr32, uint8_t value) {
+  write_ram(addr32 & 0xFFFFF, value);
+}
+
+static uint16_t mem_readw_psram(uint32_t addr32) {
+  return read_ram_w(addr32 & 0xFFFFF);
+}
+
+static void mem_writew_psram(uint32_t addr32, uint16_t value) {
+  write_ram_w(addr32 & 0xFFFFF, value);
+}
+
+static uint8_t mem_read_net(uint32_t addr32) {
+  addr32 &= MEMPAGE_MASK;
+  if (addr32 < 0x640) return net_read_ram(addr32);
+  return 0;
+}
+
+static uint8_t mem_read_mac(uint32_t addr32) {
+  addr32 &= MEMPAGE_MASK;
+  if (addr32 < 6) return net_mac[addr32];
+  return 0;
+}
+
+static void map_handler(uint32_t start, uint32_t end, memread_t rd, memwrite_t wr) {
+  for (uint32_t a = start; a < end; a += MEMPAGE_SIZE) {
+    struct mempage_s * p = &memmap[MEMPAGE(a)];
+    p->rdptr = NULL;
+    p->wrptr = NULL;
+    p->rd = rd;
+    p->wr = wr;
+    p->rdw = NULL;
+    p->wrw = NULL;
   }
-  else if ((addr32 >= 0xD0000) && (addr32 < 0xD0640)) {
-    return net_read_ram(addr32 - 0xD0000);
+}
+
+static void map_direct(uint32_t start, uint32_t end, const uint8_t * rdbase, uint8_t * wrbase) {
+  for (uint32_t a = start; a < end; a += MEMPAGE_SIZE) {
+    struct mempage_s * p = &memmap[MEMPAGE(a)];
+    p->rdptr = rdbase + (a - start);
+    p->wrptr = (wrbase != NULL) ? wrbase + (a - start) : NULL;
+    p->rd = mem_read_none;
+    p->wr = mem_write_none;
+    p->rdw = NULL;
+    p->wrw = NULL;
   }
-  else if ((addr32 >= 0xE0000) && (addr32 < 0xE0006)) {
-    return net_mac[addr32 - 0xE0000];
+}
+
+void setup_memory() {
+  map_handler(0, 0x100000UL, mem_read_none, mem_write_none);
+  map_direct(0, NATIVE_RAM, LORAM, LORAM);
+  // BIOS data area special cases are trapped in page 0 only
+  memmap[0].rdptr = NULL;
+  memmap[0].rd = mem_read_bda;
+  map_handler(NATIVE_RAM, RAM_SIZE, mem_read_psram, mem_write_psram);
+  for (uint32_t a = NATIVE_RAM; a < RAM_SIZE; a += MEMPAGE_SIZE) {
+    memmap[MEMPAGE(a)].rdw = mem_readw_psram;
+    memmap[MEMPAGE(a)].wrw = mem_writew_psram;
   }
+  map_direct(0xB8000UL, 0xB8000UL + sizeof(VRAM), VRAM, VRAM);
+  map_handler(0xD0000UL, 0xD1000UL, mem_read_net, mem_write_none);
+  map_handler(0xE0000UL, 0xE1000UL, mem_read_mac, mem_write_none);
 #ifdef INCLUDE_ROM_BASIC
-  else if ((addr32 >= 0xF6000UL) && (addr32 < 0xFA000UL)) {
-    addr32 -= 0xF6000UL;
-    return ROM_READ(BASICL, addr32); //BASICL[addr32];
-  } else if ((addr32 >= 0xFA000UL) && (addr32 < 0xFE000UL)) {
-    addr32 -= 0xFA000UL;
-    return ROM_READ(BASICH, addr32); //BASICH[addr32];
-  }
+  map_direct(0xF6000UL, 0xFA000UL, BASICL, NULL);
+  map_direct(0xFA000UL, 0xFE000UL, BASICH, NULL);
 #endif
-  else return 0;
+  map_direct(0xFE000UL, 0x100000UL, BIOS, NULL);
 }
 
+void write86(uint32_t addr32, uint8_t value) {
+  struct mempage_s * p = &memmap[MEMPAGE(addr32)];
+  if (p->wrptr != NULL) p->wrptr[addr32 & MEMPAGE_MASK] = value;
+  else p->wr(addr32, value);
+}
+
+uint8_t read86(uint32_t addr32) {
+  struct mempage_s * p = &memmap[MEMPAGE(addr32)];
+  if (p->rdptr != NULL) return p->rdptr[addr32 & MEMPAGE_MASK];
+  return p->rd(addr32);
+}
 
+static inline uint16_t readw86(uint32_t addr32) {
+  uint32_t offs = addr32 & MEMPAGE_MASK;
+  if (offs != MEMPAGE_MASK) {
+    struct mempage_s * p = &memmap[MEMPAGE(addr32)];
+    if (p->rdptr != NULL) return (uint16_t)p->rdptr[offs] | ((uint16_t)p->rdptr[offs + 1] << 8);
+    if (p->rdw != NULL) return p->rdw(addr32);
+  }
+  return (uint16_t)read86(addr32) | ((uint16_t)read86(addr32 + 1) << 8);
+}
 
-#define readw86(addr32) ((uint16_t)read86((addr32))|((uint16_t)read86((addr32)+1)<<8))
+static inline void writew86(uint32_t addr32, uint16_t value) {
+  uint32_t offs = addr32 & MEMPAGE_MASK;
+  if (offs != MEMPAGE_MASK) {
+    struct mempage_s * p = &memmap[MEMPAGE(addr32)];
+    if (p->wrptr != NULL) {
+      p->wrptr[offs] = (uint8_t)value;
+      p->wrptr[offs + 1] = (uint8_t)(value >> 8);
+      return;
+    }
+    if (p->wrw != NULL) {
+      p->wrw(addr32, value);
+      return;
+    }
+  }
+  write86(addr32, (uint8_t)value);
+  write86(addr32 + 1, (uint8_t)(value >> 8));
+}
 
 //inline void flag_szp8(uint8_t value) {
 #define flag_szp8(value) {\
@@ -400,6 +500,8 @@ void reset86() {
   segregs[regss] = 0x0000;
   regs.wordregs[regsp] = 0xFFFE;
 
+  setup_memory();
+
   //generate parity lookup table
   for (i = 0; i < 256; i++) {
     bitcount = 0;
@@ -412,13 +514,13 @@ void reset86() {
 /*inline uint16_t readrm16(uint8_t rmval) {
   if (mode < 3) {
     getea(rmval);
-    return (read86(ea) | ((uint16_t)read86(ea + 1) << 8));
+    return (readw86(ea));
   } else {
     return (getreg16(rmval));
   }
 }*/
 
-#define readrm16(rmval) ( (mode < 3) ? (read86(ea) | ((uint16_t)read86(ea + 1) << 8)) : (getreg16(rmval)) )
+#define readrm16(rmval) ( (mode < 3) ? readw86(ea) : (getreg16(rmval)) )
 
 /*inline uint8_t readrm8(uint8_t rmval) {
   if (mode < 3) {
@@ -435,8 +537,7 @@ inline void writerm16(uint8_t rmval, uint16_t value) {
 //#define writerm16(rmval, value) {
   if (mode < 3) {\
     /*getea(rmval);*/\
-    write86(ea, value & 0xFF);\
-    write86(ea + 1, value >> 8);\
+    writew86(ea, value);\
   } else {\
     putreg16(rmval, value);\
   }\
@@ -795,14 +896,14 @@ inline void op_grp3_16() {
     case 3: /*CALL Mp*/\
       push(segregs[regcs]); push(ip);\
       /*getea(rm);*/\
-      ip = (uint16_t)read86(ea) + ((uint16_t)read86(ea + 1) << 8);\
-      segregs[regcs] = (uint16_t)read86(ea + 2) + ((uint16_t)read86(ea + 3) << 8); break;\
+      ip = readw86(ea);\
+      segregs[regcs] = readw86(ea + 2); break;\
     case 4: /*JMP Ev*/\
       ip = oper1; break;\
     case 5: /*JMP Mp*/\
       /*getea(rm);*/\
-      ip = (uint16_t)read86(ea) + ((uint16_t)read86(ea + 1) << 8);\
-      segregs[regcs] = (uint16_t)read86(ea + 2) + ((uint16_t)read86(ea + 3) << 8); break;\
+      ip = readw86(ea);\
+      segregs[regcs] = readw86(ea + 2); break;\
     case 6: /*PUSH Ev*/\
       push(oper1); break;\
   }\
@@ -1994,14 +2095,14 @@ void exec86(uint32_t execloops) {
       case 0xC4: //C4 LES Gv Mp
         modregrm();
         //getea(rm);
-        putreg16(reg, read86(ea) + ((uint16_t)read86(ea + 1) << 8));
-        segregs[reges] = read86(ea + 2) + ((uint16_t)read86(ea + 3) << 8);
+        putreg16(reg, readw86(ea));
+        segregs[reges] = readw86(ea + 2);
         break;
       case 0xC5: //C5 LDS Gv Mp
         modregrm();
         //getea(rm);
-        putreg16(reg, read86(ea) + ((uint16_t)read86(ea + 1) << 8));
-        segregs[regds] = read86(ea + 2) + ((uint16_t)read86(ea + 3) << 8);
+        putreg16(reg, readw86(ea));
+        segregs[regds] = readw86(ea + 2);
         break;
       case 0xC6: //C6 MOV Eb Ib
         modregrm();
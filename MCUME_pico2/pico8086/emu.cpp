@@ -25,6 +25,14 @@ extern "C" void  write_ram(int address, unsigned char val)  {
   psram.pswrite(address,val); 
 }
 
+extern "C" unsigned short read_ram_w(int address) {
+  return (psram.psread_w(address));
+}
+
+extern "C" void  write_ram_w(int address, unsigned short val)  {
+  psram.pswrite_w(address,val); 
+}
+
 #define PALMULT8(x)  ((x)<<5)
 #define RGBVAL16(r,g,b)  ( (((r>>3)&0x1f)<<11) | (((g>>2)&0x3f)<<5) | (((b>>3)&0x1f)<<0) )
 
@@ -663,8 +671,12 @@ void emu_KeyboardOnUp(int keymodifer, int key) {
 
 void apc_Step(void)
 { 
+  PROF_BEGIN(PROF_CPU);
   exec86(8000);
+  PROF_END(PROF_CPU);
+  PROF_BEGIN(PROF_VIDEO);
   updatescreen();
+  PROF_END(PROF_VIDEO);
   do_events();
   emu_DrawVsync();
 }
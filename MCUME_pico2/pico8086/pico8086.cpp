@@ -84,6 +84,7 @@ void emu_SetPaletteEntry(unsigned char r, unsigned char g, unsigned char b, int
 {
     if (index<PALETTE_SIZE) {
         palette16[index]  = RGBVAL16(r,g,b);        
+        tft.invalidatePalette(index);
     }
 }
 
@@ -108,6 +109,7 @@ int emu_IsVga(void)
 
 void emu_DrawVsync(void)
 {
+    PROF_FRAME();
     skip += 1;
     skip &= VID_FRAME_SKIP;
     
@@ -646,6 +646,7 @@ void ast_Step(void)
       {
         //delay(15);
         //emu_DrawVsync();
+        PROF_FRAME();
         do_events();
 #ifndef NO_SOUND  
         Sound_Update_VBL();
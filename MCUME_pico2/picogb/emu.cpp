@@ -36,6 +36,7 @@ void gb_error(struct gb_s* gb, const enum gb_error_e gb_err, const uint16_t addr
 
 /**
  * Returns a byte from the ROM file at the given address.
+ * Only used where the bank pointers of gb_set_cart_memory() do not apply.
  */
 uint8_t __not_in_flash_func(gb_rom_read)(struct gb_s* gb, const uint_fast32_t addr) {
     return flash_start[addr];
@@ -56,21 +57,12 @@ void __not_in_flash_func(gb_cart_ram_write)(struct gb_s* gb, const uint_fast32_t
 }
 
 
-static uint8_t tmppixels[LCD_WIDTH];
-
 /**
  * Draws scanline into framebuffer.
+ * DMG pixels keep their palette bits, the palette maps them (see gbc_Start).
  */
 void __always_inline lcd_draw_line(struct gb_s* gb, const unsigned char  *pixels, const uint_fast8_t y) {
-    if (gb->cgb.cgbMode) {
-        emu_DrawLinePal16((unsigned char *)&pixels[0], 160, 128, y);
-    }
-    else 
-    {       
-        for (unsigned int x = 0; x < LCD_WIDTH; x++)
-            tmppixels[x] = pixels[x] & 3; //(pixels[x] & LCD_PALETTE_ALL) >> 4;
-        emu_DrawLinePal16((unsigned char *)&tmppixels[0], 160, 128, y); 
-    }
+    emu_DrawLinePal16((unsigned char *)&pixels[0], 160, 128, y);
 }
 
 void gbc_Init(void)
@@ -90,11 +82,19 @@ void gbc_Input(int click) {
 }
 
 
+// false when the rom could not be read, nothing is emulated
+static bool rom_loaded = false;
+
 void gbc_Start(char * filename)
 {
   emu_printf("gbc_Start");
 
   int size = flash_load(filename);
+  if (!size) {
+    emu_printf("rom load failed");
+    return;
+  }
+  rom_loaded = true;
 
 #ifdef SOUND_PRESENT
 #ifdef HAS_SND  
@@ -105,21 +105,37 @@ void gbc_Start(char * filename)
   /* Initialise GB context. */
   gb_init_error_e ret = gb_init(&gb, &gb_rom_read, &gb_cart_ram_read,
                                 &gb_cart_ram_write, &gb_error, nullptr);
+  gb_set_cart_memory(&gb, flash_start, ram);
+  if (gb.cart_ram) {
+    int savesize = gb_get_save_size(&gb);
+    emu_SaveRegister(filename, ram, (savesize > (int)sizeof(ram)) ? sizeof(ram) : savesize);
+  }
 
   auto_assign_palette(palette16, gb_colour_hash(&gb), gb_get_rom_name(&gb, filename));
   //manual_assign_palette(palette16, 0);
 
-  for (int i = 0; i < 3; i++)
-      for (int j = 0; j < 4; j++) {
-          uint32_t val = RGB565_TO_RGB888(palette16[i][j]);
-          emu_SetPaletteEntry(val>>16, (val>>8) & 0xff, val & 0xff, i * 4 + j);
-      }
+  if (gb.cgb.cgbMode) {
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 4; j++) {
+            uint32_t val = RGB565_TO_RGB888(palette16[i][j]);
+            emu_SetPaletteEntry(val>>16, (val>>8) & 0xff, val & 0xff, i * 4 + j);
+        }
+  }
+  else {
+    // DMG pixels are a colour (bits 0-1) plus palette flags (LCD_PALETTE_ALL),
+    // every index gets the colour of its low bits so lines need no masking
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        uint32_t val = RGB565_TO_RGB888(palette16[0][i & 3]);
+        emu_SetPaletteEntry(val>>16, (val>>8) & 0xff, val & 0xff, i);
+    }
+  }
 
   gb_init_lcd(&gb, &lcd_draw_line);  
   emu_printf("gbc_Start done");
 }
 
 void gbc_Step(void) {
+  if (!rom_loaded) return;
   gb_run_frame(&gb);
   gb.direct.joypad_bits.up = !(( k & MASK_JOY1_UP) || ( k & MASK_JOY2_UP));
   gb.direct.joypad_bits.down = !(( k & MASK_JOY1_DOWN) || ( k & MASK_JOY2_DOWN));
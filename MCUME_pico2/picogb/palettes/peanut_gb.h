@@ -572,6 +572,16 @@ struct gb_s
 	/* Read byte from boot ROM at given address. */
 	uint8_t (*gb_bootrom_read)(struct gb_s*, const uint_fast16_t addr);
 
+	/* Direct access to the cartridge, see gb_set_cart_memory().
+	 * The bank pointers follow the MBC registers, a NULL bank pointer
+	 * means the callbacks above are used. */
+	const uint8_t *rom;
+	uint8_t *cart_ram_mem;
+	const uint8_t *rom_bank0;	/* 0x0000-0x3FFF */
+	const uint8_t *rom_bankn;	/* 0x4000-0x7FFF, indexed by addr - 0x4000 */
+	const uint8_t *cram_read;	/* 0xA000-0xBFFF, indexed by addr - 0xA000 */
+	uint8_t *cram_write;
+
 	struct
 	{
 		uint8_t gb_halt		: 1;
@@ -753,6 +763,46 @@ struct gb_s
 #define IO_STAT_MODE_SEARCH_TRANSFER	3
 #define IO_STAT_MODE_VBLANK_OR_TRANSFER_MASK 0x1
 
+/**
+ * Internal function used to point the bank pointers to the banks selected
+ * by the MBC registers. Same mapping as the callback paths of __gb_read()
+ * and __gb_write(), the cases they handle specially (MBC2 RAM, RTC,
+ * disabled RAM) keep the callbacks.
+ */
+void __gb_update_banks(struct gb_s *gb)
+{
+	uint16_t bank = gb->selected_rom_bank;
+
+	gb->rom_bank0 = NULL;
+	gb->rom_bankn = NULL;
+	gb->cram_read = NULL;
+	gb->cram_write = NULL;
+
+	if(gb->rom != NULL)
+	{
+		if(gb->mbc == 1 && gb->cart_mode_select)
+			bank &= 0x1F;
+
+		gb->rom_bank0 = gb->rom;
+		gb->rom_bankn = gb->rom + bank * ROM_BANK_SIZE;
+	}
+
+	if(gb->cart_ram_mem == NULL || !gb->cart_ram || !gb->enable_cart_ram ||
+			gb->mbc == 2 || (gb->mbc == 3 && gb->cart_ram_bank >= 0x08))
+		return;
+
+	if((gb->cart_mode_select || gb->mbc != 1) &&
+			gb->cart_ram_bank < gb->num_ram_banks)
+		gb->cram_read = gb->cart_ram_mem + gb->cart_ram_bank * CRAM_BANK_SIZE;
+	else
+		gb->cram_read = gb->cart_ram_mem;
+
+	if(gb->cart_mode_select && gb->cart_ram_bank < gb->num_ram_banks)
+		gb->cram_write = gb->cart_ram_mem + gb->cart_ram_bank * CRAM_BANK_SIZE;
+	else if(gb->num_ram_banks)
+		gb->cram_write = gb->cart_ram_mem;
+}
+
 /**
  * Internal function used to read bytes.
  * addr is host platform endian.
@@ -773,12 +823,18 @@ uint8_t __gb_read(struct gb_s *gb, uint16_t addr)
 	case 0x1:
 	case 0x2:
 	case 0x3:
+		if(gb->rom_bank0 != NULL)
+			return gb->rom_bank0[addr];
+
 		return gb->gb_rom_read(gb, addr);
 
 	case 0x4:
 	case 0x5:
 	case 0x6:
 	case 0x7:
+		if(gb->rom_bankn != NULL)
+			return gb->rom_bankn[addr - ROM_BANK_SIZE];
+
 		if(gb->mbc == 1 && gb->cart_mode_select)
 			return gb->gb_rom_read(gb,
 					       addr + ((gb->selected_rom_bank & 0x1F) - 1) * ROM_BANK_SIZE);
@@ -794,6 +850,9 @@ uint8_t __gb_read(struct gb_s *gb, uint16_t addr)
 #endif
 	case 0xA:
 	case 0xB:
+		if(gb->cram_read != NULL)
+			return gb->cram_read[addr - CART_RAM_ADDR];
+
 		if(gb->mbc == 3 && gb->cart_ram_bank >= 0x08)
 		{
 			return gb->cart_rtc[gb->cart_ram_bank - 0x08];
@@ -932,6 +991,7 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 		if(gb->mbc > 0 && gb->mbc != 2 && gb->cart_ram)
 		{
 			gb->enable_cart_ram = ((val & 0x0F) == 0x0A);
+			__gb_update_banks(gb);
 			return;
 		}
 
@@ -942,6 +1002,7 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 			gb->selected_rom_bank = (gb->selected_rom_bank & 0x100) | val;
 			gb->selected_rom_bank =
 				gb->selected_rom_bank & gb->num_rom_banks_mask;
+			__gb_update_banks(gb);
 			return;
 		}
 
@@ -969,6 +1030,7 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 			else
 			{
 				gb->enable_cart_ram = ((val & 0x0F) == 0x0A);
+				__gb_update_banks(gb);
 				return;
 			}
 		}
@@ -983,6 +1045,7 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 			gb->selected_rom_bank = (val & 0x01) << 8 | (gb->selected_rom_bank & 0xFF);
 
 		gb->selected_rom_bank = gb->selected_rom_bank & gb->num_rom_banks_mask;
+		__gb_update_banks(gb);
 		return;
 
 	case 0x4:
@@ -998,11 +1061,13 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 		else if(gb->mbc == 5)
 			gb->cart_ram_bank = (val & 0x0F);
 
+		__gb_update_banks(gb);
 		return;
 
 	case 0x6:
 	case 0x7:
 		gb->cart_mode_select = (val & 1);
+		__gb_update_banks(gb);
 		return;
 
 	case 0x8:
@@ -1016,6 +1081,12 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 
 	case 0xA:
 	case 0xB:
+		if(gb->cram_write != NULL)
+		{
+			gb->cram_write[addr - CART_RAM_ADDR] = val;
+			return;
+		}
+
 		if(gb->mbc == 3 && gb->cart_ram_bank >= 0x08)
 		{
 			gb->cart_rtc[gb->cart_ram_bank - 0x08] = val;
@@ -3911,6 +3982,7 @@ void gb_reset(struct gb_s *gb)
 	gb->cart_ram_bank = 0;
 	gb->enable_cart_ram = 0;
 	gb->cart_mode_select = 0;
+	__gb_update_banks(gb);
 
 	/* Use values as though the boot ROM was already executed. */
 	if(gb->gb_bootrom_read == NULL)
@@ -4070,6 +4142,9 @@ enum gb_init_error_e gb_init(struct gb_s *gb,
 
 	gb->gb_bootrom_read = NULL;
 
+	gb->rom = NULL;
+	gb->cart_ram_mem = NULL;
+
 	/* Check valid ROM using checksum value. */
 	{
 		uint8_t x = 0;
@@ -4162,6 +4237,13 @@ void gb_set_bootrom(struct gb_s *gb,
 	gb->gb_bootrom_read = gb_bootrom_read;
 }
 
+void gb_set_cart_memory(struct gb_s *gb, const uint8_t *rom, uint8_t *cart_ram)
+{
+	gb->rom = rom;
+	gb->cart_ram_mem = cart_ram;
+	__gb_update_banks(gb);
+}
+
 /**
  * This was taken from SameBoy, which is released under MIT Licence.
  */
@@ -4350,6 +4432,17 @@ void gb_set_rtc(struct gb_s *gb, const struct tm * const time);
 void gb_set_bootrom(struct gb_s *gb,
 	uint8_t (*gb_bootrom_read)(struct gb_s*, const uint_fast16_t));
 
+/**
+ * Read the ROM and the cartridge RAM directly through bank pointers instead
+ * of gb_rom_read()/gb_cart_ram_read()/gb_cart_ram_write(), which are then only
+ * used for the cases the pointers do not cover. Either may be NULL.
+ * Should be called after gb_init().
+ * \param gb 	An initialised emulator context. Must not be NULL.
+ * \param rom	Whole ROM image, as seen by gb_rom_read().
+ * \param cart_ram	Cartridge RAM, as seen by gb_cart_ram_read().
+ */
+void gb_set_cart_memory(struct gb_s *gb, const uint8_t *rom, uint8_t *cart_ram);
+
 /* Undefine CPU Flag helper functions. */
 #undef PEANUT_GB_CPUFLAG_MASK_CARRY
 #undef PEANUT_GB_CPUFLAG_MASK_HALFC
@@ -83,6 +83,7 @@ void emu_SetPaletteEntry(unsigned char r, unsigned char g, unsigned char b, int
 {
     if (index<PALETTE_SIZE) {
         palette16[index]  = RGBVAL16(r,g,b);        
+        tft.invalidatePalette(index);
     }
 }
 
@@ -107,6 +108,7 @@ int emu_IsVga(void)
 
 void emu_DrawVsync(void)
 {
+    PROF_FRAME();
     skip += 1;
     skip &= VID_FRAME_SKIP;
 #ifdef HAS_USBPIO
@@ -118,6 +120,7 @@ void emu_DrawVsync(void)
     while (vbl==vb) {};
 #endif
 #endif    
+    emu_SaveVsync();
 }
 
 /*
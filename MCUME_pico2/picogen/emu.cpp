@@ -18,6 +18,7 @@ extern "C" {
 }
 
 #include "flash_t.h"
+#include "hardware/sync.h"
 
 // SETTINGS
 bool show_fps = true;
@@ -41,6 +42,29 @@ uint8_t snd_accurate = 0;
 
 
 static unsigned short screen_line[320];
+// false when the rom could not be read, nothing is emulated
+static bool rom_loaded = false;
+
+#ifdef VDP_CORE1
+// Lines to render on core 1, with the VDP state at the time they were emulated.
+// head only written by core 0, tail only by core 1
+// Core 1 also draws them (emu_DrawLine16): the TFT dirty line tracking is
+// locked against the DMA ISR on core 0, the frame skip only changes once
+// the queue is flushed at the end of the frame.
+#define LINE_QUEUE_SIZE 8
+#define LINE_QUEUE_MASK (LINE_QUEUE_SIZE-1)
+
+typedef struct {
+  gwenesis_vdp_line_t vdp;
+  int height;
+} LineJob;
+
+static LineJob line_queue[LINE_QUEUE_SIZE];
+static volatile unsigned int line_head = 0;
+static volatile unsigned int line_tail = 0;
+static unsigned short core1_line[320];
+static bool vdp_core1 = false;
+#endif
 
 
 void gwenesis_io_get_buttons() {
@@ -68,12 +92,67 @@ void gen_Input(int click) {
 }
 
 extern void * emu_LineBuffer(int line);
+extern bool emu_Core1Task(void (*task)(void));
+
+#ifdef VDP_CORE1
+// core 1
+static void gen_RenderLines(void)
+{
+  unsigned int tail = line_tail;
+  if (tail == line_head) return;
+  LineJob * job = &line_queue[tail & LINE_QUEUE_MASK];
+  gwenesis_vdp_render_snapshot(&job->vdp, &core1_line[0]);
+  emu_DrawLine16(&core1_line[0], 320, job->height, job->vdp.line);
+  // job done before it can be reused
+  __dmb();
+  line_tail = tail+1;
+}
+
+// core 0
+static void gen_QueueLine(int line, int height)
+{
+  unsigned int head = line_head;
+  // core 1 stays a few lines behind at most
+  while ((head - line_tail) >= LINE_QUEUE_SIZE) {
+    tight_loop_contents();
+  }
+  LineJob * job = &line_queue[head & LINE_QUEUE_MASK];
+  gwenesis_vdp_line_snapshot(&job->vdp, line);
+  job->height = height;
+  __dmb();
+  line_head = head+1;
+}
+
+static void gen_FlushLines(void)
+{
+  while (line_tail != line_head) {
+    tight_loop_contents();
+  }
+}
+#endif
+
+static int gen_SaveState(void)
+{
+  gwenesis_save_state();
+  return 0;
+}
+
+static int gen_LoadState(void)
+{
+  gwenesis_load_state();
+  return 0;
+}
 
 void gen_Start(char * filename)
 {
   emu_printf("gen_Start");
 
   int size = flash_load_bswap(filename);
+  if (!size) {
+    emu_printf("rom load failed");
+    return;
+  }
+  rom_loaded = true;
 
   load_cartridge((uintptr_t)flash_start);
 
@@ -81,12 +160,18 @@ void gen_Start(char * filename)
   power_on();
   reset_emulation();
   gwenesis_vdp_set_buffer(&screen_line[0]);
+  emu_StateRegister(filename, "gen", 1, gen_SaveState, gen_LoadState);
 
 #ifdef HAS_SND  
   emu_sndInit();   
   memset(gwenesis_sn76489_buffer, 0, sizeof(gwenesis_sn76489_buffer));
   memset(gwenesis_ym2612_buffer, 0, sizeof(gwenesis_ym2612_buffer));  
 #endif  
+#ifdef VDP_CORE1
+  vdp_core1 = emu_Core1Task(gen_RenderLines);
+  // VRAM is not part of the snapshot, queued lines are drawn before it changes
+  if (vdp_core1) gwenesis_vdp_set_vram_write_callback(gen_FlushLines);
+#endif
 
   emu_printf("gen_Start done");
 }
@@ -103,12 +188,38 @@ int scan_line;
 unsigned int frame_counter = 0;
 unsigned int drawFrame = 1;
 
+static uint32_t frame_time = 0;
+static int frame_lag = 0;       // us behind real time
+static int frames_skipped = 0;
+
 extern unsigned char gwenesis_vdp_regs[0x20];
 extern unsigned int gwenesis_vdp_status;
 extern unsigned int screen_width, screen_height;
 extern int hint_pending;
 
+// decide if the next frame is rendered, from the time the last one took
+static void gen_FrameSkip(bool is_pal)
+{
+    uint32_t now = time_us_32();
+    const int budget = 1000000 / (is_pal ? GWENESIS_REFRESH_RATE_PAL : GWENESIS_REFRESH_RATE_NTSC);
+    if (frame_time != 0) frame_lag += (int)(now - frame_time) - budget;
+    frame_time = now;
+    // ahead of time, the audio output paces the emulation
+    if (frame_lag < 0) frame_lag = 0;
+    // do not try to catch up more than a few frames
+    if (frame_lag > FRAMESKIP_MAX*budget) frame_lag = FRAMESKIP_MAX*budget;
+    if ( (frameskip) && (frame_lag > budget/4) && (frames_skipped < FRAMESKIP_MAX) ) {
+        drawFrame = 0;
+        frames_skipped++;
+    }
+    else {
+        drawFrame = 1;
+        frames_skipped = 0;
+    }
+}
+
 void gen_Step(void) {
+    if (!rom_loaded) return;
     int hint_counter = gwenesis_vdp_regs[10];
 
     const bool is_pal = REG1_PAL;
@@ -126,22 +237,38 @@ void gen_Step(void) {
     ym2612_clock = 0;
     ym2612_index = 0;        
     scan_line = 0;
+    PROF_BEGIN(PROF_CPU);
     if (z80_enable_mode == 1)
         z80_run(lines_per_frame * VDP_CYCLES_PER_LINE);
+    PROF_END(PROF_CPU);
 
     //printf("m(%x)\n", frame);
     while (scan_line < lines_per_frame) {
         /* CPUs */
+        PROF_BEGIN(PROF_CPU);
         m68k_run(system_clock + VDP_CYCLES_PER_LINE);
         if (z80_enable_mode == 2)
                 z80_run(system_clock + VDP_CYCLES_PER_LINE);
+        PROF_END(PROF_CPU);
         /* Video */
         // Interlace mode
         //if (drawFrame && !interlace || (frame % 2 == 0 && scan_line % 2) || scan_line % 2 == 0) {
         if (drawFrame)  {
+#ifdef VDP_CORE1
+            if (vdp_core1) {
+                PROF_BEGIN(PROF_VIDEO);
+                if (scan_line < screen_height) gen_QueueLine(scan_line, screen_height);
+                PROF_END(PROF_VIDEO);
+            }
+            else
+#endif
+            {
+            PROF_BEGIN(PROF_VIDEO);
             gwenesis_vdp_set_buffer(&screen_line[0]);
             gwenesis_vdp_render_line(scan_line); /* render scan_line */
+            PROF_END(PROF_VIDEO);
             if (scan_line < screen_height ) emu_DrawLine16(&screen_line[0], 320, screen_height, scan_line);
+            }
         }
 
         // On these lines, the line counter interrupt is reloaded
@@ -172,17 +299,16 @@ void gen_Step(void) {
 
         if (!is_pal && scan_line == screen_height + 1) {
             z80_irq_line(0);
-            // FRAMESKIP every 3rd frame
-            //drawFrame = frameskip && frame % 3 != 0;
-            // if (frameskip && frame % 3 == 0) {
-            //     drawFrame = 0;
-            // } else {
-            //     drawFrame = 1;
-            // }
         }
 
         system_clock += VDP_CYCLES_PER_LINE;
     }
+#ifdef VDP_CORE1
+    // next frame may change the render config
+    PROF_BEGIN(PROF_VIDEO);
+    gen_FlushLines();
+    PROF_END(PROF_VIDEO);
+#endif
     frame++;
     /*
     if (limit_fps) {
@@ -199,6 +325,7 @@ void gen_Step(void) {
 
 #ifdef HAS_SND_SYNC
     if (audio_enabled) {
+        PROF_BEGIN(PROF_AUDIO);
         ym2612_run(262 * VDP_CYCLES_PER_LINE);
         gwenesis_SN76489_run(262 * VDP_CYCLES_PER_LINE);
         audio_sample * snd_buf =  (audio_sample *)emu_sndGetBuffer();
@@ -207,9 +334,38 @@ void gen_Step(void) {
         int16_t s2 = gwenesis_ym2612_buffer[(h/ 2 / GWENESIS_AUDIO_SAMPLING_DIVISOR+1) ] + gwenesis_sn76489_buffer[(h/ 2 / GWENESIS_AUDIO_SAMPLING_DIVISOR+1)]>>8;
         *snd_buf++ = ((s1+s2)/4)+128;
         }
+        PROF_END(PROF_AUDIO);
     }     
 #endif
 
+#ifdef SND_RING
+    if (audio_enabled) {
+        // render the whole frame here and resample it to the output rate,
+        // the audio side only drains the ring
+        static short snd_buf[SOUNDRATE/GWENESIS_REFRESH_RATE_PAL+1];
+        static unsigned int snd_pos = 0;
+        const int refresh = is_pal ? GWENESIS_REFRESH_RATE_PAL : GWENESIS_REFRESH_RATE_NTSC;
+        PROF_BEGIN(PROF_AUDIO);
+        ym2612_run(lines_per_frame * VDP_CYCLES_PER_LINE);
+        gwenesis_SN76489_run(lines_per_frame * VDP_CYCLES_PER_LINE);
+        int srclen = (ym2612_index < sn76489_index) ? ym2612_index : sn76489_index;
+        int len = 0;
+        if (srclen > 1) {
+            unsigned int snd_step = ((srclen-1) << 16) / (SOUNDRATE/refresh);
+            while ( ((snd_pos >> 16) < (unsigned int)(srclen-1)) && (len < SOUNDRATE/GWENESIS_REFRESH_RATE_PAL) ) {
+                int h = snd_pos >> 16;
+                int16_t s1 = gwenesis_ym2612_buffer[h] + gwenesis_sn76489_buffer[h]>>8;
+                int16_t s2 = gwenesis_ym2612_buffer[h+1] + gwenesis_sn76489_buffer[h+1]>>8;
+                snd_buf[len++] = ((s1+s2)/4)+128;
+                snd_pos += snd_step;
+            }
+            snd_pos -= (snd_pos >> 16) << 16;
+        }
+        emu_sndPush(snd_buf, len);
+        PROF_END(PROF_AUDIO);
+    }
+#endif
+
     // reset m68k cycles to the begin of next frame cycle
     m68k.cycles -= system_clock;
 
@@ -243,7 +399,10 @@ void gen_Step(void) {
 
   button_state[0] = ~ button_state[0];
 
+  gen_FrameSkip(is_pal);
+
   //emu_DrawVsync();   
+  PROF_FRAME();
 }
 
 
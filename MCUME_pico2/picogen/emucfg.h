@@ -6,6 +6,14 @@
 #define TFT_VBUFFER_YCROP    0
 #define SINGLELINE_RENDERING 1
 #define CUSTOM_SND           1
+#define SND_RING             1
+#define SND_RING_PUSH        1
+// VDP lines rendered on core 1 while core 0 runs the CPUs
+#define VDP_CORE1            1
+// adaptive frame skip, most frames dropped in a row
+#define FRAMESKIP_MAX        3
+// state of slot 0, if any, is loaded when the ROM starts
+#define STATE_RESUME         1
 //#define TIMER_REND           1
 #define EXTRA_HEAP           0x10
 #define FILEBROWSER
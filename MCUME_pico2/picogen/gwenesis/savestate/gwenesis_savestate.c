@@ -31,13 +31,64 @@ __license__ = "GPLv3"
 
 #include "../savestate/gwenesis_savestate.h"
 
+#include "emuapi.h"
+
 #include <assert.h>
 
+/* Tagged values of each module are chunks "<module>.<tag>" of the
+   save state being written or read by emu_StateSave/emu_StateLoad. */
+struct SaveState {
+  const char *name;
+};
+
+static SaveState current_state;
+
+static void saveGwenesisStateKey(char *key, SaveState* state, const char* tagName) {
+  snprintf(key, 32, "%s.%s", state->name, tagName);
+}
+
+SaveState* saveGwenesisStateOpenForRead(const char* fileName) {
+  current_state.name = fileName;
+  return &current_state;
+}
+
+SaveState* saveGwenesisStateOpenForWrite(const char* fileName) {
+  current_state.name = fileName;
+  return &current_state;
+}
+
+int saveGwenesisStateGet(SaveState* state, const char* tagName) {
+  char key[32];
+  int value = 0;
+  saveGwenesisStateKey(key, state, tagName);
+  emu_StateRestore(key, &value, sizeof(value));
+  return value;
+}
+
+void saveGwenesisStateSet(SaveState* state, const char* tagName, int value) {
+  char key[32];
+  saveGwenesisStateKey(key, state, tagName);
+  emu_StateChunk(key, &value, sizeof(value));
+}
+
+void saveGwenesisStateGetBuffer(SaveState* state, const char* tagName, void* buffer, int length) {
+  char key[32];
+  saveGwenesisStateKey(key, state, tagName);
+  emu_StateRestore(key, buffer, length);
+}
+
+void saveGwenesisStateSetBuffer(SaveState* state, const char* tagName, void* buffer, int length) {
+  char key[32];
+  saveGwenesisStateKey(key, state, tagName);
+  emu_StateChunk(key, buffer, length);
+}
+
 void gwenesis_save_state() {
   /* DO NOT CHANGE ORDER - NEEDS TO BE SAME AS IN LOAD */
   gwenesis_m68k_save_state();
   gwenesis_io_save_state();
   gwenesis_bus_save_state();
+  gwenesis_z80inst_save_state();
   gwenesis_vdp_gfx_save_state();
   gwenesis_vdp_mem_save_state();
 
@@ -48,7 +99,10 @@ void gwenesis_load_state() {
   gwenesis_m68k_load_state();
   gwenesis_io_load_state();
   gwenesis_bus_load_state();
+  gwenesis_z80inst_load_state();
   gwenesis_vdp_gfx_load_state();
   gwenesis_vdp_mem_load_state();
+  /* derived from the VDP registers */
+  gwenesis_vdp_render_config();
 
 }
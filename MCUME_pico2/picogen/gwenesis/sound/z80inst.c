@@ -332,11 +332,25 @@ void PatchZ80(register Z80 *R) {;}
 void DebugZ80(register Z80 *R) {;}
 
 void gwenesis_z80inst_save_state() {
-
+  SaveState* state;
+  state = saveGwenesisStateOpenForWrite("z80");
+  saveGwenesisStateSetBuffer(state, "cpu", &cpu, sizeof(cpu));
+  saveGwenesisStateSet(state, "bus_ack", bus_ack);
+  saveGwenesisStateSet(state, "reset", reset);
+  saveGwenesisStateSet(state, "reset_once", reset_once);
+  saveGwenesisStateSet(state, "zclk", zclk);
+  saveGwenesisStateSet(state, "Z80_BANK", Z80_BANK);
 }
 
 void gwenesis_z80inst_load_state() {
-
-
+  SaveState* state = saveGwenesisStateOpenForRead("z80");
+  void *user = cpu.User;
+  saveGwenesisStateGetBuffer(state, "cpu", &cpu, sizeof(cpu));
+  cpu.User = user;
+  bus_ack = saveGwenesisStateGet(state, "bus_ack");
+  reset = saveGwenesisStateGet(state, "reset");
+  reset_once = saveGwenesisStateGet(state, "reset_once");
+  zclk = saveGwenesisStateGet(state, "zclk");
+  Z80_BANK = saveGwenesisStateGet(state, "Z80_BANK");
 }
 
@@ -83,6 +83,14 @@ __license__ = "GPLv3"
 #define REG_SIZE 0x20            // REGISTERS total
 #define FIFO_SIZE 0x4            // FIFO maximum size
 
+// VDP state a line is rendered with, see gwenesis_vdp_line_snapshot()
+typedef struct {
+  int line;
+  unsigned char regs[REG_SIZE];
+  unsigned short cram565[CRAM_MAX_SIZE];
+  unsigned short vsram[VSRAM_MAX_SIZE];
+} gwenesis_vdp_line_t;
+
 #define COLOR_3B_TO_8B(c)  (((c) << 5) | ((c) << 2) | ((c) >> 1))
 #define CRAM_R(c)          COLOR_3B_TO_8B(BITS((c), 1, 3))
 #define CRAM_G(c)          COLOR_3B_TO_8B(BITS((c), 5, 3))
@@ -129,6 +137,7 @@ unsigned int gwenesis_vdp_read_memory_16(unsigned int address);
 
 void gwenesis_vdp_write_memory_8(unsigned int address, unsigned int value);
 void gwenesis_vdp_write_memory_16(unsigned int address, unsigned int value);
+void gwenesis_vdp_set_vram_write_callback(void (*callback)(void));
 
 void gwenesis_vdp_set_buffers(unsigned char *screen_buffer, unsigned char *scaled_buffer);
 void gwenesis_vdp_set_buffer(unsigned short *ptr_screen_buffer);
@@ -136,6 +145,8 @@ void gwenesis_vdp_get_buffer(uint16_t** ptr_screen_buffer);
 void gwenesis_vdp_render_line(int line);
 
 void gwenesis_vdp_render_config();
+void gwenesis_vdp_line_snapshot(gwenesis_vdp_line_t *snap, int line);
+void gwenesis_vdp_render_snapshot(const gwenesis_vdp_line_t *snap, unsigned short *ptr_screen_buffer);
 
 unsigned int gwenesis_vdp_get_status();
 void gwenesis_vdp_get_debug_status(char *s);
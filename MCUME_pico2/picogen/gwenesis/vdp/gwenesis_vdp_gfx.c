@@ -40,6 +40,12 @@ extern unsigned short CRAM565[];    // CRAM - Palettes
 
 extern unsigned short VSRAM[];        // VSRAM - Scrolling
 
+// The renderer gets registers, palette and vertical scroll as arguments,
+// the live VDP state or a line snapshot (see below). They are named after
+// the globals so the REG macros read the arguments.
+#define VDP_STATE_ARGS unsigned char *gwenesis_vdp_regs, unsigned short *CRAM565, unsigned short *VSRAM
+#define VDP_STATE gwenesis_vdp_regs, CRAM565, VSRAM
+
 // Define screen buffers: original and scaled for host RGB
 //unsigned char *screen, *scaled_screen;
 
@@ -263,7 +269,7 @@ void draw_pattern_fliph_sprite_over_planes(uint8_t *scr, uint32_t p, uint8_t att
 
 
 static inline __attribute__((always_inline)) void
-draw_pattern_nofliph_planeB(uint8_t *scr, uint32_t p, uint8_t attrs) {
+draw_pattern_nofliph_planeB(uint8_t *scr, uint32_t p, uint8_t attrs, VDP_STATE_ARGS) {
 
   const uint8_t back = gwenesis_vdp_regs[7];
 
@@ -292,7 +298,7 @@ draw_pattern_nofliph_planeB(uint8_t *scr, uint32_t p, uint8_t attrs) {
 }
 
 static inline __attribute__((always_inline)) void
-draw_pattern_fliph_planeB(uint8_t *scr, uint32_t p, uint8_t attrs) {
+draw_pattern_fliph_planeB(uint8_t *scr, uint32_t p, uint8_t attrs, VDP_STATE_ARGS) {
 
   const uint8_t back = gwenesis_vdp_regs[7];
   if (p == 0) {
@@ -457,7 +463,7 @@ void draw_pattern_sprite_over_planes(uint8_t *scr, uint16_t name, int paty) {
 }
 
 static inline __attribute__((always_inline))
-void draw_pattern_planeB(uint8_t *scr, uint16_t name, int paty) {
+void draw_pattern_planeB(uint8_t *scr, uint16_t name, int paty, VDP_STATE_ARGS) {
  // uint16_t pat_addr = name  << 5; // * 32;
  // uint8_t pat_palette = BITS(name, 13, 2);
  // unsigned int is_pat_pri = name & 0x8000;
@@ -479,10 +485,10 @@ void draw_pattern_planeB(uint8_t *scr, uint16_t name, int paty) {
 
   // Horizontal flip ?
   if (name & 0x0800)
-    draw_pattern_fliph_planeB(scr, pattern, attrs);
+    draw_pattern_fliph_planeB(scr, pattern, attrs, VDP_STATE);
 
   else
-    draw_pattern_nofliph_planeB(scr, pattern, attrs);
+    draw_pattern_nofliph_planeB(scr, pattern, attrs, VDP_STATE);
 
 }
 
@@ -531,7 +537,7 @@ static  uint16_t ntw_mask, nth_mask;
  ******************************************************************************/
 
 static inline __attribute__((always_inline))
-unsigned int get_hscroll_vram(int line)
+unsigned int get_hscroll_vram(int line, VDP_STATE_ARGS)
 {
 
     int mode = REG11_HSCROLL_MODE;
@@ -563,12 +569,12 @@ unsigned int get_hscroll_vram(int line)
  ******************************************************************************/
  //__attribute__((optimize("unroll-loops")))
 static inline __attribute__((always_inline))
-void draw_line_b(int line)
+void draw_line_b(int line, VDP_STATE_ARGS)
 {
   uint8_t *scr  = &render_buffer[PIX_OVERFLOW];
 
   unsigned int ntaddr = REG4_NAMETABLE_B;
-  uint16_t scrollx=FETCH16VRAM(get_hscroll_vram(line) + 2) & 0x3FF;
+  uint16_t scrollx=FETCH16VRAM(get_hscroll_vram(line, VDP_STATE) + 2) & 0x3FF;
   uint16_t *vsram = &VSRAM[1];
   uint8_t *end = scr + screen_width;
 
@@ -592,7 +598,7 @@ void draw_line_b(int line)
    // unsigned int nt = ntaddr + row * (2 * ntwidth);
     unsigned int nt = ntaddr + row * ntwidth_x2;
 
-    draw_pattern_planeB(scr, FETCH16VRAM(nt + col * 2), paty);
+    draw_pattern_planeB(scr, FETCH16VRAM(nt + col * 2), paty, VDP_STATE);
     col = (col + 1) & ntw_mask;
     scr += 8;
     numcell++;
@@ -609,12 +615,12 @@ void draw_line_b(int line)
  ******************************************************************************/
 //_attribute__((optimize("unroll-loops")))
 static inline __attribute__((always_inline))
-void draw_line_aw(int line) {
+void draw_line_aw(int line, VDP_STATE_ARGS) {
 
   uint8_t *scr  = &render_buffer[PIX_OVERFLOW];
 
   unsigned int ntaddr = REG2_NAMETABLE_A;
-  uint16_t scrollx=FETCH16VRAM(get_hscroll_vram(line) + 0) & 0x3FF;
+  uint16_t scrollx=FETCH16VRAM(get_hscroll_vram(line, VDP_STATE) + 0) & 0x3FF;
   uint16_t *vsram = &VSRAM[0];
 
   // Check if we are in the window region only
@@ -703,7 +709,7 @@ void draw_line_aw(int line) {
 
 //__attribute__((optimize("unroll-loops")))
 static inline __attribute__((always_inline)) 
-void draw_sprites_over_planes(int line)
+void draw_sprites_over_planes(int line, VDP_STATE_ARGS)
 {
     uint8_t *scr;
 
@@ -811,7 +817,7 @@ void draw_sprites_over_planes(int line)
   //      sprite_collision = true;
 }
 static inline __attribute__((always_inline)) 
-void draw_sprites(int line)
+void draw_sprites(int line, VDP_STATE_ARGS)
 {
   uint8_t *scr;
 
@@ -1003,7 +1009,7 @@ blit_4to5_line(uint16_t *in, uint16_t *out) {
   }
 }
 
-void gwenesis_vdp_render_line(int line)
+static void render_line(int line, VDP_STATE_ARGS)
 {
   mode_h40 = REG12_MODE_H40;
   //mode_pal = REG1_PAL;
@@ -1068,13 +1074,13 @@ void gwenesis_vdp_render_line(int line)
   if (MODE_SHI)
     memset(ps, 0, 320);
 
-  draw_line_b(line);
-  draw_line_aw(line);
+  draw_line_b(line, VDP_STATE);
+  draw_line_aw(line, VDP_STATE);
 
   if (MODE_SHI)
-    draw_sprites(line);
+    draw_sprites(line, VDP_STATE);
   else
-    draw_sprites_over_planes(line);
+    draw_sprites_over_planes(line, VDP_STATE);
     
 #if 1 //GNW_TARGET_MARIO != 0 | GNW_TARGET_ZELDA != 0
 
@@ -1270,6 +1276,44 @@ void gwenesis_vdp_render_line(int line)
 
 }
 
+void gwenesis_vdp_render_line(int line)
+{
+  render_line(line, gwenesis_vdp_regs, CRAM565, VSRAM);
+}
+
+/******************************************************************************
+ *
+ *  Line snapshot, to render a line later (or on the other core) with the
+ *  registers, palette and vertical scroll it had when it was emulated.
+ *  VRAM and sprite cache are not copied, they are read when rendering.
+ *
+ ******************************************************************************/
+
+void gwenesis_vdp_line_snapshot(gwenesis_vdp_line_t *snap, int line)
+{
+  snap->line = line;
+  memcpy(snap->regs, gwenesis_vdp_regs, sizeof(snap->regs));
+  memcpy(snap->cram565, CRAM565, sizeof(snap->cram565));
+  memcpy(snap->vsram, VSRAM, sizeof(snap->vsram));
+}
+
+void gwenesis_vdp_render_snapshot(const gwenesis_vdp_line_t *snap, unsigned short *ptr_screen_buffer)
+{
+  // pixels keep their priority bits (0x40/0x80), palette is mirrored 4 times.
+  // Static to spare the core 1 stack, only the rendering core gets here.
+  static unsigned char regs[REG_SIZE];
+  static unsigned short cram565[CRAM_MAX_SIZE * 4];
+  static unsigned short vsram[VSRAM_MAX_SIZE];
+
+  memcpy(regs, snap->regs, sizeof(regs));
+  for (int i = 0; i < 4; i++)
+    memcpy(&cram565[i * CRAM_MAX_SIZE], snap->cram565, sizeof(snap->cram565));
+  memcpy(vsram, snap->vsram, sizeof(vsram));
+
+  screen_buffer_line = ptr_screen_buffer;
+  render_line(snap->line, regs, cram565, vsram);
+}
+
 void gwenesis_vdp_gfx_save_state() {
   /*
   SaveState* state;
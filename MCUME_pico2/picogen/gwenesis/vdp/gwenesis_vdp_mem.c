@@ -109,6 +109,15 @@ extern bool sprite_collision;
 
 //static int DMA_RUN=0;
 
+// Called before VRAM is written, lets lines still to be rendered from
+// the current VRAM content be drawn first
+static void (*vram_write_callback)(void) = NULL;
+
+void gwenesis_vdp_set_vram_write_callback(void (*callback)(void))
+{
+  vram_write_callback = callback;
+}
+
 // 16 bits access to VRAM
 #define FETCH16(A) ( ( (*(unsigned short *)&VRAM[(A)]) >> 8 ) | ( (*(unsigned short *)&VRAM[(A)]) << 8 ) )
 
@@ -335,6 +344,9 @@ void push_fifo(unsigned int value)
 //static inline __attribute__((always_inline))
 void __not_in_flash_func(gwenesis_vdp_vram_write)(unsigned int address, unsigned int value)
 {
+  if (vram_write_callback)
+    vram_write_callback();
+
   VRAM[address] = value;
 
   // Update internal SAT Cache
@@ -75,6 +75,7 @@ int main(void) {
         uint16_t bClick = emu_DebounceLocalKeys();
         emu_Input(bClick);  
         emu_Step();               
+        emu_StateHotkeys();
     }
 }
 
@@ -83,6 +84,7 @@ void emu_SetPaletteEntry(unsigned char r, unsigned char g, unsigned char b, int
 {
     if (index<PALETTE_SIZE) {
         palette16[index]  = RGBVAL16(r,g,b);        
+        tft.invalidatePalette(index);
     }
 }
 
@@ -163,6 +165,11 @@ void * emu_LineBuffer(int line)
     return (void*)tft.getLineBuffer(line);    
 }
 
+bool emu_Core1Task(void (*task)(void))
+{
+    return tft.begin_core1(task);
+}
+
 
 #ifdef HAS_SND
 #include "AudioPlaySystem.h"
@@ -189,6 +196,13 @@ void emu_sndPlayBuzz(int size, int val) {
   mymixer.buzz(size,val); 
 }
 
+#ifdef SND_RING
+int emu_sndPush(short * stream, int len)
+{
+  return mymixer.push(stream, len);
+}
+#endif
+
 #endif
 
 
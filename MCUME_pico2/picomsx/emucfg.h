@@ -9,6 +9,8 @@
 #define CUSTOM_SND_C         1
 //#define TIMER_REND           1
 #define EXTRA_HEAP           0x1
+// top of the PSRAM taken from the ROM flash for emu_Malloc, when the heap is full
+#define SLOW_HEAP            0x80000
 #define FILEBROWSER
 
 // Title:     <                        >
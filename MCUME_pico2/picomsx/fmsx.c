@@ -658,6 +658,8 @@ void msx_Start(char * Cartridge)
     /* Erase SRAM and add it to the list of mallocs */
     memset(SRAM,NORAM,0x4000);
     Chunks[CCount++]=SRAM;
+    /* Battery backed, kept in a .sav file next to the cartridge */
+    emu_SaveRegister(CartA,SRAM,0x4000);
 #ifdef unused
     /* Try loading SRAM data form disk */
     if(!(F=fopen("GMASTER2.RAM","rb"))) { 
@@ -40,13 +40,22 @@ void pce_Input(int click) {
 }
 
 
+// false when the rom could not be read, nothing is emulated
+static bool rom_loaded = false;
+
 void pce_Start(char * filename)
 {
   emu_printf("pce_Start");
 
   int size = flash_load(filename);
+  if (!size) {
+    emu_printf("rom load failed");
+    return;
+  }
+  rom_loaded = true;
   PalettePCE(0);
   InitPCE(AUDIO_SAMPLE_RATE, true, (const void *)flash_start, (size_t)size);
+  emu_StateRegister(filename, "pce", SAVESTATE_VERSION, SaveState, LoadState);
 
 #ifdef HAS_SND  
   emu_sndInit(); 
@@ -56,7 +65,25 @@ void pce_Start(char * filename)
 }
 
 void pce_Step(void) {
+  if (!rom_loaded) return;
   RunPCE();
+#if defined(HAS_SND) && defined(SND_RING)
+  {
+    // the audio side only drains the ring
+    static short snd_buf[AUDIO_BUFFER_LENGTH+1];
+    PROF_BEGIN(PROF_AUDIO);
+    int16_t * buf;
+    int len = psg_frame(&buf);
+    if (len > AUDIO_BUFFER_LENGTH+1) len = AUDIO_BUFFER_LENGTH+1;
+    for (int i = 0; i < len; i++) {
+      int16_t s1 = buf[2*i]>>8;
+      int16_t s2 = buf[2*i+1]>>8;
+      snd_buf[i] = ((s1+s2)/2)+128;
+    }
+    emu_sndPush(snd_buf, len);
+    PROF_END(PROF_AUDIO);
+  }
+#endif
   uint32_t buttons = 0;
   if (( k & MASK_JOY1_RIGHT) || ( k & MASK_JOY2_RIGHT)) {
     buttons |= JOY_LEFT;
@@ -81,6 +108,7 @@ void pce_Step(void) {
   PCE.Joypad.regs[0] = buttons; 
 
   //emu_DrawVsync();   
+  PROF_FRAME();
 }
 
 void SND_Process(void *stream, int len) {
@@ -6,6 +6,11 @@
 #define TFT_VBUFFER_YCROP    0
 #define SINGLELINE_RENDERING 1
 #define CUSTOM_SND           1
+// PSG rendered per frame by the emulation, the audio output drains a ring
+#define SND_RING             1
+#define SND_RING_PUSH        1
+// state of slot 0, if any, is loaded when the ROM starts
+#define STATE_RESUME         1
 //#define TIMER_REND           1
 #define EXTRA_HEAP           0x10
 #define FILEBROWSER
@@ -8,6 +8,7 @@
 #include "gfx.h"
 #include "psg.h"
 #include "pce.h"
+#include "emuapi.h"
 
 /**
  * Save state file description.
@@ -31,7 +32,6 @@ typedef const struct {
     void *ptr;
 } save_var_t;
 
-static const char SAVESTATE_HEADER[8] = "PCE_V010";
 static save_var_t SaveStateVars[] =
         {
                 // Arrays
@@ -318,46 +318,42 @@ RunPCE(void) {
 
 
 /**
- * Load saved state
+ * Only the sound in progress is lost without the PSG chunks
  */
-int LoadState(const char *name) {
+static bool
+OptionalState(const char *key) {
+    return !strncmp(key, "PSG.", 4);
+}
 
-    MESSAGE_INFO("Loading state from %s...\n", name);
 
-    char buffer[32];
-    block_hdr_t block;
-    int ret = -1;
-    unsigned int br = 0;
+/**
+ * Load saved state, called back by emu_StateLoad()
+ * Nothing is restored if a required chunk is missing
+ */
+int LoadState(void) {
+    int missing = 0;
 
-    FIL fp;
-    if (f_open(&fp, name, FA_READ) != FR_OK)
-        return -1;
+    MESSAGE_INFO("Loading state...\n");
 
-    if (FR_OK != f_read(&fp, &buffer, 8, &br) || !br || memcmp(&buffer, SAVESTATE_HEADER, 8) != 0) {
-        MESSAGE_ERROR("Loading state failed: Header mismatch\n");
-        goto _cleanup;
+    for (save_var_t *var = SaveStateVars; var->ptr; var++) {
+        if (emu_StateSize(var->desc.key) < 0) {
+            emu_printf("state chunk missing");
+            emu_printf(var->desc.key);
+            if (!OptionalState(var->desc.key))
+                missing++;
+        }
     }
+    if (missing)
+        return -1;
 
-    while (FR_OK == f_read(&fp, &block, sizeof(block), &br) && br) {
-        size_t block_end = f_tell(&fp) + block.len;
-
-        for (save_var_t *var = SaveStateVars; var->ptr; var++) {
-            if (strncmp(var->desc.key, block.key, 12) == 0) {
-                void *ptr = var->ptr;
-                size_t len = MIN((size_t) var->desc.len, (size_t) block.len);
-                //memset(ptr, 0, var->desc.len);
-                if (FR_OK != f_read(&fp, ptr, len, &br) || !br) {
-                    MESSAGE_ERROR("fread error reading block data\n");
-                    goto _cleanup;
-                }
-                if (len < var->desc.len) {
-                    memset(ptr + len, 0, var->desc.len - len);
-                }
-                MESSAGE_INFO("Loaded %s\n", var->desc.key);
-                break;
-            }
+    for (save_var_t *var = SaveStateVars; var->ptr; var++) {
+        size_t len = emu_StateRestore(var->desc.key, var->ptr, var->desc.len);
+        if (len == 0)
+            continue;
+        if (len < var->desc.len) {
+            memset(var->ptr + len, 0, var->desc.len - len);
         }
-        f_lseek(&fp, block_end);
+        MESSAGE_INFO("Loaded %s\n", var->desc.key);
     }
 
     for (int i = 0; i < 8; i++)
@@ -365,51 +361,24 @@ int LoadState(const char *name) {
 
     gfx_reset(true);
     PCE.VDC.mode_chg = 1;
-    ret = 0;
-
-    _cleanup:
-    f_close(&fp);
 
-    return ret;
+    return 0;
 }
 
 
 /**
- * Save current state
+ * Save current state, called back by emu_StateSave()
  */
 int
-SaveState(const char *name) {
-    MESSAGE_INFO("Saving state to %s...\n", name);
-
-    int ret = -1;
-    unsigned int bw = 0;
-
-    FIL fp;
-    if (f_open(&fp, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
-        return -1;
-
-    f_write(&fp, SAVESTATE_HEADER, sizeof(SAVESTATE_HEADER), &bw);
+SaveState(void) {
+    MESSAGE_INFO("Saving state...\n");
 
     for (save_var_t *var = SaveStateVars; var->ptr; var++) {
-        void *ptr = var->ptr;
-        size_t len = var->desc.len;
-        if (FR_OK != f_write(&fp, &var->desc, sizeof(var->desc), &bw)) {
-            MESSAGE_ERROR("fwrite error desc\n");
-            goto _cleanup;
-        }
-        if (FR_OK != f_write(&fp, ptr, len, &bw)) {
-            MESSAGE_ERROR("fwrite error value\n");
-            goto _cleanup;
-        }
+        emu_StateChunk(var->desc.key, var->ptr, var->desc.len);
         MESSAGE_INFO("Saved %s\n", var->desc.key);
     }
 
-    ret = 0;
-
-    _cleanup:
-    f_close(&fp);
-
-    return ret;
+    return 0;
 }
 
 
@@ -73,8 +73,11 @@
 #define XBUF_WIDTH 	(16 + 320 + 16)
 #define	XBUF_HEIGHT	(242 + 4)
 
-int LoadState(const char *name);
-int SaveState(const char *name);
+// version of SaveStateVars, bumped when it changes (was the "PCE_V010" header)
+#define SAVESTATE_VERSION 0x010
+
+int LoadState(void);
+int SaveState(void);
 void ResetPCE(bool);
 void RunPCE(void);
 void ShutdownPCE();
@@ -6,6 +6,7 @@
 #include "pce-go.h"
 #include "pce.h"
 #include "gfx.h"
+#include "psg.h"
 
 // Global struct containing our emulated hardware status
 PCE_t PCE;
@@ -579,6 +580,8 @@ pce_writeIO(uint16_t A, uint8_t V)
 		break;
 
 	case 0x0800:                /* PSG */
+		// samples before the write are rendered with the old state
+		psg_sync();
 		switch (A & 15) {
 		case 0:                                 // Select PSG channel
 			PCE.PSG.ch = MIN(V & 7, 5);
@@ -23,6 +23,14 @@ typedef int16_t sample_t;
 static int samplerate = 22050;
 static int stereo = true;
 
+// frame rendered by psg_sync()/psg_frame(), stereo samples
+#define FRAME_MAX_SAMPLES 1024
+static int16_t frame_buffer[FRAME_MAX_SAMPLES * 2];
+static size_t frame_pos = 0;   // samples rendered so far
+static size_t frame_len = 0;   // samples of this frame
+static int frame_frac = 0;     // samplerate remainder, in 1/60 samples
+static bool frame_mode = false;
+
 
 static inline void
 psg_update_chan(sample_t *buf, int ch, size_t dwSize)
@@ -221,3 +229,52 @@ __time_critical_func(psg_update)(int16_t *output, size_t length, uint32_t channe
 		}
 	}
 }
+
+
+static void
+psg_frame_start(void)
+{
+	frame_frac += samplerate;
+	frame_len = frame_frac / 60;
+	frame_frac -= frame_len * 60;
+	if (frame_len > FRAME_MAX_SAMPLES)
+		frame_len = FRAME_MAX_SAMPLES;
+	frame_pos = 0;
+}
+
+
+void
+psg_sync(void)
+{
+	if (!frame_mode)
+		return;
+
+	// cycle of the frame, from the scanline and the CPU cycles of the line
+	int cpl = PCE.Timer.cycles_per_line;
+	uint32_t cycle = PCE.Scanline * cpl + PCE.Cycles;
+	size_t pos = MIN((uint64_t)cycle * frame_len / (263 * cpl), frame_len);
+
+	if (pos > frame_pos) {
+		psg_update(&frame_buffer[frame_pos * (stereo ? 2 : 1)], pos - frame_pos, 0xff);
+		frame_pos = pos;
+	}
+}
+
+
+size_t
+psg_frame(int16_t **output)
+{
+	if (!frame_mode) {
+		frame_mode = true;
+		psg_frame_start();
+	}
+
+	if (frame_len > frame_pos) {
+		psg_update(&frame_buffer[frame_pos * (stereo ? 2 : 1)], frame_len - frame_pos, 0xff);
+	}
+	*output = frame_buffer;
+	size_t len = frame_len;
+
+	psg_frame_start();
+	return len;
+}
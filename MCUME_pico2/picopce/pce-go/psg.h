@@ -6,3 +6,9 @@
 int psg_init(int samplerate, bool stereo);
 void psg_term(void);
 void psg_update(int16_t *output, size_t length, uint32_t channels);
+// Rendering from the emulation loop instead of the audio callback:
+// psg_sync() renders the samples due up to the current CPU cycle and is
+// called before each register write, psg_frame() completes the frame
+// and returns it. Register writes are only synced once psg_frame() is used.
+void psg_sync(void);
+size_t psg_frame(int16_t **output);
@@ -76,6 +76,7 @@ int main(void) {
         uint16_t bClick = emu_DebounceLocalKeys();
         emu_Input(bClick);  
         emu_Step();               
+        emu_StateHotkeys();
     }
 }
 
@@ -84,6 +85,7 @@ void emu_SetPaletteEntry(unsigned char r, unsigned char g, unsigned char b, int
 {
     if (index<PALETTE_SIZE) {
         palette16[index]  = RGBVAL16(r,g,b);        
+        tft.invalidatePalette(index);
     }
 }
 
@@ -188,6 +190,13 @@ void emu_sndPlayBuzz(int size, int val) {
   mymixer.buzz(size,val); 
 }
 
+#ifdef SND_RING
+int emu_sndPush(short * stream, int len)
+{
+  return mymixer.push(stream, len);
+}
+#endif
+
 #endif
 
 
@@ -63,6 +63,9 @@ void sms_Input(int click) {
 
 
 
+// false when the rom could not be read, nothing is emulated
+static bool rom_loaded = false;
+
 void sms_Start(char * filename)
 {
   emu_printf("load and init");  
@@ -85,9 +88,16 @@ void sms_Start(char * filename)
     }
     emu_FileClose(f);
   }
+  // read error or corrupt archive
+  if (size != (int)emu_FileSize(filename)) size = 0;
 #else
   int size = flash_load(filename);
 #endif
+  if (!size) {
+    emu_printf("rom load failed");
+    return;
+  }
+  rom_loaded = true;
 
 
 
@@ -125,6 +135,7 @@ void sms_Start(char * filename)
 
 void sms_Step(void) 
 {
+  if (!rom_loaded) return;
   input.pad[0]=0;
 
   if (( k & MASK_JOY1_RIGHT) || ( k & MASK_JOY2_RIGHT)) {
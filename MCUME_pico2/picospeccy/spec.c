@@ -76,7 +76,7 @@ const byte map_qw[8][5] = {
     { 5,17,16,225,44}, // bnm <symbshift=RSHift> <space>
 };
 
-static byte Z80_RAM[0xC000];                    // 48k RAM
+byte Z80_RAM[0xC000];                           // 48k RAM
 static Z80 myCPU;
 static byte * volatile VRAM=Z80_RAM;            // What will be displayed. Generally ZX VRAM, can be changed for alt screens.
 
@@ -7,10 +7,11 @@
 // Web      : www.mikrocontroller-4u.de
 //--------------------------------------------------------------
 #include "zx_filetyp_z80.h"
-//#include "emuapi.h"
+#include "emuapi.h"
 
 //-------------------------------------------------------------
 extern uint8_t out_ram;
+extern uint8_t Z80_RAM[0xC000];
 
 //--------------------------------------------------------------
 // interne Funktionen
@@ -21,62 +22,53 @@ const uint8_t* p_decompFlashBlock(const uint8_t *block_adr);
 void ZX_ReadFromFlash_SNA(Z80 *regs, const char * filename)
 {
   uint8_t snafile[27];
-  if (emu_FileOpen(filename)) {
-    if (emu_FileRead(&snafile[0], sizeof(snafile)) == sizeof(snafile)) {
-      // Load Z80 registers from SNA
-      regs->I        = snafile[ 0];
-      regs->HL1.B.l  = snafile[ 1];
-      regs->HL1.B.h  = snafile[ 2];
-      regs->DE1.B.l  = snafile[ 3];
-      regs->DE1.B.h  = snafile[ 4];
-      regs->BC1.B.l  = snafile[ 5];
-      regs->BC1.B.h  = snafile[ 6];
-      regs->AF1.B.l  = snafile[ 7];
-      regs->AF1.B.h  = snafile[ 8];
-      regs->HL.B.l   = snafile[ 9];
-      regs->HL.B.h   = snafile[10];
-      regs->DE.B.l   = snafile[11];
-      regs->DE.B.h   = snafile[12];
-      regs->BC.B.l   = snafile[13];
-      regs->BC.B.h   = snafile[14];
-      regs->IY.B.l = snafile[15];
-      regs->IY.B.h = snafile[16];
-      regs->IX.B.l = snafile[17];
-      regs->IX.B.h = snafile[18];
+  if (emu_FileLoad(filename, 0, &snafile[0], sizeof(snafile)) == sizeof(snafile)) {
+    // Load Z80 registers from SNA
+    regs->I        = snafile[ 0];
+    regs->HL1.B.l  = snafile[ 1];
+    regs->HL1.B.h  = snafile[ 2];
+    regs->DE1.B.l  = snafile[ 3];
+    regs->DE1.B.h  = snafile[ 4];
+    regs->BC1.B.l  = snafile[ 5];
+    regs->BC1.B.h  = snafile[ 6];
+    regs->AF1.B.l  = snafile[ 7];
+    regs->AF1.B.h  = snafile[ 8];
+    regs->HL.B.l   = snafile[ 9];
+    regs->HL.B.h   = snafile[10];
+    regs->DE.B.l   = snafile[11];
+    regs->DE.B.h   = snafile[12];
+    regs->BC.B.l   = snafile[13];
+    regs->BC.B.h   = snafile[14];
+    regs->IY.B.l = snafile[15];
+    regs->IY.B.h = snafile[16];
+    regs->IX.B.l = snafile[17];
+    regs->IX.B.h = snafile[18];
  //#define IFF_1       0x01       /* IFF1 flip-flop             */
 //#define IFF_IM1     0x02       /* 1: IM1 mode                */
 //#define IFF_IM2     0x04       /* 1: IM2 mode                */
 //#define IFF_2       0x08       /* IFF2 flip-flop             */
 //#define IFF_EI      0x20       /* 1: EI pending              */
 //#define IFF_HALT    0x80       /* 1: CPU HALTed              */
-      regs->R = snafile[20]; //R.W
-      regs->AF.B.l = snafile[21];
-      regs->AF.B.h = snafile[22];
-      regs->SP.B.l =snafile[23];
-      regs->SP.B.h =snafile[24];
-      regs->IFF = 0;
-      regs->IFF |= (((snafile[19]&0x04) >>2)?IFF_1:0); //regs->IFF1 = regs->IFF2 = ...
-      regs->IFF |= (((snafile[19]&0x04) >>2)?IFF_2:0);
-      regs->IFF |= (snafile[25]<< 1); // regs->IM = snafile[25];
-      //regs->BorderColor = snafile[26];
+    regs->R = snafile[20]; //R.W
+    regs->AF.B.l = snafile[21];
+    regs->AF.B.h = snafile[22];
+    regs->SP.B.l =snafile[23];
+    regs->SP.B.h =snafile[24];
+    regs->IFF = 0;
+    regs->IFF |= (((snafile[19]&0x04) >>2)?IFF_1:0); //regs->IFF1 = regs->IFF2 = ...
+    regs->IFF |= (((snafile[19]&0x04) >>2)?IFF_2:0);
+    regs->IFF |= (snafile[25]<< 1); // regs->IM = snafile[25];
+    //regs->BorderColor = snafile[26];
 
-      
+    
 
-      // load RAM from SNA
-      int direc;
-      uint8_t b;
-      for (direc=0;direc!=0xbfff;direc++)
-      {
-        emu_FileRead(&b, 1);
-        WrZ80(direc+0x4000, b);
-      }
-      emu_FileClose();
-      // SP to PC for SNA run
-      regs->PC.B.l = RdZ80(regs->SP.W);
-      regs->SP.W++;
-      regs->PC.B.h = RdZ80(regs->SP.W);
-      regs->SP.W++;                    
-    }  
+    // load RAM from SNA, 0x4000-0xffff
+    emu_FileLoad(filename, sizeof(snafile), Z80_RAM, 0xC000);
+    // SP to PC for SNA run
+    regs->PC.B.l = RdZ80(regs->SP.W);
+    regs->SP.W++;
+    regs->PC.B.h = RdZ80(regs->SP.W);
+    regs->SP.W++;                    
   }
 }
 
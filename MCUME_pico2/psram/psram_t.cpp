@@ -5,24 +5,35 @@
 #include "psram_t.h"
 
 #include <cstdio>
+#include <cstring>
 
+#ifdef PSRAM_HOST
+#include <cstdlib>
+#ifndef PSRAM_HOST_SIZE
+#define PSRAM_HOST_SIZE (8*1024*1024)
+#endif
+static uint8_t * hostmem = NULL;
+#else
 #include <pico/stdlib.h>
 
 #include "psram_spi.h"
+#endif
 
-#ifdef PSCACHE 
-Page PSRAM_T::pages[MAX_PAGES];
-uint8_t PSRAM_T::nbPages=0;
-int8_t PSRAM_T::top=0;
-int8_t PSRAM_T::last=0;
+#ifdef PSCACHE
+PSCacheLine PSRAM_T::lines[PSCACHE_SETS][PSCACHE_WAYS];
+uint32_t PSRAM_T::clock=0;
+uint32_t PSRAM_T::lastMiss=PSCACHE_INVALID;
 #endif
+PSRAM_Stats PSRAM_T::counters;
 
 
 #define RAM_READ  0xB
 //#define RAM_READ  0x3
 #define RAM_WRITE 0x2
 
+#ifndef PSRAM_HOST
 static psram_spi_inst_t psram_spi;
+#endif
 
 
 PSRAM_T::PSRAM_T(uint8_t cs, uint8_t mosi, uint8_t sclk, uint8_t miso)
@@ -31,192 +42,269 @@ PSRAM_T::PSRAM_T(uint8_t cs, uint8_t mosi, uint8_t sclk, uint8_t miso)
 
 void PSRAM_T::begin(void)
 {
+#ifdef PSRAM_HOST
+  if (hostmem == NULL) hostmem = (uint8_t *)calloc(PSRAM_HOST_SIZE, 1);
+#else
   psram_spi = psram_spi_init(pio2, 0);
+#endif
+#ifdef PSCACHE
+  for (int s=0; s<PSCACHE_SETS; s++) {
+    for (int w=0; w<PSCACHE_WAYS; w++) {
+      lines[s][w].tag = PSCACHE_INVALID;
+      lines[s][w].stamp = 0;
+      lines[s][w].dirty = 0;
+    }
+  }
+  clock = 0;
+  lastMiss = PSCACHE_INVALID;
+#endif
+  resetStats();
+}
+
+void PSRAM_T::resetStats(void)
+{
+  memset(&counters, 0, sizeof(counters));
+}
+
+
+#ifdef PSRAM_HOST
+uint8_t PSRAM_T::psram_read(uint32_t addr)
+{
+  return hostmem[addr % PSRAM_HOST_SIZE];
+}
+
+uint16_t PSRAM_T::psram_read_w(uint32_t addr)
+{
+  return psram_read(addr) | (psram_read(addr+1)<<8);
+}
+
+void PSRAM_T::psram_read_n(uint32_t addr, uint8_t * val, int n)
+{
+  while (n--) *val++ = psram_read(addr++);
+}
+
+void PSRAM_T::psram_write(uint32_t addr, uint8_t val)
+{
+  hostmem[addr % PSRAM_HOST_SIZE] = val;
 }
 
+void PSRAM_T::psram_write_w(uint32_t addr, uint16_t val)
+{
+  psram_write(addr, val & 0xff);
+  psram_write(addr+1, val >> 8);
+}
 
-uint8_t PSRAM_T::psram_read(uint32_t addr) 
+void PSRAM_T::psram_write_n(uint32_t addr, uint8_t * val, int n)
+{
+  while (n--) psram_write(addr++, *val++);
+}
+#else
+uint8_t PSRAM_T::psram_read(uint32_t addr)
 {
   return psram_read8(&psram_spi, addr);
 }
 
-uint16_t PSRAM_T::psram_read_w(uint32_t addr) 
+uint16_t PSRAM_T::psram_read_w(uint32_t addr)
 {
   return psram_read16(&psram_spi, addr);
 }
 
 
-void PSRAM_T::psram_read_n(uint32_t addr, uint8_t * val, int n) 
+void PSRAM_T::psram_read_n(uint32_t addr, uint8_t * val, int n)
 {
   //printf("r %d %d\n", addr, n);
-  psram_readn(&psram_spi, addr, val, n); 
+  psram_readn(&psram_spi, addr, val, n);
 }
 
 
-void PSRAM_T::psram_write(uint32_t addr, uint8_t val) 
+void PSRAM_T::psram_write(uint32_t addr, uint8_t val)
 {
-  psram_write8(&psram_spi, addr, val); 
+  psram_write8(&psram_spi, addr, val);
 }
 
-void PSRAM_T::psram_write_w(uint32_t addr, uint16_t val) 
+void PSRAM_T::psram_write_w(uint32_t addr, uint16_t val)
 {
-  psram_write16(&psram_spi, addr, val); 
+  psram_write16(&psram_spi, addr, val);
 }
 
-static uint8_t resp[PAGE_SIZE];
-
-
-void PSRAM_T::psram_write_n(uint32_t addr, uint8_t * val, int n) 
+void PSRAM_T::psram_write_n(uint32_t addr, uint8_t * val, int n)
 {
-  printf("w %d %d\n", addr, n);
-  psram_writen(&psram_spi, addr, val, n);  
+  //printf("w %d %d\n", addr, n);
+  psram_writen(&psram_spi, addr, val, n);
 }
+#endif
 
 
+#ifdef PSCACHE
 
+// Fold upper line bits into the set index so that strided accesses
+// (e.g. 64KB segments of the 8086) do not all land in the same set
+#define PSCACHE_SET(line) (((line) ^ ((line) >> 5) ^ ((line) >> 11)) & (PSCACHE_SETS-1))
 
+static uint8_t prefetchbuf[2*PSCACHE_LINE_SIZE];
 
-void PSRAM_T::pswrite(uint32_t addr, uint8_t val) 
+PSCacheLine * PSRAM_T::lookup(uint32_t line)
 {
-  psram_write(addr, val);
-#ifdef PSCACHE  
-  uint32_t curPage=addr&(~(PAGE_SIZE-1));
-  for (int i=0; i<nbPages; i++) {
-    if (pages[i].pageid == curPage) {
-      pages[i].page[addr&(PAGE_SIZE-1)] = val;
-      break;
-    }
-  }  
-#endif   
+  PSCacheLine * set = lines[PSCACHE_SET(line)];
+  for (int w=0; w<PSCACHE_WAYS; w++) {
+    if (set[w].tag == line) return &set[w];
+  }
+  return NULL;
 }
 
+PSCacheLine * PSRAM_T::victim(uint32_t line)
+{
+  PSCacheLine * set = lines[PSCACHE_SET(line)];
+  PSCacheLine * l = &set[0];
+  for (int w=0; w<PSCACHE_WAYS; w++) {
+    if (set[w].tag == PSCACHE_INVALID) return &set[w];
+    if (set[w].stamp < l->stamp) l = &set[w];
+  }
+  return l;
+}
+
+void PSRAM_T::evict(PSCacheLine * l)
+{
+  if (l->tag == PSCACHE_INVALID) return;
+  counters.evictions++;
+  if (l->dirty) {
+    psram_write_n(l->tag*PSCACHE_LINE_SIZE, l->data, PSCACHE_LINE_SIZE);
+    counters.writebacks++;
+    l->dirty = 0;
+  }
+  l->tag = PSCACHE_INVALID;
+}
 
+static inline uint32_t touch(uint32_t & clock)
+{
+  if (++clock == 0) clock = 1;
+  return clock;
+}
 
+PSCacheLine * PSRAM_T::fill(uint32_t line)
+{
+  counters.misses++;
+  PSCacheLine * l = victim(line);
+  evict(l);
+#if PSCACHE_PREFETCH
+  bool sequential = (line == lastMiss+1);
+  lastMiss = line;
+  if ( (sequential) && (lookup(line+1) == NULL) ) {
+    // one SPI transaction for both lines
+    psram_read_n(line*PSCACHE_LINE_SIZE, prefetchbuf, 2*PSCACHE_LINE_SIZE);
+    memcpy(l->data, prefetchbuf, PSCACHE_LINE_SIZE);
+    l->tag = line;
+    l->stamp = touch(clock);
+    PSCacheLine * p = victim(line+1);
+    if (p != l) {
+      evict(p);
+      memcpy(p->data, prefetchbuf+PSCACHE_LINE_SIZE, PSCACHE_LINE_SIZE);
+      p->tag = line+1;
+      // not yet used, rank it just below the requested line
+      p->stamp = l->stamp - 1;
+      counters.prefetches++;
+    }
+    return l;
+  }
+#endif
+  psram_read_n(line*PSCACHE_LINE_SIZE, l->data, PSCACHE_LINE_SIZE);
+  l->tag = line;
+  l->stamp = touch(clock);
+  return l;
+}
 
-uint8_t PSRAM_T::psread(uint32_t addr) 
+inline PSCacheLine * PSRAM_T::get(uint32_t line)
 {
-#ifdef PSCACHE  
-  uint32_t curPage=addr&(~(PAGE_SIZE-1));
-  uint32_t offs = addr&(PAGE_SIZE-1);
+  PSCacheLine * l = lookup(line);
+  if (l == NULL) return fill(line);
+  counters.hits++;
+  l->stamp = touch(clock);
+  return l;
+}
 
-  for (int i=0; i<nbPages; i++) {
-    if (pages[i].pageid == curPage) {
-      if ( (pages[i].prev != i) && (pages[i].next != i) ) {
-        pages[pages[i].prev].next =  pages[i].next;
-        pages[pages[i].next].prev = pages[i].prev;     
-      }
-      else if (pages[i].next != i) {
-        pages[pages[i].next].prev = i;
-      }
-      else if (pages[i].prev != i) {
-        pages[pages[i].prev].next =  pages[i].prev;
-        last = pages[i].prev;        
+#endif
+
+void PSRAM_T::flush(void)
+{
+#ifdef PSCACHE
+  for (int s=0; s<PSCACHE_SETS; s++) {
+    for (int w=0; w<PSCACHE_WAYS; w++) {
+      PSCacheLine * l = &lines[s][w];
+      if ( (l->tag != PSCACHE_INVALID) && (l->dirty) ) {
+        psram_write_n(l->tag*PSCACHE_LINE_SIZE, l->data, PSCACHE_LINE_SIZE);
+        counters.writebacks++;
+        l->dirty = 0;
       }
-       // last page accessed to top
-      pages[i].prev = i; //-1;
-      pages[i].next = top;      
-      pages[top].prev = i;
-      top = i;
-      return pages[top].page[offs];
     }
   }
-  if (nbPages<MAX_PAGES) 
-  {
-    // add at top
-    pages[nbPages].pageid = curPage;           
-    pages[nbPages].prev = nbPages; //-1;
-    pages[nbPages].next = top;     
-    pages[top].prev = nbPages;
-    top = nbPages;
-    nbPages++;
-  }
-  else {
-      // replace last and move to top
-      int n = pages[last].prev;
-      pages[n].next = n; //-1;
-      pages[last].pageid = curPage;
-      pages[last].prev = last; //-1;
-      pages[last].next = top;      
-      pages[top].prev = last;
-      top = last;
-      last = n;
+#endif
+}
+
+void PSRAM_T::invalidate(void)
+{
+  flush();
+#ifdef PSCACHE
+  for (int s=0; s<PSCACHE_SETS; s++) {
+    for (int w=0; w<PSCACHE_WAYS; w++) {
+      lines[s][w].tag = PSCACHE_INVALID;
+    }
   }
-  //emu_printi(curPage);
-  psram_read_n(curPage,&(pages[top].page[0]),PAGE_SIZE);   
-  return pages[top].page[offs];
+  lastMiss = PSCACHE_INVALID;
+#endif
+}
+
+
+void PSRAM_T::pswrite(uint32_t addr, uint8_t val)
+{
+#ifdef PSCACHE
+  PSCacheLine * l = get(addr/PSCACHE_LINE_SIZE);
+  l->data[addr&(PSCACHE_LINE_SIZE-1)] = val;
+  l->dirty = 1;
+#else
+  psram_write(addr, val);
+#endif
+}
+
+uint8_t PSRAM_T::psread(uint32_t addr)
+{
+#ifdef PSCACHE
+  PSCacheLine * l = get(addr/PSCACHE_LINE_SIZE);
+  return l->data[addr&(PSCACHE_LINE_SIZE-1)];
 #else
   return psram_read(addr);
 #endif
 }
 
-uint16_t PSRAM_T::psread_w(uint32_t addr) 
+uint16_t PSRAM_T::psread_w(uint32_t addr)
 {
 #ifdef PSCACHE
-  uint32_t curPage=addr&(~(PAGE_SIZE-1));
-  uint32_t offs = addr&(PAGE_SIZE-1);
-
-  for (int i=0; i<nbPages; i++) {
-    if (pages[i].pageid == curPage) {
-      if ( (pages[i].prev != i) && (pages[i].next != i) ) {
-        pages[pages[i].prev].next =  pages[i].next;
-        pages[pages[i].next].prev = pages[i].prev;     
-      }
-      else if (pages[i].next != i) {
-        pages[pages[i].next].prev = i;
-      }
-      else if (pages[i].prev != i) {
-        pages[pages[i].prev].next =  pages[i].prev;
-        last = pages[i].prev;        
-      }
-       // last page accessed to top
-      pages[i].prev = i; //-1;
-      pages[i].next = top;      
-      pages[top].prev = i;
-      top = i;     
-      return (pages[top].page[offs+1]<<8) + pages[top].page[offs];
-    }
+  uint32_t offs = addr&(PSCACHE_LINE_SIZE-1);
+  if (offs == (PSCACHE_LINE_SIZE-1)) {
+    // straddles 2 lines
+    return psread(addr) | (psread(addr+1)<<8);
   }
-  if (nbPages<MAX_PAGES) 
-  {
-    // add at top
-    pages[nbPages].pageid = curPage;           
-    pages[nbPages].prev = nbPages; //-1;
-    pages[nbPages].next = top;     
-    pages[top].prev = nbPages;
-    top = nbPages;
-    nbPages++;
-  }
-  else {
-      // replace last and move to top
-      int n = pages[last].prev;
-      pages[n].next = n; //-1;
-      pages[last].pageid = curPage;
-      pages[last].prev = last; //-1;
-      pages[last].next = top;      
-      pages[top].prev = last;
-      top = last;
-      last = n;
-  }
-  //emu_printi(curPage);
-  psram_read_n(curPage,&(pages[top].page[0]),PAGE_SIZE);   
-  return (pages[top].page[offs+1]<<8) + pages[top].page[offs];
+  PSCacheLine * l = get(addr/PSCACHE_LINE_SIZE);
+  return (l->data[offs+1]<<8) + l->data[offs];
 #else
   return psram_read_w(addr);
-#endif  
+#endif
 }
 
 void PSRAM_T::pswrite_w(uint32_t addr, uint16_t val)
 {
-  psram_write_w(addr, val);
-#ifdef PSCACHE 
-  uint32_t curPage=addr&(~(PAGE_SIZE-1));
-  for (int i=0; i<nbPages; i++) {
-    if (pages[i].pageid == curPage) {
-      pages[i].page[addr&(PAGE_SIZE-1)] = val&0xff;
-      pages[i].page[(addr+1)&(PAGE_SIZE-1)] = val>>8 ;
-      break;
-    }
+#ifdef PSCACHE
+  uint32_t offs = addr&(PSCACHE_LINE_SIZE-1);
+  if (offs == (PSCACHE_LINE_SIZE-1)) {
+    pswrite(addr, val&0xff);
+    pswrite(addr+1, val>>8);
+    return;
   }
+  PSCacheLine * l = get(addr/PSCACHE_LINE_SIZE);
+  l->data[offs] = val&0xff;
+  l->data[offs+1] = val>>8;
+  l->dirty = 1;
+#else
+  psram_write_w(addr, val);
 #endif
 }
 
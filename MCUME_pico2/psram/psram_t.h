@@ -7,23 +7,46 @@
 
 #ifdef __cplusplus
 
+#ifdef PSRAM_HOST
+#include <stdint.h>
+#else
 #include "pico.h"
 #include "pico/stdlib.h"
+#endif
 
 #define PSCACHE 1
 
-//#define PAGE_SIZE    16 //32 //2048 //1024
-//#define MAX_PAGES    8
+// Cache geometry, can be overruled per core (program_config.h or compile definitions)
+// LINE_SIZE and SETS must be power of 2
+#ifndef PSCACHE_LINE_SIZE
+#define PSCACHE_LINE_SIZE   32
+#endif
+#ifndef PSCACHE_WAYS
+#define PSCACHE_WAYS        4
+#endif
+#ifndef PSCACHE_SETS
+#define PSCACHE_SETS        16
+#endif
+// fetch next line together with a miss that follows a sequential miss
+#ifndef PSCACHE_PREFETCH
+#define PSCACHE_PREFETCH    1
+#endif
 
-#define PAGE_SIZE    16 //32 //2048 //1024
-#define MAX_PAGES    8
+#define PSCACHE_INVALID     0xffffffff
 
+struct PSCacheLine {
+   uint8_t  data[PSCACHE_LINE_SIZE];
+   uint32_t tag;      // line number (addr/PSCACHE_LINE_SIZE) or PSCACHE_INVALID
+   uint32_t stamp;    // last access, lowest is evicted first
+   uint8_t  dirty;
+};
 
-struct Page {
-   uint8_t  page[PAGE_SIZE];
-   uint32_t pageid;
-   int8_t next;
-   int8_t prev;
+struct PSRAM_Stats {
+   uint32_t hits;
+   uint32_t misses;
+   uint32_t evictions;
+   uint32_t writebacks;
+   uint32_t prefetches;
 };
 
 class PSRAM_T
@@ -35,21 +58,36 @@ class PSRAM_T
     uint8_t psread(uint32_t addr);
     uint16_t psread_w(uint32_t addr);
     void pswrite_w(uint32_t addr, uint16_t val);
-   
+    // write back all dirty lines
+    void flush(void);
+    // flush and drop all lines
+    void invalidate(void);
+    static const PSRAM_Stats & stats(void) { return counters; }
+    static void resetStats(void);
+
   private:
     static uint8_t psram_read(uint32_t addr);
     static uint16_t psram_read_w(uint32_t addr);
     static void psram_read_n(uint32_t addr, uint8_t * val, int n);
     static void psram_write(uint32_t addr, uint8_t val);
-    static void psram_write_w(uint32_t addr, uint16_t val); 
+    static void psram_write_w(uint32_t addr, uint16_t val);
     static void psram_write_n(uint32_t addr, uint8_t * val, int n);
-   
+#ifdef PSCACHE
+    static PSCacheLine * lookup(uint32_t line);
+    static PSCacheLine * victim(uint32_t line);
+    static void evict(PSCacheLine * l);
+    static PSCacheLine * fill(uint32_t line);
+    static PSCacheLine * get(uint32_t line);
+#endif
+
   protected:
     static uint8_t _cs, _miso, _mosi, _sclk;
-    static Page pages[MAX_PAGES];
-    static uint8_t nbPages;
-    static int8_t top;
-    static int8_t last;
+#ifdef PSCACHE
+    static PSCacheLine lines[PSCACHE_SETS][PSCACHE_WAYS];
+    static uint32_t clock;
+    static uint32_t lastMiss;
+#endif
+    static PSRAM_Stats counters;
 };
 #endif
 
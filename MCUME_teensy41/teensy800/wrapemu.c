@@ -183,14 +183,13 @@ static void load_CART(char * cartname)
   int flen = emu_FileSize(cartname);
   int f = emu_FileOpen(cartname, "r+b");
   if (flen < 16384) {
-    //emu_FileRead(&memory[0xA000], flen, f);
     emu_printf("8k");
-    for(int i=0; i<flen; i++) memory[0xA000 + i] = emu_FileGetc(f);    
+    // the 8K window, a bigger file would overrun the memory behind it
+    emu_FileRead(&memory[0xA000], (flen < 0x2000) ? flen : 0x2000, f);
   }
   else {
     emu_printf("16k");    
-    //emu_FileRead(&memory[0x8000], flen, f);
-    for(int i=0; i<flen; i++) memory[0x8000 + i] = emu_FileGetc(f);
+    emu_FileRead(&memory[0x8000], 0x4000, f);
   }
 
   emu_FileClose(f); 
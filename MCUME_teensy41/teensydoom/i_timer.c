@@ -67,6 +67,11 @@ int I_GetTimeMS(void)
     return ticks - basetime;
 }
 
+int I_GetTimeUS(void)
+{
+    return SDL_GetTicks() * 1000;
+}
+
 // Sleep for a specified number of ms
 
 void I_Sleep(int ms)
@@ -92,6 +97,7 @@ void I_InitTimer(void)
 extern "C" {
 #endif
 extern void emu_GetTimeOfDay(int * usec, int * sec);
+extern int emu_GetTimeUS(void);
 #ifdef __cplusplus  
 }
 #endif
@@ -138,6 +144,15 @@ int I_GetTimeMS(void)
   return now;
 }
 
+//
+// Free running microsecond counter, for timing measures only
+//
+
+int I_GetTimeUS(void)
+{
+  return emu_GetTimeUS();
+}
+
 // Sleep for a specified number of ms
 
 void I_Sleep(int ms)
@@ -29,6 +29,9 @@ int I_GetTime (void);
 // returns current time in ms
 int I_GetTimeMS (void);
 
+// returns a free running time in us, wraps around
+int I_GetTimeUS (void);
+
 // Pause for a specified number of ms
 void I_Sleep(int ms);
 
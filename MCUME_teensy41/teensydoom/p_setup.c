@@ -836,6 +836,9 @@ P_SetupLevel
 	R_PrecacheLevel ();
 
     //printf ("free memory: 0x%x\n", Z_FreeMemory());
+#ifdef HAS_PRINTF
+    Z_DumpStats ();
+#endif
 
 }
 
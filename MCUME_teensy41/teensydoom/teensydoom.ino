@@ -216,6 +216,8 @@ void emu_KeyboardOnUp(int keymodifer, int key) {
 
 
 EXTMEM  unsigned char MemPool[8*1024*1024];
+// WAD copy (w_file_mem.c), outside of the extmem_malloc() pool
+EXTMEM  unsigned char WadPool[7*1024*1024] __attribute__((aligned(32)));
 
 
 extern "C" void emu_GetTimeOfDay(int * usec, int * sec) {
@@ -225,3 +227,7 @@ extern "C" void emu_GetTimeOfDay(int * usec, int * sec) {
   * usec = lusec;
   * sec = lsec;
 }
+
+extern "C" int emu_GetTimeUS(void) {
+  return micros();
+}
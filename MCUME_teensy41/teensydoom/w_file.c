@@ -28,6 +28,7 @@
 #undef _WIN32
 
 extern wad_file_class_t stdc_wad_file;
+extern wad_file_class_t mem_wad_file;
 
 #ifdef _WIN32
 extern wad_file_class_t win32_wad_file;
@@ -53,6 +54,20 @@ wad_file_t *W_OpenFile(char *path)
     wad_file_t *result;
     int i;
 
+    //!
+    // Read the WADs from the card instead of copying them to PSRAM.
+    //
+
+    if (!M_CheckParm("-nopsram"))
+    {
+        result = mem_wad_file.OpenFile(path);
+
+        if (result != NULL)
+        {
+            return result;
+        }
+    }
+
     //!
     // Use the OS's virtual memory subsystem to map WAD files
     // directly into memory.
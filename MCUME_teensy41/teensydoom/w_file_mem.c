@@ -0,0 +1,288 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	WAD I/O functions, WAD copied once into a PSRAM pool of its own
+//	(WadPool, an EXTMEM array next to the zone) and mapped from there.
+//	The PSRAM keeps its content over a warm reset: a copy already
+//	there is reused if its checksum and its lump directory match.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "m_misc.h"
+#include "w_file.h"
+#include "z_zone.h"
+#include "i_swap.h"
+#include "i_system.h"
+
+#include "ff.h"
+
+#define MEM_WAD_MAGIC   0x4d574431  // "MWD1"
+#define MEM_WAD_NAME    32
+#define MEM_WAD_HEADER  64          // header space before the data, keeps it aligned
+#define MEM_WAD_CHUNK   32768       // SD reads go straight to PSRAM
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int length;
+    unsigned int sum;
+    char name[MEM_WAD_NAME];
+} mem_wad_header_t;
+
+typedef struct
+{
+    wad_file_t wad;
+    byte *slot;
+} mem_wad_file_t;
+
+extern wad_file_class_t mem_wad_file;
+
+#if defined(ARDUINO_TEENSY41)
+#include "imxrt.h"
+extern uint8_t external_psram_size;
+extern unsigned char WadPool[7*1024*1024];
+// PSRAM is cached write-back, what must survive a reset is flushed
+#define W_Mem_Flush(p, n) arm_dcache_flush((void *) (p), (n))
+#else
+#define W_Mem_Flush(p, n)
+#endif
+
+static byte *mem_next = NULL;
+static byte *mem_end = NULL;
+
+static void W_Mem_Region(void)
+{
+#if defined(ARDUINO_TEENSY41)
+    // The pool is only there when the PSRAM is large enough for it.
+    if (mem_next == NULL && (unsigned int) (WadPool + sizeof(WadPool))
+        <= 0x70000000 + external_psram_size * 1024 * 1024)
+    {
+        mem_next = (byte *) (((unsigned int) WadPool + 31) & ~31);
+        mem_end = WadPool + sizeof(WadPool);
+    }
+#endif
+}
+
+static unsigned int W_Mem_Sum(byte *data, unsigned int length)
+{
+    // FNV-1a over words, the slot data is 32 bytes aligned
+    unsigned int h = 2166136261u;
+    unsigned int *pt = (unsigned int *) data;
+    unsigned int i;
+
+    for (i = 0; i < length / 4; ++i)
+    {
+        h = (h ^ pt[i]) * 16777619;
+    }
+    for (i = length & ~3; i < length; ++i)
+    {
+        h = (h ^ data[i]) * 16777619;
+    }
+
+    return h;
+}
+
+static void W_Mem_Name(char *name, char *path)
+{
+    char *base = strrchr(path, '/');
+
+    base = (base != NULL) ? base + 1 : path;
+    memset(name, 0, MEM_WAD_NAME);
+    M_StringCopy(name, base, MEM_WAD_NAME);
+}
+
+// Compares the WAD header and lump directory of the copy with the
+// ones of the file, they change whenever the content of a WAD does.
+
+static boolean W_Mem_SameDirectory(FIL *file, byte *data, unsigned int length)
+{
+    byte buf[512];
+    unsigned int count;
+    unsigned int offset, end;
+
+    f_lseek(file, 0);
+    if (f_readn(file, buf, 12, &count) != FR_OK || count != 12
+     || memcmp(buf, data, 12) != 0)
+    {
+        return false;
+    }
+
+    offset = LONG(*(int *) (buf + 8));
+    end = offset + LONG(*(int *) (buf + 4)) * 16;
+    if (offset > length || end > length || end < offset)
+    {
+        return false;
+    }
+
+    f_lseek(file, offset);
+    while (offset < end)
+    {
+        unsigned int len = end - offset;
+
+        if (len > sizeof(buf))
+        {
+            len = sizeof(buf);
+        }
+        if (f_readn(file, buf, len, &count) != FR_OK || count != len
+         || memcmp(buf, data + offset, len) != 0)
+        {
+            return false;
+        }
+        offset += len;
+    }
+
+    return true;
+}
+
+static boolean W_Mem_Load(FIL *file, byte *data, unsigned int length)
+{
+    unsigned int offset, count;
+
+    f_lseek(file, 0);
+    for (offset = 0; offset < length; offset += count)
+    {
+        unsigned int len = length - offset;
+
+        if (len > MEM_WAD_CHUNK)
+        {
+            len = MEM_WAD_CHUNK;
+        }
+        if (f_readn(file, data + offset, len, &count) != FR_OK || count != len)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static wad_file_t *W_Mem_OpenFile(char *path)
+{
+    mem_wad_file_t *result;
+    mem_wad_header_t *header;
+    char name[MEM_WAD_NAME];
+    byte *slot, *data;
+    unsigned int length;
+    FIL file;
+
+    W_Mem_Region();
+    if (mem_next == NULL)
+    {
+        return NULL;
+    }
+
+    if (f_open (&file, path, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    {
+        return NULL;
+    }
+
+    length = M_FileLength(&file);
+    slot = mem_next;
+    data = slot + MEM_WAD_HEADER;
+    if (length == 0 || data + length > mem_end || data + length < data)
+    {
+        // Doesn't fit, read it from the card instead.
+        f_close(&file);
+        return NULL;
+    }
+
+    header = (mem_wad_header_t *) slot;
+    W_Mem_Name(name, path);
+
+    if (header->magic == MEM_WAD_MAGIC && header->length == length
+     && memcmp(header->name, name, MEM_WAD_NAME) == 0
+     && W_Mem_Sum(data, length) == header->sum
+     && W_Mem_SameDirectory(&file, data, length))
+    {
+        printf(" %s: reusing copy in PSRAM\n", name);
+    }
+    else
+    {
+        printf(" %s: copying %u bytes to PSRAM\n", name, length);
+
+        // The header is only valid once all the data is in.
+        header->magic = 0;
+        W_Mem_Flush(header, sizeof(*header));
+        if (!W_Mem_Load(&file, data, length))
+        {
+            f_close(&file);
+            return NULL;
+        }
+        W_Mem_Flush(data, length);
+        header->length = length;
+        header->sum = W_Mem_Sum(data, length);
+        memcpy(header->name, name, MEM_WAD_NAME);
+        header->magic = MEM_WAD_MAGIC;
+        W_Mem_Flush(header, sizeof(*header));
+    }
+
+    f_close(&file);
+
+    mem_next = (byte *) (((unsigned int) (data + length) + 31) & ~31);
+
+    result = Z_Malloc(sizeof(mem_wad_file_t), PU_STATIC, 0);
+    result->wad.file_class = &mem_wad_file;
+    result->wad.mapped = data;
+    result->wad.length = length;
+    result->slot = slot;
+
+    return &result->wad;
+}
+
+static void W_Mem_CloseFile(wad_file_t *wad)
+{
+    mem_wad_file_t *mem_wad;
+
+    mem_wad = (mem_wad_file_t *) wad;
+
+    // The space is given back if this was the last file copied, the copy
+    // is left in place to be reused.
+    if (mem_next == (byte *) (((unsigned int) (wad->mapped + wad->length) + 31) & ~31))
+    {
+        mem_next = mem_wad->slot;
+    }
+
+    Z_Free(mem_wad);
+}
+
+// Read data from the specified position in the file into the
+// provided buffer.  Returns the number of bytes read.
+
+size_t W_Mem_Read(wad_file_t *wad, unsigned int offset,
+                  void *buffer, size_t buffer_len)
+{
+    if (offset >= wad->length)
+    {
+        return 0;
+    }
+    if (buffer_len > wad->length - offset)
+    {
+        buffer_len = wad->length - offset;
+    }
+
+    memcpy(buffer, wad->mapped + offset, buffer_len);
+
+    return buffer_len;
+}
+
+
+wad_file_class_t mem_wad_file =
+{
+    W_Mem_OpenFile,
+    W_Mem_CloseFile,
+    W_Mem_Read,
+};
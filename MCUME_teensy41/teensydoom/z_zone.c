@@ -17,8 +17,11 @@
 //
 
 
+#include <string.h>
+
 #include "z_zone.h"
 #include "i_system.h"
+#include "i_timer.h"
 #include "doomtype.h"
 
 
@@ -27,7 +30,12 @@
 //
 // There is never any space between memblocks,
 //  and there will never be two contiguous free memblocks.
-// The rover can be left pointing at a non-empty block.
+//
+// Free blocks are kept in a list per size class (power of 2), a
+//  bitmap tells which lists are not empty, so allocating and freeing
+//  don't walk the zone.
+// Purgable blocks are kept in a LRU list, the one least recently
+//  allocated or released is purged first when nothing free fits.
 //
 // It is of no value to free a cachable block,
 //  because it will get overwritten automatically if needed.
@@ -36,14 +44,23 @@
 #define MEM_ALIGN sizeof(void *)
 #define ZONEID	0x1d4a11
 
+// size classes: blocks of class c are 2^c to 2^(c+1)-1 bytes
+#define ZONE_CLASSES	32
+
+// free blocks looked at in the class of the size before taking one
+// from a larger class
+#define ZONE_SCAN	16
+
 typedef struct memblock_s
 {
     int			size;	// including the header and possibly tiny fragments
     void**		user;
     int			tag;	// PU_FREE if this is free
     int			id;	// should be ZONEID
-    struct memblock_s*	next;
+    struct memblock_s*	next;	// neighbours in the zone
     struct memblock_s*	prev;
+    struct memblock_s*	lnext;	// free list of its class, or LRU if purgable
+    struct memblock_s*	lprev;
 } memblock_t;
 
 
@@ -55,14 +72,75 @@ typedef struct
     // start / end cap for linked list
     memblock_t	blocklist;
     
-    memblock_t*	rover;
+    memblock_t*	freelist[ZONE_CLASSES];
+    unsigned int freemap;	// bit c set if freelist[c] is not empty
+
+    // start / end cap for the purgable blocks, most recent first
+    memblock_t	lru;
     
 } memzone_t;
 
 
+typedef struct
+{
+    unsigned int allocs;
+    unsigned int alloc_us;	// sum over all allocations
+    unsigned int alloc_max_us;
+    unsigned int purges;
+    unsigned int purged_bytes;
+} zonestats_t;
+
 
 memzone_t*	mainzone;
 
+static zonestats_t zonestats;
+
+
+static int Z_SizeClass (int size)
+{
+    return 31 - __builtin_clz(size);
+}
+
+static void Z_FreeListAdd (memblock_t* block)
+{
+    int c = Z_SizeClass(block->size);
+
+    block->lprev = NULL;
+    block->lnext = mainzone->freelist[c];
+    if (block->lnext)
+        block->lnext->lprev = block;
+    mainzone->freelist[c] = block;
+    mainzone->freemap |= 1u << c;
+}
+
+static void Z_FreeListRemove (memblock_t* block)
+{
+    int c = Z_SizeClass(block->size);
+
+    if (block->lprev)
+        block->lprev->lnext = block->lnext;
+    else
+        mainzone->freelist[c] = block->lnext;
+    if (block->lnext)
+        block->lnext->lprev = block->lprev;
+    if (mainzone->freelist[c] == NULL)
+        mainzone->freemap &= ~(1u << c);
+}
+
+static void Z_LRUAdd (memblock_t* block)
+{
+    block->lprev = &mainzone->lru;
+    block->lnext = mainzone->lru.lnext;
+    block->lnext->lprev = block;
+    mainzone->lru.lnext = block;
+}
+
+static void Z_LRURemove (memblock_t* block)
+{
+    block->lprev->lnext = block->lnext;
+    block->lnext->lprev = block->lprev;
+}
+
 
 
 //
@@ -71,6 +149,7 @@ memzone_t*	mainzone;
 void Z_ClearZone (memzone_t* zone)
 {
     memblock_t*		block;
+    int			c;
 	
     // set the entire zone to one free block
     zone->blocklist.next =
@@ -79,14 +158,21 @@ void Z_ClearZone (memzone_t* zone)
     
     zone->blocklist.user = (void *)zone;
     zone->blocklist.tag = PU_STATIC;
-    zone->rover = block;
+
+    zone->lru.lnext = zone->lru.lprev = &zone->lru;
+    for (c = 0; c < ZONE_CLASSES; c++)
+        zone->freelist[c] = NULL;
+    zone->freemap = 0;
 	
     block->prev = block->next = &zone->blocklist;
     
     // a free block.
     block->tag = PU_FREE;
+    block->user = NULL;
+    block->id = 0;
 
     block->size = zone->size - sizeof(memzone_t);
+    Z_FreeListAdd(block);
 }
 
 
@@ -96,43 +182,30 @@ void Z_ClearZone (memzone_t* zone)
 //
 void Z_Init (void)
 {
-    memblock_t*	block;
     int		size;
 
     mainzone = (memzone_t *)I_ZoneBase (&size);
     mainzone->size = size;
 
-    // set the entire zone to one free block
-    mainzone->blocklist.next =
-	mainzone->blocklist.prev =
-	block = (memblock_t *)( (byte *)mainzone + sizeof(memzone_t) );
-
-    mainzone->blocklist.user = (void *)mainzone;
-    mainzone->blocklist.tag = PU_STATIC;
-    mainzone->rover = block;
-	
-    block->prev = block->next = &mainzone->blocklist;
-
-    // free block
-    block->tag = PU_FREE;
-    
-    block->size = mainzone->size - sizeof(memzone_t);
+    Z_ClearZone(mainzone);
+    memset(&zonestats, 0, sizeof(zonestats));
 }
 
 
 //
-// Z_Free
+// Z_FreeBlock
+// Returns the free block it ended in, after merging with its neighbours.
 //
-void Z_Free (void* ptr)
+static memblock_t* Z_FreeBlock (memblock_t* block)
 {
-    memblock_t*		block;
     memblock_t*		other;
 	
-    block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-
     if (block->id != ZONEID)
 	I_Error ("Z_Free: freed a pointer without ZONEID");
 		
+    if (block->tag >= PU_PURGELEVEL)
+        Z_LRURemove(block);
+
     if (block->tag != PU_FREE && block->user != NULL)
     {
     	// clear the user's mark
@@ -149,13 +222,11 @@ void Z_Free (void* ptr)
     if (other->tag == PU_FREE)
     {
         // merge with previous free block
+        Z_FreeListRemove(other);
         other->size += block->size;
         other->next = block->next;
         other->next->prev = other;
 
-        if (block == mainzone->rover)
-            mainzone->rover = other;
-
         block = other;
     }
 	
@@ -163,16 +234,61 @@ void Z_Free (void* ptr)
     if (other->tag == PU_FREE)
     {
         // merge the next free block onto the end
+        Z_FreeListRemove(other);
         block->size += other->size;
         block->next = other->next;
         block->next->prev = block;
-
-        if (other == mainzone->rover)
-            mainzone->rover = block;
     }
+
+    Z_FreeListAdd(block);
+
+    return block;
 }
 
 
+//
+// Z_Free
+//
+void Z_Free (void* ptr)
+{
+    Z_FreeBlock((memblock_t *) ( (byte *)ptr - sizeof(memblock_t)));
+}
+
+
+//
+// Z_FindFree
+// A free block of at least size bytes, NULL if there is none.
+//
+static memblock_t* Z_FindFree (int size)
+{
+    memblock_t*	block;
+    unsigned int larger;
+    int		c;
+    int		n;
+
+    c = Z_SizeClass(size);
+
+    // any block of a larger class fits
+    larger = (c < ZONE_CLASSES - 1) ? mainzone->freemap & ~((2u << c) - 1) : 0;
+
+    // first fit in the class of the size, only its start
+    // if a larger class can be used instead
+    n = 0;
+    for (block = mainzone->freelist[c] ; block != NULL ; block = block->lnext)
+    {
+        if (block->size >= size)
+            return block;
+
+        if (larger && ++n >= ZONE_SCAN)
+            break;
+    }
+
+    if (larger)
+        return mainzone->freelist[__builtin_ctz(larger)];
+
+    return NULL;
+}
+
 
 //
 // Z_Malloc
@@ -188,68 +304,46 @@ Z_Malloc
   void*		user )
 {
     int		extra;
-    memblock_t*	start;
-    memblock_t* rover;
+    int		start;
+    memblock_t* purged;
     memblock_t* newblock;
     memblock_t*	base;
     void *result;
 
+    start = I_GetTimeUS();
+
     size = (size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
     
-    // scan through the block list,
-    // looking for the first free block
-    // of sufficient size,
-    // throwing out any purgable blocks along the way.
-
     // account for size of block header
     size += sizeof(memblock_t);
     
-    // if there is a free block behind the rover,
-    //  back up over them
-    base = mainzone->rover;
-    
-    if (base->prev->tag == PU_FREE)
-        base = base->prev;
-	
-    rover = base;
-    start = base->prev;
-	
-    do
+	if (user == NULL && tag >= PU_PURGELEVEL)
+	    I_Error ("Z_Malloc: an owner is required for purgable blocks");
+
+    base = Z_FindFree(size);
+
+    // nothing free fits, purge the least recently used
+    // blocks until their space and its free neighbours do
+    while (base == NULL)
     {
-        if (rover == start)
+        purged = mainzone->lru.lprev;
+
+        if (purged == &mainzone->lru)
         {
-            // scanned all the way around the list
             I_Error ("Z_Malloc: failed on allocation of %i bytes", size);
         }
-	
-        if (rover->tag != PU_FREE)
-        {
-            if (rover->tag < PU_PURGELEVEL)
-            {
-                // hit a block that can't be purged,
-                // so move base past it
-                base = rover = rover->next;
-            }
-            else
-            {
-                // free the rover block (adding the size to base)
-
-                // the rover can be the base block
-                base = base->prev;
-                Z_Free ((byte *)rover+sizeof(memblock_t));
-                base = base->next;
-                rover = base->next;
-            }
-        }
-        else
-        {
-            rover = rover->next;
-        }
 
-    } while (base->tag != PU_FREE || base->size < size);
+        zonestats.purges++;
+        zonestats.purged_bytes += purged->size;
+
+        purged = Z_FreeBlock(purged);
+
+        if (purged->size >= size)
+            base = purged;
+    }
 
-    
     // found a block big enough
+    Z_FreeListRemove(base);
     extra = base->size - size;
     
     if (extra >  MINFRAGMENT)
@@ -260,20 +354,23 @@ Z_Malloc
 	
         newblock->tag = PU_FREE;
         newblock->user = NULL;	
+        newblock->id = 0;
         newblock->prev = base;
         newblock->next = base->next;
         newblock->next->prev = newblock;
 
         base->next = newblock;
         base->size = size;
+
+        Z_FreeListAdd(newblock);
     }
 	
-	if (user == NULL && tag >= PU_PURGELEVEL)
-	    I_Error ("Z_Malloc: an owner is required for purgable blocks");
-
     base->user = user;
     base->tag = tag;
 
+    if (tag >= PU_PURGELEVEL)
+        Z_LRUAdd(base);
+
     result  = (void *) ((byte *)base + sizeof(memblock_t));
 
     if (base->user)
@@ -281,10 +378,13 @@ Z_Malloc
         *base->user = result;
     }
 
-    // next allocation will start looking here
-    mainzone->rover = base->next;	
-	
     base->id = ZONEID;
+
+    start = I_GetTimeUS() - start;
+    zonestats.allocs++;
+    zonestats.alloc_us += start;
+    if (start > zonestats.alloc_max_us)
+        zonestats.alloc_max_us = start;
     
     return result;
 }
@@ -314,7 +414,7 @@ Z_FreeTags
 	    continue;
 	
 	if (block->tag >= lowtag && block->tag <= hightag)
-	    Z_Free ( (byte *)block+sizeof(memblock_t));
+	    next = Z_FreeBlock (block)->next;
     }
 }
 
@@ -400,9 +500,19 @@ void Z_FileDumpHeap (FILE* f)
 void Z_CheckHeap (void)
 {
     memblock_t*	block;
+    int		nfree;
+    int		npurgable;
+    int		c;
 	
+    nfree = npurgable = 0;
+
     for (block = mainzone->blocklist.next ; ; block = block->next)
     {
+	if (block->tag == PU_FREE)
+	    nfree++;
+	else if (block->tag >= PU_PURGELEVEL)
+	    npurgable++;
+
 	if (block->next == &mainzone->blocklist)
 	{
 	    // all blocks have been hit
@@ -418,6 +528,29 @@ void Z_CheckHeap (void)
 	if (block->tag == PU_FREE && block->next->tag == PU_FREE)
 	    I_Error ("Z_CheckHeap: two consecutive free blocks\n");
     }
+
+    for (c = 0; c < ZONE_CLASSES; c++)
+    {
+	if ( (mainzone->freelist[c] != NULL) != ((mainzone->freemap >> c) & 1) )
+	    I_Error ("Z_CheckHeap: free list bitmap out of sync\n");
+
+	for (block = mainzone->freelist[c] ; block != NULL ; block = block->lnext)
+	{
+	    if (block->tag != PU_FREE || Z_SizeClass(block->size) != c)
+		I_Error ("Z_CheckHeap: bad block in free list\n");
+	    nfree--;
+	}
+    }
+
+    for (block = mainzone->lru.lnext ; block != &mainzone->lru ; block = block->lnext)
+    {
+	if (block->tag < PU_PURGELEVEL || block->lnext->lprev != block)
+	    I_Error ("Z_CheckHeap: bad block in purge list\n");
+	npurgable--;
+    }
+
+    if (nfree != 0 || npurgable != 0)
+	I_Error ("Z_CheckHeap: block missing from the free or purge lists\n");
 }
 
 
@@ -440,6 +573,12 @@ void Z_ChangeTag2(void *ptr, int tag, char *file, int line)
         I_Error("%s:%i: Z_ChangeTag: an owner is required "
                 "for purgable blocks", file, line);
 
+    // purgable again, it is now the most recently used
+    if (block->tag >= PU_PURGELEVEL)
+        Z_LRURemove(block);
+    if (tag >= PU_PURGELEVEL)
+        Z_LRUAdd(block);
+
     block->tag = tag;
 }
 
@@ -486,3 +625,44 @@ unsigned int Z_ZoneSize(void)
     return mainzone->size;
 }
 
+
+//
+// Z_DumpStats
+// Fragmentation is the part of the free memory not in the largest
+// free block, latency includes the purges.
+//
+void Z_DumpStats (void)
+{
+    memblock_t*	block;
+    int		free, largest, nfree, purgable;
+
+    free = largest = nfree = purgable = 0;
+
+    for (block = mainzone->blocklist.next ;
+         block != &mainzone->blocklist;
+         block = block->next)
+    {
+        if (block->tag == PU_FREE)
+        {
+            free += block->size;
+            nfree++;
+            if (block->size > largest)
+                largest = block->size;
+        }
+        else if (block->tag >= PU_PURGELEVEL)
+        {
+            purgable += block->size;
+        }
+    }
+
+    printf ("zone size: %i  free: %i in %i blocks  largest: %i"
+            "  fragmentation: %i%%\n",
+            mainzone->size, free, nfree, largest,
+            free ? 100 - (int)(100LL * largest / free) : 0);
+    printf ("purgable: %i  purges: %u (%u bytes)\n",
+            purgable, zonestats.purges, zonestats.purged_bytes);
+    printf ("allocations: %u  average: %u us  max: %u us\n",
+            zonestats.allocs,
+            zonestats.allocs ? zonestats.alloc_us / zonestats.allocs : 0,
+            zonestats.alloc_max_us);
+}
@@ -226,6 +226,8 @@ namespace spc
 
 	static const int32	timing_hack_numerator   = SNES_SPC::tempo_unit;
 	static int32		timing_hack_denominator = SNES_SPC::tempo_unit;
+
+	static double		dynamic_rate_multiplier = 1.0;
 }
 
 static void EightBitize (uint8 *, int);
@@ -422,9 +424,19 @@ static void UpdatePlaybackRate (void)
 		Settings.SoundInputRate = APU_DEFAULT_INPUT_RATE;
 
 	double time_ratio = (double) Settings.SoundInputRate * spc::timing_hack_numerator / (Settings.SoundPlaybackRate * spc::timing_hack_denominator);
+	time_ratio *= spc::dynamic_rate_multiplier;
 	spc::resampler->time_ratio(time_ratio);
 }
 
+void S9xUpdateDynamicRate (int avail, int buffer_size)
+{
+	// avail: free space of the output buffer, resampling goes up to
+	// Settings.DynamicRateLimit/1000 faster or slower to keep it half full
+	spc::dynamic_rate_multiplier = 1.0 + (Settings.DynamicRateLimit * (buffer_size - 2 * avail)) /
+		(double) (1000 * buffer_size);
+	UpdatePlaybackRate();
+}
+
 bool8 S9xInitSound (int buffer_ms, int lag_ms)
 {
 	// buffer_ms : buffer size given in millisecond
@@ -472,6 +484,7 @@ bool8 S9xInitSound (int buffer_ms, int lag_ms)
 	spc_core->set_output((SNES_SPC::sample_t *) spc::landing_buffer, spc::buffer_size >> 1);
 
 	UpdatePlaybackRate();
+	spc::resampler->clear();
 
 	spc::sound_enabled = S9xOpenSoundDevice();
 
@@ -210,6 +210,7 @@ void S9xLandSamples (void);
 void S9xFinalizeSamples (void);
 void S9xClearSamples (void);
 bool8 S9xMixSamples (uint8 *, int);
+void S9xUpdateDynamicRate (int, int);
 void S9xSetSamplesAvailableCallback (apu_callback, void *);
 void S9xToggleSoundChannel (int);
 
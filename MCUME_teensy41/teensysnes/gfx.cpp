@@ -1719,6 +1719,9 @@ void S9xUpdateScreen (void)
 			PPU.RecomputeClipWindows = FALSE;
 		}
 
+		for (uint32 l = GFX.StartY; l <= GFX.EndY && l < SNES_HEIGHT_EXTENDED; l++)
+			GFX.DirtyLines[l] = 1;
+
 		if ((Memory.PPU_IO[0x130] & 0x30) != 0x30 && (Memory.PPU_IO[0x131] & 0x3f))
 			GFX.FixedColour = BUILD_PIXEL(IPPU.XB[PPU.FixedColourRed], IPPU.XB[PPU.FixedColourGreen], IPPU.XB[PPU.FixedColourBlue]);
 
@@ -46,6 +46,8 @@ struct SGFX
 		}	OBJ[32];
 	}	OBJLines[SNES_HEIGHT_EXTENDED];
 
+	uint8	DirtyLines[SNES_HEIGHT_EXTENDED];	// lines rendered since the last blit
+
 	void	(*DrawBackdropMath) (uint32, uint32, uint32);
 	void	(*DrawBackdropNomath) (uint32, uint32, uint32);
 	void	(*DrawTileMath) (uint32, uint32, uint32, uint32);
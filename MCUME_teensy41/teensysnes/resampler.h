@@ -59,7 +59,6 @@ class Resampler : public ring_buffer
         time_ratio (double ratio)
         {
             r_step = ratio;
-            clear ();
         }
 
         void
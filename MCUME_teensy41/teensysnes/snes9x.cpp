@@ -52,7 +52,7 @@ void s9x_init(void) {
 	Settings.SoundSync = false;
 	Settings.Mute = false;
 	Settings.Transparency = true;
-	Settings.SkipFrames = 1;
+	Settings.SkipFrames = AUTO_FRAMERATE;
 	Settings.Paused = false;
 
   Settings.SixteenBitSound = true;
@@ -78,7 +78,8 @@ void s9x_init(void) {
   if (!S9xInitAPU())
     emu_printf("APU init failed!");
 
-  if (!S9xInitSound(40,2))
+  // no lag, the frontend ring buffer holds the latency
+  if (!S9xInitSound(40,0))
 		emu_printf("Sound init failed!");
 
 	if (!S9xGraphicsInit())
@@ -91,28 +92,81 @@ void s9x_start(char * filepath) {
 }
 
 static uint32_t frames_counter = 0;
+static uint32_t line_sum[SNES_HEIGHT];
+
+// Emulated frames end on a clock advanced by the vsync period (see
+// emu_start()). Rendered frames are blitted on the vbl (emu_DrawVsync), a
+// skipped frame waits for the clock when the emulation is ahead of it.
+// Settings.SkipFrames == AUTO_FRAMERATE: the next frame is skipped while
+// the emulation is late on this clock, so skipped frames make up for the
+// time of the slow rendered ones
+#define FRAME_US  16666
+#define MAX_SKIP  4
+#define SKIP_LATE (FRAME_US / 4)
+// later than this (ROM loading, menu), the clock restarts from now
+#define MAX_LATE  (FRAME_US * 8)
+static uint32_t frame_clock;
+static bool8 frame_clock_on = FALSE;
+static uint32_t frames_skipped = 0;
+
+static void s9x_frameskip(bool8 rendered)
+{
+  if (!frame_clock_on) {
+    frame_clock = micros();
+    frame_clock_on = TRUE;
+  }
+  frame_clock += FRAME_US;
+  int32_t late = (int32_t)(micros() - frame_clock);
+  if (late < 0) {
+    // a rendered frame already waited for the vbl, the clock follows it
+    if (rendered) frame_clock = micros();
+    else while ((int32_t)(micros() - frame_clock) < 0) {};
+    late = 0;
+  }
+  else if (late > MAX_LATE) {
+    frame_clock = micros();
+    late = 0;
+  }
 
-void s9x_step(void) {
-	S9xMainLoop();
-	if (IPPU.RenderThisFrame)
-	{
-    emu_DrawVsync();
-	}
-
-  if (++frames_counter == Settings.SkipFrames) 
-  {
-    frames_counter = 0;
-    IPPU.RenderThisFrame = true;
+  bool8 render;
+  uint32_t skip = Settings.SkipFrames;
+  if (skip == AUTO_FRAMERATE) {
+    render = (late < SKIP_LATE) || (frames_skipped >= MAX_SKIP);
   }
-  else 
-  {
-    IPPU.RenderThisFrame = false;
+  else {
+    render = (++frames_counter >= skip);
+    if (render) frames_counter = 0;
   }
-  //IPPU.RenderThisFrame = (((++frames_counter) & Settings.SkipFrames) == Settings.SkipFrames);
-		//GFX.Screen = (uint16*)currentUpdate->buffer;
+  frames_skipped = render ? 0 : frames_skipped + 1;
+  IPPU.RenderThisFrame = render;
+}
+
+// Lines the PPU rendered and which differ from the displayed ones. A line
+// is compared by a hash of its words, which always changes when a single
+// word does.
+static void s9x_blit(void)
+{
   for (int j=0; j<SNES_HEIGHT; j++) {
-      emu_DrawLine8(&GFX.Screen[SNES_WIDTH*j], SNES_WIDTH, SNES_HEIGHT, j);
+    if (!GFX.DirtyLines[j]) continue;
+    GFX.DirtyLines[j] = 0;
+    const uint32_t * src = (const uint32_t *)&GFX.Screen[SNES_WIDTH*j];
+    uint32_t sum = 2166136261u;
+    for (int i=0; i<SNES_WIDTH/4; i++) sum = (sum ^ src[i]) * 16777619;
+    if (sum == line_sum[j]) continue;
+    line_sum[j] = sum;
+    emu_DrawLine8(&GFX.Screen[SNES_WIDTH*j], SNES_WIDTH, SNES_HEIGHT, j);
+  }
+}
+
+void s9x_step(void) {
+  bool8 rendered = IPPU.RenderThisFrame;
+  S9xMainLoop();
+  if (rendered)
+  {
+    emu_DrawVsync();
+    s9x_blit();
   }
+  s9x_frameskip(rendered);
 }
 
 
@@ -12,6 +12,32 @@ extern "C" {
 // Emulation includes
 #include "snes9x.h"
 #include "apu.h"
+#include "ring_buffer.h"
+
+#ifdef HAS_SND
+// APU samples are mixed once per frame into snd_ring, its fill level
+// steering the resampling rate so that audio follows the video pace
+#define SND_RING_BYTES   6144
+#define SND_MIX_SAMPLES  1024
+static ring_buffer * snd_ring = NULL;
+static short snd_mix[SND_MIX_SAMPLES];
+
+static void snd_Mix(void)
+{
+  int space = snd_ring->space_empty();
+  S9xUpdateDynamicRate(space, SND_RING_BYTES);
+  // stereo 16-bit samples
+  int count = S9xGetSampleCount() & ~1;
+  if (count > ((space >> 1) & ~1)) count = (space >> 1) & ~1;
+  if (count > SND_MIX_SAMPLES) count = SND_MIX_SAMPLES;
+  if ( (count) && (S9xMixSamples((uint8 *)snd_mix, count)) ) {
+    // the audio interrupt pulls from the same ring
+    NVIC_DISABLE_IRQ(IRQ_SOFTWARE);
+    snd_ring->push((unsigned char *)snd_mix, count << 1);
+    NVIC_ENABLE_IRQ(IRQ_SOFTWARE);
+  }
+}
+#endif
 
 static int ik;    // joypad key
 static int pik=0; 
@@ -48,6 +74,7 @@ void snes_Init(void)
 {
   s9x_init();
 #ifdef HAS_SND  
+  snd_ring = new ring_buffer(SND_RING_BYTES);
   emu_sndInit();
 #endif 
 }
@@ -176,12 +203,23 @@ void snes_Step(void)
   pik = k;
 
   s9x_step();
+#ifdef HAS_SND      
+  snd_Mix();
+#endif 
 }
 
 #ifdef HAS_SND      
 void  SND_Process( void * stream, int len )
 {
-    S9xMixSamples(stream, len);
+  // audio interrupt: only drains what the emulation loop mixed
+  int bytes = len << 1;
+  int avail = 0;
+  if (snd_ring != NULL) {
+    avail = snd_ring->space_filled() & ~3;
+    if (avail > bytes) avail = bytes;
+    snd_ring->pull((unsigned char *)stream, avail);
+  }
+  if (avail < bytes) memset((unsigned char *)stream + avail, 0, bytes - avail);
 }
 #endif 
  
@@ -31,6 +31,18 @@
 
 #define FLOPPY_SPEED 50
 
+/* AmigaDOS DD images are kept MFM encoded in EXTMEM, a track is encoded
+ * on its first access and written back to the image on eject if the
+ * Amiga wrote to it. Other formats are re-read at each track change. */
+#define CACHE_TRACKS 160
+#define CACHE_SECS 11
+#define CACHE_TRACKLEN (CACHE_SECS*544 + FLOPPY_GAP_LEN)
+#define TRACK_CACHED 1
+#define TRACK_DIRTY 2
+#define MFMMASK 0x55555555
+
+static uae_u16 *mfmcache; /* CACHE_TRACKS tracks, allocated once */
+
 #ifdef HAS_FLOPPYWRITE
 uae_u16* mfmwrite;
 static uae_u16 mfmwrbuffer[16384]; /* space for maximum disk DMA transfer */
@@ -59,6 +71,9 @@ typedef struct {
     int motoroff;
     int wrprot;
     uae_u16 bigmfmbuf[0x4000];
+    uae_u16 *mfmbuf; /* track under the head, in bigmfmbuf or the cache */
+    int cached;
+    uae_u8 trackstate[CACHE_TRACKS];
     int mfmbufpos;
     int tracklen;
     unsigned long last_cycles;
@@ -109,6 +124,7 @@ static int drive_insert (drive *drv, int dnum, const char *fname)
   drv->diskfile = emu_FileOpen(fname, "r+b");    
     if (drv->diskfile == 0) {
   drv->tracklen = 2000;
+  drv->mfmbuf = drv->bigmfmbuf;
   return 0;
     }
  
@@ -159,6 +175,10 @@ static int drive_insert (drive *drv, int dnum, const char *fname)
       drv->trackdata[i].offs = i * 512 * drv->num_secs;
   }
     }
+    if (!mfmcache)
+  mfmcache = (uae_u16 *)emu_SMalloc (CACHE_TRACKS*CACHE_TRACKLEN*2);
+    drv->cached = mfmcache && drv->num_secs == CACHE_SECS;
+    memset (drv->trackstate, 0, sizeof drv->trackstate);
     drv->buffered_side = 2; /* will force read */
     drive_fill_bigbuf (drv);
     return 1;
@@ -217,12 +237,109 @@ static void drive_motor (drive *drv, int off)
     events_schedule ();
 }
 
+STATIC_INLINE void mfm_put (uae_u16 *mfm, uae_u32 odd, uae_u32 even)
+{
+    mfm[0] = odd >> 16;
+    mfm[1] = odd;
+    mfm[2] = even >> 16;
+    mfm[3] = even;
+}
+
+/* Data bits only, as odd/even longs, the checksums of a sector are the
+ * ones of the xor of its longs. */
+static void mfm_encode_sector (uae_u16 *mfmbuf, const uae_u8 *data, int tr, int sec, int num_secs)
+{
+    const uae_u32 *src = (const uae_u32 *)data;
+    uae_u16 *odd = mfmbuf + 32;
+    uae_u16 *even = mfmbuf + 256 + 32;
+    uae_u32 id, ck, x = 0;
+    int i;
+
+    mfmbuf[0] = mfmbuf[1] = 0xaaaa;
+    mfmbuf[2] = mfmbuf[3] = 0x4489;
+    id = (0xffu << 24) | (tr << 16) | (sec << 8) | (num_secs - sec);
+    mfm_put (mfmbuf + 4, (id >> 1) & MFMMASK, id & MFMMASK);
+    for (i = 8; i < 24; i++)
+  mfmbuf[i] = 0xaaaa;
+    /* the label words cancel out */
+    ck = ((id >> 1) ^ id) & MFMMASK;
+    mfm_put (mfmbuf + 24, ck >> 1, ck);
+
+    for (i = 0; i < 128; i++) {
+  uae_u32 d = __builtin_bswap32 (src[i]);
+  uae_u32 o = (d >> 1) & MFMMASK;
+  uae_u32 e = d & MFMMASK;
+  odd[0] = o >> 16; odd[1] = o; odd += 2;
+  even[0] = e >> 16; even[1] = e; even += 2;
+  x ^= d;
+    }
+    ck = ((x >> 1) ^ x) & MFMMASK;
+    mfm_put (mfmbuf + 28, ck >> 1, ck);
+}
+
+static void mfm_decode_sector (uae_u8 *data, const uae_u16 *mfmbuf)
+{
+    uae_u32 *dst = (uae_u32 *)data;
+    const uae_u16 *odd = mfmbuf + 32;
+    const uae_u16 *even = mfmbuf + 256 + 32;
+    int i;
+
+    for (i = 0; i < 128; i++) {
+  uae_u32 o = ((odd[0] << 16) | odd[1]) & MFMMASK;
+  uae_u32 e = ((even[0] << 16) | even[1]) & MFMMASK;
+  dst[i] = __builtin_bswap32 ((o << 1) | e);
+  odd += 2;
+  even += 2;
+    }
+}
+
+/* An AmigaDOS track, read at once. The sectors go at the end of bigmfmbuf,
+ * each one is consumed before the encoder reaches it. */
+static void drive_read_track (drive *drv, int tr, uae_u16 *mfmbuf)
+{
+    unsigned int sec;
+    int len = drv->num_secs*512;
+    uae_u8 *raw = (uae_u8 *)(drv->bigmfmbuf + 0x4000) - len;
+
+    emu_FileSeek (drv->diskfile, drv->trackdata[tr].offs, SEEK_SET);
+    if (emu_FileRead (raw, len, drv->diskfile) != len)
+  write_log ("Disk read: short track\n");
+
+    for (sec = 0; sec < drv->num_secs; sec++)
+  mfm_encode_sector (mfmbuf + 544*sec + FLOPPY_GAP_LEN, raw + sec*512, tr, sec, drv->num_secs);
+}
+
+/* Dirty tracks of the cache back to the image */
+static void drive_write_back (drive *drv)
+{
+    unsigned int tr, sec;
+    int len = drv->num_secs*512;
+    uae_u8 *raw = (uae_u8 *)drv->bigmfmbuf;
+
+    if (!drv->cached)
+  return;
+    for (tr = 0; tr < CACHE_TRACKS; tr++) {
+  uae_u16 *mfmbuf = mfmcache + tr*CACHE_TRACKLEN;
+  if (!(drv->trackstate[tr] & TRACK_DIRTY))
+      continue;
+  for (sec = 0; sec < drv->num_secs; sec++)
+      mfm_decode_sector (raw + sec*512, mfmbuf + 544*sec + FLOPPY_GAP_LEN);
+  emu_FileSeek (drv->diskfile, drv->trackdata[tr].offs, SEEK_SET);
+  if (emu_FileWrite (raw, len, drv->diskfile) != len) {
+      emu_printf("disk write back failed");
+      break;
+  }
+  drv->trackstate[tr] &= ~TRACK_DIRTY;
+    }
+}
+
 static void drive_fill_bigbuf(drive *drv)
 {
     int tr = drv->cyl*2 + side;
 
     if (!drv->diskfile) {
   drv->tracklen = 2000;
+  drv->mfmbuf = drv->bigmfmbuf;
   memset (drv->bigmfmbuf,0xaa,drv->tracklen*2);
   return;
     }
@@ -235,73 +352,22 @@ static void drive_fill_bigbuf(drive *drv)
     
     if (drv->trackdata[tr].sync == 0) {
   /* Normal AmigaDOS format track */
-  unsigned int sec;
   drv->tracklen = drv->num_secs*544 + FLOPPY_GAP_LEN;
-  memset (drv->bigmfmbuf,0xaa,FLOPPY_GAP_LEN*2);
-
-  for (sec = 0; sec < drv->num_secs; sec++) {
-      uae_u8 secbuf[544];
-      int i;
-      uae_u16 *mfmbuf = drv->bigmfmbuf + 544*sec + FLOPPY_GAP_LEN;
-      uae_u32 deven,dodd;
-      uae_u32 hck=0,dck=0;
-
-      secbuf[0] = secbuf[1] = 0x00;
-      secbuf[2] = secbuf[3] = 0xa1;
-      secbuf[4] = 0xff;
-      secbuf[5] = tr;
-      secbuf[6] = sec;
-      secbuf[7] = drv->num_secs-sec;
-
-      for(i = 8; i < 24; i++)
-    secbuf[i] = 0;
-
-      emu_FileSeek (drv->diskfile, drv->trackdata[tr].offs + sec*512,
-       SEEK_SET);
-      emu_FileRead (&secbuf[32],512, drv->diskfile);
-
-      mfmbuf[0] = mfmbuf[1] = 0xaaaa;
-      mfmbuf[2] = mfmbuf[3] = 0x4489;
-
-      deven = ((secbuf[4] << 24) | (secbuf[5] << 16)
-         | (secbuf[6] << 8) | (secbuf[7]));
-      dodd = deven >> 1;
-      deven &= 0x55555555; dodd &= 0x55555555;
-
-      mfmbuf[4] = dodd >> 16;
-      mfmbuf[5] = dodd;
-      mfmbuf[6] = deven>> 16;
-      mfmbuf[7] = deven;
-
-      for (i = 8; i < 48; i++)
-    mfmbuf[i] = 0xaaaa;
-      for (i = 0; i < 512; i += 4){
-    deven = ((secbuf[i+32] << 24) | (secbuf[i+33] << 16)
-       | (secbuf[i+34] << 8) | (secbuf[i+35]));
-    dodd = deven >> 1;
-    deven &= 0x55555555; dodd &= 0x55555555;
-    mfmbuf[(i>>1) + 32] = dodd >> 16;
-    mfmbuf[(i>>1) + 33] = dodd;
-    mfmbuf[(i>>1) + 256 + 32] = deven >> 16;
-    mfmbuf[(i>>1) + 256 + 33] = deven;
+  if (drv->cached && tr < CACHE_TRACKS) {
+      drv->mfmbuf = mfmcache + tr*CACHE_TRACKLEN;
+      if (!(drv->trackstate[tr] & TRACK_CACHED)) {
+    memset (drv->mfmbuf,0xaa,FLOPPY_GAP_LEN*2);
+    drive_read_track (drv, tr, drv->mfmbuf);
+    drv->trackstate[tr] |= TRACK_CACHED;
       }
-
-      for(i = 4; i < 24; i += 2)
-    hck ^= (mfmbuf[i] << 16) | mfmbuf[i+1];
-
-      deven = dodd = hck; dodd >>= 1;
-      mfmbuf[24] = dodd >> 16; mfmbuf[25] = dodd;
-      mfmbuf[26] = deven >> 16; mfmbuf[27] = deven;
-
-      for(i = 32; i < 544; i += 2)
-    dck ^= (mfmbuf[i] << 16) | mfmbuf[i+1];
-
-      deven = dodd = dck; dodd >>= 1;
-      mfmbuf[28] = dodd >> 16; mfmbuf[29] = dodd;
-      mfmbuf[30] = deven >> 16; mfmbuf[31] = deven;
+  } else {
+      drv->mfmbuf = drv->bigmfmbuf;
+      memset (drv->bigmfmbuf,0xaa,FLOPPY_GAP_LEN*2);
+      drive_read_track (drv, tr, drv->bigmfmbuf);
   }
     } else {
   int i;
+  drv->mfmbuf = drv->bigmfmbuf;
   drv->tracklen = drv->trackdata[tr].len/2 + 1;
   drv->bigmfmbuf[0] = drv->trackdata[tr].sync;
   emu_FileSeek(drv->diskfile, drv->trackdata[tr].offs, SEEK_SET);
@@ -339,7 +405,7 @@ static int drive_update_reads (drive *drv, uaecptr *ptr, int *length, int *syncf
     write_log ("Bug in disk code - mfmpos too large\n");
     drv->mfmpos = 0;
       }
-      word = drv->bigmfmbuf[drv->mfmpos];
+      word = drv->mfmbuf[drv->mfmpos];
       if (*syncfound) {
     put_word (*ptr, word);
     (*ptr) += 2;
@@ -359,14 +425,13 @@ static int drive_update_reads (drive *drv, uaecptr *ptr, int *length, int *syncf
 /* We assume that drive_update_reads has already been called.  */
 static void drive_get_data (drive *drv, uae_u16 *mfm, uae_u16 *byt)
 {
-    *mfm = drv->bigmfmbuf[drv->mfmpos];
+    *mfm = drv->mfmbuf[drv->mfmpos];
     if (cycles - drv->last_cycles > (FLOPPY_SPEED / 2))
   *byt = *mfm & 0xff;
     else
   *byt = (*mfm >> 8) & 0xff;
 }
 
-#define MFMMASK 0x55555555
 STATIC_INLINE uae_u32 getmfmlong (uae_u16* mbuf)
 {
     return ((*mbuf << 16) | *(mbuf + 1)) & MFMMASK;
@@ -375,7 +440,7 @@ STATIC_INLINE uae_u32 getmfmlong (uae_u16* mbuf)
 static void drive_write_data (drive *drv, uae_u16 *mbuf, int length)
 {
 #ifdef HAS_FLOPPYWRITE
-    int i, secwritten = 0;
+    int i, tr, secwritten = 0;
     uae_u32 odd, even, chksum, id, dlong;
     uae_u8* secdata;
     uae_u8 secbuf[544];
@@ -441,9 +506,17 @@ static void drive_write_data (drive *drv, uae_u16 *mbuf, int length)
       continue;
   }
   secwritten++;
-  emu_FileSeek (drv->diskfile, drv->trackdata[drv->cyl*2 + side].offs + trackoffs*512,
+  tr = drv->cyl*2 + side;
+  if (drv->cached && tr < CACHE_TRACKS) {
+      /* the track is in the cache since drive_fill_bigbuf */
+      mfm_encode_sector (mfmcache + tr*CACHE_TRACKLEN + 544*trackoffs + FLOPPY_GAP_LEN,
+             secbuf+32, tr, trackoffs, drv->num_secs);
+      drv->trackstate[tr] |= TRACK_DIRTY;
+  } else {
+      emu_FileSeek (drv->diskfile, drv->trackdata[tr].offs + trackoffs*512,
          SEEK_SET);
-  emu_FileRead (secbuf+32, 512, drv->diskfile);
+      emu_FileWrite (secbuf+32, 512, drv->diskfile);
+  }
     }
     drv->buffered_side = 2; /* will force read */
 
@@ -457,13 +530,17 @@ static void drive_write_data (drive *drv, uae_u16 *mbuf, int length)
 
 static void drive_eject (drive *drv)
 {
-    if (! drive_empty (drv))
+    if (! drive_empty (drv)) {
+  drive_write_back (drv);
   emu_FileClose(drv->diskfile);
+    }
 
     drv->dskchange = 4;
     drv->dskchange_time = 20;
 /*    printf("setting changed bit %d\n", drv-floppy);*/
     drv->diskfile = 0;
+    drv->cached = 0;
+    drv->mfmbuf = drv->bigmfmbuf;
 }
 
 /* We use this function if we have no Kickstart ROM.
@@ -658,7 +735,7 @@ void DISK_search_sync (int cycle_limit, unsigned int sync)
     count += missing;
     cycle_limit -= missing;
     missing = FLOPPY_SPEED;
-    if (drv->bigmfmbuf[offs] == sync) {
+    if (drv->mfmbuf[offs] == sync) {
         eventtab[ev_disksync].active = 1;
         eventtab[ev_disksync].oldcycles = cycles;
         eventtab[ev_disksync].evtime = cycles + count;
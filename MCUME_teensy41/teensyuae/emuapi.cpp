@@ -1375,8 +1375,11 @@ int emu_FileOpen(const char * filepath, const char * mode)
 #else
   int retval = 0;
   int handler = getFreeFileHandler();
+  // "r+" and "w" modes can be written to, e.g. floppy images
+  int oflag = ( (strchr(mode, '+')) || (strchr(mode, 'w')) ) ? O_RDWR : O_READ;
   if (handler >= 0) {
-    if ((file_handlers[handler] = SD.open(filepath, O_READ))) {
+    if ((file_handlers[handler] = SD.open(filepath, oflag)) ||
+        ( (oflag != O_READ) && (file_handlers[handler] = SD.open(filepath, O_READ)) )) {
  //     emu_printi(handler+1);
       retval = handler+1;  
     }
@@ -25,6 +25,7 @@ extern void emu_SetPaletteEntry(unsigned char r, unsigned char g, unsigned char
 
 extern int emu_FileOpen(const char * filepath, const char * mode);
 extern int emu_FileRead(void * buf, int size, int handler);
+extern int emu_FileWrite(void * buf, int size, int handler);
 extern int emu_FileSeek(int handler, int seek, int origin);
 extern void emu_FileClose(int handler);
 extern unsigned int emu_FileSize(const char * filepath);
@@ -32,6 +33,7 @@ extern unsigned int emu_FileSize(const char * filepath);
 
 extern void * emu_Malloc(size_t size); 
 extern void emu_Free(void * pt);
+extern void * emu_SMalloc(unsigned int size);
 
 extern int emu_RefreshScreen(void);
 